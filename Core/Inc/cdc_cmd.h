@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,6 +13,25 @@ void CDC_HandleLine(const char *line);
 int  CDC_BuildTimeStatus(char *buf, int buflen);
 int  CDC_TimeWasSet(void);
 
+/* Log commands (usb_service_standby_wkup.c) */
+void CMD_EraseLog(void);
+void CMD_EraseLogFast(void);
+void CMD_GetLog_All(void);
+void CMD_GetLog_Since(uint32_t since);
+void CMD_GetLog_Between(uint32_t a, uint32_t b);
+void CMD_GetLog_Index(void);
+void CMD_GetLog_Compress(uint32_t lo, uint32_t hi);   /* GETLOG COMPRESS [SINCE=|BETWEEN=] */
+void CMD_GetLog_Window(uint32_t offset, uint32_t len, bool framed);   /* GETLOG OFFSET= LEN= [FRAMED] */
+void CMD_LogTimeChanged(void);   /* SETTIME: start a new segment in the GETLOG index */
+void CMD_Retention(const char *arg);   /* RETENTION [STOP|WRAP] */
+/* Last GETLOG: 1 ms USB frames it spanned, those with nothing armed on the
+ * bulk IN endpoint, and the transfers started from the TX-complete IRQ */
+typedef struct {
+    uint32_t frames, idle;
+    uint32_t bytes, transfers, chained;
+} CDC_StreamStats;
+void CMD_GetStreamStats(CDC_StreamStats *out);
+
 #ifdef __cplusplus
 }
 #endif
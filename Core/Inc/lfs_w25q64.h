@@ -1,10 +1,9 @@
-#ifndef LFS_W25Q128_H
-#define LFS_W25Q128_H
+#ifndef LFS_W25Q64_H
+#define LFS_W25Q64_H
 
 #include <stdint.h>
 #include <stddef.h>
 #include "lfs.h"
-// Update this include to match the header name of your 128-Mbit driver
 #include "w25q64.h"
 
 #ifdef __cplusplus
@@ -12,41 +11,209 @@ extern "C" {
 #endif
 
 /*
- * LittleFS <-> Winbond W25Q128 (128 Mbit = 16 MiB) bridge
- * Geometry assumptions (per W25Q128JV/FV family):
- *  - Erase sector: 4096 bytes
+ * LittleFS <-> Winbond W25Qxx bridge (W25Q32/64/128)
+ * Capacity comes from W25Q64_Probe (SFDP, else JEDEC ID) at InitConfig:
+ *  - Erase sector: 4096 bytes (lfs block)
  *  - Page program size: 256 bytes
- *  - Total capacity: 16 MiB -> 4096 sectors
+ *  - block_count = probed capacity / 4 KiB (1024 / 2048 / 4096)
  *
  * You can override these macros at compile time if needed.
  */
-#ifndef LFS_W25Q128_BLOCK_SIZE
-#define LFS_W25Q128_BLOCK_SIZE     4096u   /* 4 KiB erase sector */
+#ifndef LFS_W25Q64_BLOCK_SIZE
+#define LFS_W25Q64_BLOCK_SIZE     4096u   /* 4 KiB erase sector */
 #endif
-#ifndef LFS_W25Q128_BLOCK_COUNT
-#define LFS_W25Q128_BLOCK_COUNT    4096u   /* 16 MiB / 4 KiB */
+#ifndef LFS_W25Q64_BLOCK_COUNT
+#define LFS_W25Q64_BLOCK_COUNT       0u   /* 0 = from the probed capacity */
 #endif
-#ifndef LFS_W25Q128_PROG_SIZE
-#define LFS_W25Q128_PROG_SIZE       256u   /* page program granularity */
+#ifndef LFS_W25Q64_PROG_SIZE
+#define LFS_W25Q64_PROG_SIZE       256u   /* page program granularity */
 #endif
-#ifndef LFS_W25Q128_READ_SIZE
-#define LFS_W25Q128_READ_SIZE       256u   /* align reads to page */
+#ifndef LFS_W25Q64_READ_SIZE
+#define LFS_W25Q64_READ_SIZE       256u   /* align reads to page */
 #endif
-#ifndef LFS_W25Q128_CACHE_SIZE
-#define LFS_W25Q128_CACHE_SIZE      256u   /* multiple of read/prog; factor of block_size */
+#ifndef LFS_W25Q64_CACHE_SIZE
+#define LFS_W25Q64_CACHE_SIZE      256u   /* multiple of read/prog; factor of block_size */
 #endif
-#ifndef LFS_W25Q128_LOOKAHEAD
-#define LFS_W25Q128_LOOKAHEAD       256u   /* multiple of 8; 256B->window 2048 blocks */
+#ifndef LFS_W25Q64_LOOKAHEAD
+#define LFS_W25Q64_LOOKAHEAD       512u   /* buffer size, multiple of 8; 512B covers 4096 blocks */
 #endif
-#ifndef LFS_W25Q128_BLOCK_CYCLES
-#define LFS_W25Q128_BLOCK_CYCLES    500    /* 100..1000 typical */
+#ifndef LFS_W25Q64_BLOCK_CYCLES
+#define LFS_W25Q64_BLOCK_CYCLES    500    /* 100..1000 typical */
 #endif
+#ifndef LFS_W25Q64_MAX_BLOCKS
+#define LFS_W25Q64_MAX_BLOCKS      4096u   /* largest part supported (W25Q128) */
+#endif
+#ifndef LFS_W25Q64_BLANK_CHECK
+#define LFS_W25Q64_BLANK_CHECK       1    /* skip erasing blocks that read back all 0xFF */
+#endif
+#ifndef LFS_W25Q64_READAHEAD
+#define LFS_W25Q64_READAHEAD      1024u   /* read-ahead window (static buffer), 0 = off */
+#endif
+#ifndef LFS_W25Q64_FAST_MOUNT
+#define LFS_W25Q64_FAST_MOUNT        1    /* 0 = FastMount always does the full mount */
+#endif
+#ifndef LFS_W25Q64_USAGE_RECOUNT
+#define LFS_W25Q64_USAGE_RECOUNT   255u   /* accounted writes between checking walks (<= 255), 0 = always walk */
+#endif
+#ifndef LFS_W25Q64_COMPACT_THRESH
+#define LFS_W25Q64_COMPACT_THRESH    0u   /* lfs_fs_gc compacts metadata filled past this, 0 = 7/8 of a block */
+#endif
+#ifndef LFS_W25Q64_MAINT_AHEAD
+#define LFS_W25Q64_MAINT_AHEAD      32u   /* free blocks a battery maintenance pass looks at */
+#endif
+
+/* Erase marker storage that survives reset (RTC backup register). The bridge
+ * records the block being erased so a block whose erase was cut short is never
+ * trusted as blank. With no marker bound, every erase goes to the chip. */
+typedef struct {
+    uint32_t (*get)(void);
+    void     (*set)(uint32_t mark);
+} LFS_W25Q64_EraseMarker;
+
+/* Mount snapshot storage that survives Standby (RTC backup registers): the
+ * state lfs_mount rebuilds by walking the metadata chain, saved at the end of
+ * a wake so the next one can skip the walk. load() fills all n words;
+ * save() writes the first n. */
+#define LFS_W25Q64_SNAPSHOT_WORDS   15u
+
+typedef struct {
+    void (*load)(uint32_t *words, uint32_t n);
+    void (*save)(const uint32_t *words, uint32_t n);
+} LFS_W25Q64_SnapshotStore;
+
+/* Probed part geometry storage that survives Standby (SRAM2), so a wake
+ * need not take the part out of deep power-down only to probe it again.
+ * The bridge adds a magic and a CRC. load() fills all n words; save()
+ * writes all n. */
+#define LFS_W25Q64_GEOMETRY_WORDS   ((sizeof(W25Q64_Geometry) + 3u) / 4u + 2u)
+
+typedef struct {
+    void (*load)(uint32_t *words, uint32_t n);
+    void (*save)(const uint32_t *words, uint32_t n);
+} LFS_W25Q64_GeometryStore;
+
+/* Used-block count storage that survives Standby (RTC backup register), so
+ * the near-full check need not walk the whole tree (lfs_fs_size) every wake.
+ * Zero = no count. */
+typedef struct {
+    uint32_t (*get)(void);
+    void     (*set)(uint32_t word);
+} LFS_W25Q64_UsageStore;
+
+typedef struct {
+    uint32_t walks;           /* lfs_fs_size traversals */
+    uint32_t checks;          /* walks that found a kept count to compare */
+    uint32_t drift_max;       /* largest |kept - walked| seen, blocks */
+} LFS_W25Q64_UsageStats;
+
+/* Maintenance counters storage that survives Standby (RTC backup
+ * registers). load() fills all n words; save() writes all n. */
+#define LFS_W25Q64_MAINT_WORDS      2u
+
+typedef struct {
+    void (*load)(uint32_t *words, uint32_t n);
+    void (*save)(const uint32_t *words, uint32_t n);
+} LFS_W25Q64_MaintStore;
+
+/* Kept across Standby while a store is bound, 16-bit saturating */
+typedef struct {
+    uint32_t wakes;           /* storage wakes since the last maintenance pass (<= 255) */
+    uint32_t erased;          /* erases maintenance did: compactions, free blocks */
+    uint32_t log_erases;      /* erases on storage wakes, outside maintenance */
+    uint32_t log_skipped;     /* blank blocks those wakes took without an erase */
+} LFS_W25Q64_MaintStats;
+
+typedef struct {
+    uint32_t erases;          /* erases sent to the chip */
+    uint32_t skipped;         /* erases avoided, block was already blank */
+    uint32_t check_bytes;     /* bytes read by blank checks */
+} LFS_W25Q64_EraseStats;
+
+/* Read-ahead: a read that continues the previous one fetches a whole window
+ * (up to the end of the block) in one SPI frame; later reads inside it are
+ * served from RAM. Programs and erases through the bridge keep the window
+ * coherent. */
+typedef struct {
+    uint32_t reads;           /* bd_read calls */
+    uint32_t hits;            /* served from the window */
+    uint32_t misses;          /* window refilled */
+    uint32_t bypass;          /* random access or larger than the window: read as asked */
+    uint32_t fill_bytes;      /* bytes read to refill the window */
+} LFS_W25Q64_ReadStats;
 
 /* API */
+// Fills geometry and hooks. The geometry comes from the bound store when it
+// holds one; otherwise the flash is probed and the result saved. A part
+// known to be in deep power-down is put back after a probe; after a reset
+// it is left awake for the mount. lookahead_size is trimmed to
+// block_count/8, at most LFS_W25Q64_LOOKAHEAD.
 void LFS_W25Q64_InitConfig(struct lfs_config *cfg);
+void LFS_W25Q64_BindGeometry(const LFS_W25Q64_GeometryStore *store);
 int  LFS_W25Q64_Mount(lfs_t *lfs, const struct lfs_config *cfg);
 int  LFS_W25Q64_FormatAndMount(lfs_t *lfs, const struct lfs_config *cfg);
 void LFS_W25Q64_Unmount(lfs_t *lfs);
+// Chip erase (0xC7) followed by lfs_format; the volume is left unmounted.
+// Every block then reads blank, so the following writes skip their erases.
+int  LFS_W25Q64_EraseAndFormat(lfs_t *lfs, const struct lfs_config *cfg);
+void LFS_W25Q64_BindEraseMarker(const LFS_W25Q64_EraseMarker *marker);
+
+// Mount from the snapshot left by FastUnmount, else lfs_mount. The snapshot
+// is used once: a wake that dies before FastUnmount gets a full mount next
+// time. Mount, FormatAndMount and EraseAndFormat discard it. *fast (may be
+// NULL) is set to 1 when the metadata walk was skipped.
+int  LFS_W25Q64_FastMount(lfs_t *lfs, const struct lfs_config *cfg, uint8_t *fast);
+// Save the snapshot, then unmount. Call with every file closed.
+void LFS_W25Q64_FastUnmount(lfs_t *lfs);
+void LFS_W25Q64_BindSnapshot(const LFS_W25Q64_SnapshotStore *store);
+
+// Background erase of every block littlefs does not use, so later writes
+// skip their erases. Start needs the volume mounted (it walks the used
+// blocks once) and must be cancelled before littlefs writes again. Step
+// issues at most one erase and never waits for it; returns 1 while busy.
+int     LFS_W25Q64_PreEraseStart(lfs_t *lfs);
+int     LFS_W25Q64_PreEraseStep(void);
+void    LFS_W25Q64_PreEraseCancel(void);
+uint8_t LFS_W25Q64_PreEraseProgress(void);   /* percent, 100 when idle */
+
+// Maintenance: what littlefs would otherwise do on a logging wake, done
+// while there is time or power to spare. lfs_fs_gc first (pending orphans,
+// metadata past LFS_W25Q64_COMPACT_THRESH compacted now rather than in the
+// next commit), then free blocks that do not read blank are erased, from
+// where the allocator of the next FastMount starts. A free block is erased
+// before littlefs uses it again in any case; erased here, its allocation
+// finds it blank and skips the erase, so no block is erased twice.
+// Start queues 'ahead' free blocks (0: all of them) for PreEraseStep and
+// has the same rules as PreEraseStart. With 'ahead' set, FastUnmount should
+// follow with no other littlefs call in between, so the snapshot keeps the
+// allocator seed the queue was built from.
+int  LFS_W25Q64_MaintainStart(lfs_t *lfs, uint32_t ahead);
+// Battery pass: Start with LFS_W25Q64_MAINT_AHEAD, Step until done or
+// budget_us has gone, wait out the last erase. Returns blocks erased (the
+// compaction erases of lfs_fs_gc included) or a littlefs error.
+int  LFS_W25Q64_Maintain(lfs_t *lfs, uint32_t budget_us);
+// End of a storage wake's own writes: this wake's erases go to the kept
+// log counters. Returns the storage wakes since the last maintenance pass.
+uint32_t LFS_W25Q64_MaintNoteWake(void);
+void LFS_W25Q64_GetMaintStats(LFS_W25Q64_MaintStats *out);
+void LFS_W25Q64_BindMaint(const LFS_W25Q64_MaintStore *store);
+void LFS_W25Q64_GetEraseStats(LFS_W25Q64_EraseStats *out);
+// Window size in bytes, clamped to LFS_W25Q64_READAHEAD; 0 disables.
+void LFS_W25Q64_SetReadAhead(uint32_t bytes);
+// Drop the window, e.g. after writing the flash without going through littlefs.
+void LFS_W25Q64_ReadAheadInvalidate(void);
+void LFS_W25Q64_GetReadStats(LFS_W25Q64_ReadStats *out);
+void LFS_W25Q64_ResetReadStats(void);
+// Used-block accounting. Writers report how a file grew (its CTZ blocks are
+// added) and a remove with a known size as a shrink to 0; other removals,
+// truncation and formats drop the count and the next UsedBlocks walks.
+// Every LFS_W25Q64_USAGE_RECOUNT reports it walks anyway to catch drift
+// (metadata, copy-on-write).
+void LFS_W25Q64_BindUsage(const LFS_W25Q64_UsageStore *store);
+void LFS_W25Q64_UsageFileGrew(const lfs_t *lfs, lfs_soff_t old_size, lfs_soff_t new_size);
+void LFS_W25Q64_UsageInvalidate(void);
+// Blocks in use on the mounted volume, walking only when the count is missing or due.
+lfs_ssize_t LFS_W25Q64_UsedBlocks(lfs_t *lfs);
+void LFS_W25Q64_GetUsageStats(LFS_W25Q64_UsageStats *out);
 // Returns 1 if filesystem is near full (used >= total - reserve_blocks), else 0.
 // Requires that littlefs is already mounted on global 'lfs' with valid 'lfs_cfg'.
 uint8_t FS_IsNearFull(uint32_t reserve_blocks);
@@ -55,5 +222,5 @@ uint8_t FS_IsNearFull(uint32_t reserve_blocks);
 }
 #endif
 
-#endif /* LFS_W25Q128_H */
+#endif /* LFS_W25Q64_H */
 
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Compact record stream for wake.z. Every flush is cut into frames of at
+ * most LOG_CODEC_KEY_EVERY records; a frame opens with a full record (the
+ * keyframe) and carries the rest as two zigzag varints each:
+ *   zigzag(t_x100 step) << 1 | 1 if the wake interval changed, and then
+ *   zigzag(change of the interval) only when it did;
+ *   zigzag(rh_x100 step).
+ * A steady interval with temperature steps under 0.32 C and RH steps under
+ * 0.64 %RH takes 2 bytes a record instead of 8, 3-4 for larger steps.
+ * Frames stand alone, so a reader can start at any of them and a damaged
+ * one (CRC) only loses its own records.
+ *
+ * Frame: sync (0xD0 | version), record count, payload length (LE16),
+ * CRC-16/CCITT of the payload (LE16), then the payload: keyframe (8 bytes,
+ * as logrec_t) and count - 1 deltas.
+ *
+ * The codec is plain C with no HAL: the same file decodes on the host.
+ * LOG_COMPRESS 1 stores records in LOG_Z_FILE instead of wake.bin; GETLOG
+ * decodes on the device and still streams 8-byte records. wake.idx and
+ * wake.seg index fixed-size records and are not kept in this mode.
+ *
+ * GETLOG COMPRESS sends any log in these frames, encoded as it streams
+ * (wake.z is decoded and encoded again, so a frame never spans a torn
+ * flush); tools/getlog/getlog_unz.c turns a dump back into records. */
+#ifndef LOG_COMPRESS
+#define LOG_COMPRESS          0
+#endif
+#define LOG_Z_FILE            "wake.z"
+
+#define LOG_CODEC_VERSION     1u
+#define LOG_CODEC_SYNC        (0xD0u | LOG_CODEC_VERSION)
+#ifndef LOG_CODEC_KEY_EVERY
+#define LOG_CODEC_KEY_EVERY   32u     /* records per frame, <= 255 */
+#endif
+#define LOG_CODEC_HDR         6u
+#define LOG_CODEC_KEY_SIZE    8u
+#define LOG_CODEC_DELTA_MAX   11u     /* varints: 3 (t, flag) + 5 (interval) + 3 (rh) */
+#define LOG_CODEC_FRAME_MAX   (LOG_CODEC_HDR + LOG_CODEC_KEY_SIZE + (LOG_CODEC_KEY_EVERY - 1u) * LOG_CODEC_DELTA_MAX)
+
+typedef struct __attribute__((packed)) {
+    uint32_t epoch;
+    int16_t  t_x100;
+    uint16_t rh_x100;
+} LogCodec_Rec;                       /* same layout as logrec_t */
+
+// Encode n (1..LOG_CODEC_KEY_EVERY) records as one frame into out
+// (LOG_CODEC_FRAME_MAX bytes). Returns the frame length.
+uint32_t LogCodec_EncodeFrame(const LogCodec_Rec *recs, uint32_t n, uint8_t *out);
+
+typedef void (*LogCodec_Sink)(const LogCodec_Rec *rec, void *ctx);
+
+/* Streaming decoder: bytes can be fed in pieces of any size */
+typedef struct {
+    uint32_t have;                    /* bytes of the current frame buffered */
+    uint32_t need;                    /* frame length once the header is in */
+    uint32_t frames, records, errors;
+    uint8_t  buf[LOG_CODEC_FRAME_MAX];
+} LogCodec_Decoder;
+
+void LogCodec_DecoderInit(LogCodec_Decoder *d);
+// Feed len bytes; every record decoded goes to sink. A bad frame header
+// resynchronises on the next sync byte and counts an error.
+void LogCodec_Decode(LogCodec_Decoder *d, const uint8_t *in, uint32_t len,
+                     LogCodec_Sink sink, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Framed GETLOG (GETLOG OFFSET=<n> LEN=<m> FRAMED). The byte window of the
+ * log goes out as LOG_FRAME_SIZE frames, one per USB transfer:
+ *   sync (0xE0 | version), type, payload length (LE16),
+ *   sequence number from 0 (LE32),
+ *   log byte offset of the first payload byte (LE32),
+ *   LOG_FRAME_PAYLOAD bytes, 0xFF past the length,
+ *   CRC-32 (zlib) of all the bytes before it (LE32).
+ * Data frames carry whole records; the last one of a window is short. An
+ * END frame closes every transfer, its payload a LogFrame_Trailer. A host
+ * keeps the frames whose CRC and sequence check out and asks again from
+ * the offset of the first one missing, on this or a later connection.
+ *
+ * Offsets count the whole log as plain GETLOG sends it: archived segments
+ * oldest first, then wake.bin. With WRAP a segment can go between two
+ * requests and move every offset: the trailer's base (the oldest segment)
+ * changes when that happens.
+ *
+ * Plain C with no HAL: the same file checks frames on the host. */
+#define LOG_FRAME_VERSION     1u
+#define LOG_FRAME_SYNC        (0xE0u | LOG_FRAME_VERSION)
+#define LOG_FRAME_SIZE        512u   /* one GETLOG TX half */
+#define LOG_FRAME_HDR         12u
+#define LOG_FRAME_CRC         4u
+#define LOG_FRAME_PAYLOAD     (LOG_FRAME_SIZE - LOG_FRAME_HDR - LOG_FRAME_CRC)   /* 62 records */
+
+#define LOG_FRAME_T_DATA      1u
+#define LOG_FRAME_T_END       2u
+
+typedef struct {
+    uint32_t total;           /* records in the whole log */
+    uint32_t base;            /* name of the oldest archived segment, 0 if none */
+    uint32_t offset, len;     /* window sent, bytes */
+    uint32_t frames;          /* data frames before this one */
+    int32_t  status;          /* 0, or the littlefs error that cut it short */
+} LogFrame_Trailer;
+
+typedef struct {
+    uint8_t  type;
+    uint16_t len;
+    uint32_t seq, offset;
+} LogFrame_Hdr;
+
+// Fill in the header, padding and CRC of a frame whose payload
+// (frame + LOG_FRAME_HDR, len bytes) is already in place
+void LogFrame_Seal(uint8_t *frame, uint8_t type, uint32_t seq, uint32_t offset, uint32_t len);
+// A whole frame as received: true if sync, length and CRC are good
+bool LogFrame_Check(const uint8_t *frame, LogFrame_Hdr *hdr);
+uint32_t LogFrame_Crc32(const uint8_t *p, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "lfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Time queries over wake.bin. Records are fixed size with the epoch in the
+ * first 4 bytes, and epochs only grow except where SETTIME moved the clock.
+ *
+ * LOG_IDX_FILE holds one entry per LOG_IDX_RECORDS records of wake.bin with
+ * the smallest and largest epoch in that block, appended as blocks fill up.
+ * A query scans the entries and reads only the blocks that can match, so
+ * clock jumps cost nothing extra. Records past the last entry are found
+ * through LOG_SEG_FILE instead: it lists the record index where each
+ * monotone segment starts, and every segment is binary searched on its own.
+ * Past LOG_SEG_MAX segments that list is no longer trusted and the rest of
+ * the file comes back with 'check' set: the caller filters it record by
+ * record. */
+#define LOG_REC_SIZE   8u          /* logrec_t */
+#define LOG_FILE       "wake.bin"
+#define LOG_IDX_FILE   "wake.idx"
+#define LOG_SEG_FILE   "wake.seg"
+#ifndef LOG_IDX_RECORDS
+#define LOG_IDX_RECORDS  256u      /* 2 KiB of wake.bin per index entry */
+#endif
+#ifndef LOG_SEG_MAX
+#define LOG_SEG_MAX    32u
+#endif
+
+typedef struct {
+    uint32_t rec;             /* first record of the block, a multiple of LOG_IDX_RECORDS */
+    uint32_t min, max;        /* epoch range of its LOG_IDX_RECORDS records */
+} LogQuery_IndexEntry;
+
+/* Records [from, to) of the open log; check = 1: not all of them match */
+typedef void (*LogQuery_Sink)(lfs_file_t *f, uint32_t from, uint32_t to, bool check, void *ctx);
+
+typedef struct {
+    uint32_t indexed;         /* records covered by wake.idx */
+    uint32_t segments;        /* segments searched past it, 0 = list overflowed */
+    uint32_t probes;          /* records read by the searches */
+} LogQuery_Stats;
+
+// Hand the sink, in file order, every range holding records with epoch in
+// [lo, hi]. 'f' is wake.bin open for reading. Returns the records handed out.
+uint32_t LogQuery_Ranges(lfs_t *lfs, lfs_file_t *f, uint32_t lo, uint32_t hi,
+                         LogQuery_Sink sink, void *ctx, LogQuery_Stats *st);
+// The same for a log whose epochs never go down (an archived segment with
+// LOG_MAN_SORTED): two binary searches, no wake.idx or wake.seg.
+uint32_t LogQuery_Sorted(lfs_t *lfs, lfs_file_t *f, uint32_t lo, uint32_t hi,
+                         LogQuery_Sink sink, void *ctx, LogQuery_Stats *st);
+static inline bool LogQuery_Match(uint32_t epoch, uint32_t lo, uint32_t hi) { return epoch >= lo && epoch <= hi; }
+// Records appended after this call start a new segment (SETTIME). Mounted volume.
+int      LogQuery_MarkSegment(lfs_t *lfs);
+// Append index entries for the full blocks of wake.bin not indexed yet.
+// An index that does not match wake.bin is rebuilt; 'verify' checks every
+// entry instead of the last one. Returns the entry count or a littlefs error.
+int      LogQuery_IndexUpdate(lfs_t *lfs, bool verify, bool *rebuilt);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,116 @@
+#pragma once
+#include <stdint.h>
+#include "lfs.h"
+#include "log_query.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The record log, one file or a run of segments. Segments are opt-in:
+ * with LOG_SEGMENT_BYTES and LOG_SEGMENT_SECONDS both 0 and the policy
+ * STOP the log stays one WAKE_BATCH_FILE and LogRotate_Check returns at
+ * once. With segments the active one is WAKE_BATCH_FILE; before a flush
+ * it is renamed to LOG_ARCHIVE_DIR/<epoch of its first record> once it
+ * holds LogRotate_SegmentBytes() or, with LOG_SEGMENT_SECONDS set, when
+ * the batch starts in another bucket of that many seconds than it did. A
+ * segment may run one batch past its bucket: the manifest, not the name,
+ * bounds it. The bucket is kept beside the policy word, so a flush opens
+ * no file to find it.
+ *
+ * LOG_MAN_FILE lists the archived segments oldest first, one entry each
+ * with the epoch range of its records, so GETLOG opens only the segments
+ * a query can touch. Removing the oldest appends a tombstone (records ==
+ * LOG_MAN_DROP) instead of rewriting the list; the list is rewritten once
+ * LOG_MAN_COMPACT tombstones have piled up.
+ *
+ * Segments do not make a flush cheaper: after every mount littlefs scans
+ * all files for free blocks, and each segment adds its directory entry to
+ * that scan (bench "segments"). Nor do they make a query cheaper than one
+ * file searched through wake.idx and wake.seg. WRAP needs them anyway, as
+ * it drops the log a segment at a time: under WRAP with LOG_SEGMENT_BYTES
+ * 0 the log is cut every LOG_WRAP_SEGMENT_BYTES, and switching from STOP
+ * archives the log so far as one segment.
+ *
+ * Retention once the volume is near full:
+ *   STOP: as before, logging ends and the unit waits in Standby for USB.
+ *   WRAP: the oldest segment is removed until there is room.
+ * Rename and remove are metadata commits: a segment leaves without a data
+ * block being read, copied or erased; littlefs erases its blocks when it
+ * hands them out again, as it would for any free block. wake.idx and
+ * wake.seg describe the active segment only and go with it at each
+ * rotation. The ring log (RINGLOG_ENABLE) always wraps, one sector at a
+ * time. */
+typedef enum {
+    LOG_RETAIN_STOP = 0,
+    LOG_RETAIN_WRAP,
+} LogRotate_Policy;
+
+#ifndef LOG_SEGMENT_BYTES
+#define LOG_SEGMENT_BYTES    0u              /* 0: one file while the policy is STOP */
+#endif
+#ifndef LOG_WRAP_SEGMENT_BYTES
+#define LOG_WRAP_SEGMENT_BYTES (64u * 1024u) /* WRAP's segments when LOG_SEGMENT_BYTES is 0 */
+#endif
+#ifndef LOG_SEGMENT_SECONDS
+#define LOG_SEGMENT_SECONDS  0u              /* by size only; 86400u: day buckets */
+#endif
+#ifndef LOG_MAN_COMPACT
+#define LOG_MAN_COMPACT      32u             /* tombstones before the rewrite */
+#endif
+#define LOG_ARCHIVE_DIR      "log"
+#define LOG_ARCHIVE_NAME_MAX 16u             /* "log/" + 10 digits + NUL */
+#define LOG_MAN_FILE         "wake.man"
+#define LOG_MAN_DROP         0xFFFFFFFFu
+#define LOG_MAN_SORTED       0x1u            /* flags: epochs never go down */
+
+typedef struct {
+    uint32_t name;            /* LOG_ARCHIVE_DIR/<name>, epoch of its first record */
+    uint32_t min, max;        /* epoch range of its records */
+    uint32_t records;         /* LOG_MAN_DROP: tombstone */
+    uint32_t flags;           /* LOG_MAN_SORTED: binary search it (LogQuery_Sorted) */
+} LogRotate_Segment;
+
+/* Policy, and the active segment's bucket, kept across Standby (RTC
+ * backup register); RAM only if unbound */
+typedef struct {
+    uint32_t (*get)(void);
+    void     (*set)(uint32_t word);
+} LogRotate_PolicyStore;
+
+void LogRotate_BindPolicy(const LogRotate_PolicyStore *store);
+void LogRotate_SetPolicy(LogRotate_Policy policy);
+LogRotate_Policy LogRotate_GetPolicy(void);
+// Size a segment is cut at under the current policy, 0: never
+uint32_t LogRotate_SegmentBytes(void);
+
+typedef void (*LogRotate_Visit)(const LogRotate_Segment *seg, void *ctx);
+
+void LogRotate_Name(char *buf, uint32_t name);
+// Archived segments on the mounted volume, oldest first; an end entry
+// whose file a reset left gone is not visited or counted. visit may be
+// NULL and may open other files. Returns their count or a littlefs error.
+int  LogRotate_Segments(lfs_t *lfs, LogRotate_Visit visit, void *ctx);
+// Before appending records from 'next_epoch' on: archive the active
+// segment if it is full or 'next_epoch' opens a new bucket. Returns 1 if
+// it did, 0 if not, or a littlefs error.
+int  LogRotate_Check(lfs_t *lfs, uint32_t next_epoch);
+int  LogRotate_Rotate(lfs_t *lfs);
+// Remove the oldest segment; with none archived the active one is rotated
+// out first. Returns 1 if one went, 0 if there was nothing left, or a
+// littlefs error.
+int  LogRotate_Evict(lfs_t *lfs);
+// Records [first, first + count) of the whole log, archived segments
+// oldest first and then the active one, handed to sink file by file
+// (check is always false). count 0 runs to the end. Positions come from
+// the manifest: only segments the window touches are opened. Returns the
+// records in the whole log or a littlefs error; *base gets the oldest
+// segment's name, 0 without one. wake.bin only, not LOG_COMPRESS.
+int  LogRotate_Window(lfs_t *lfs, uint32_t first, uint32_t count,
+                      LogQuery_Sink sink, void *ctx, uint32_t *base);
+// ERASELOG: every archived segment, the directory and the manifest.
+int  LogRotate_RemoveAll(lfs_t *lfs);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,5 +1,12 @@
 #pragma once
 #include "main.h"
 
+extern LPTIM_HandleTypeDef hlptim1;
+
 void Pins_StandbyQuiescent_Config(void);
 void SPI1_EnterLowPower(void);
+
+/* Timed low-power wait on LPTIM1 (LSE, ~30.5 us resolution). Uses Stop mode
+ * when running from MSI and plain Sleep while the USB PLL clock is active. */
+void     LP_SleepUs(uint32_t us);
+uint32_t LP_NowUs(void);   /* microseconds, HAL tick based, Stop time included */
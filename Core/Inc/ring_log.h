@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Append-only record log on a raw flash partition, next to a littlefs
+ * volume that keeps the low LFS_W25Q64_BLOCK_COUNT blocks for config.
+ *
+ * The partition is a ring of 4 KiB sectors of 16 pages. Every append is a
+ * single page program of whole records: an 8-byte page header (length and
+ * a CRC over sector sequence, page index and payload) and up to 248 bytes
+ * of records. The first page of a sector also carries the sector header
+ * (magic and a sequence number that grows by one per sector opened).
+ * Recovery finds the write head by binary search over the sector headers,
+ * then over the page headers of the head sector. When the ring is full the
+ * oldest sector is erased and reused.
+ *
+ * RINGLOG_ENABLE 1 moves wake records from wake.bin into the ring. It needs
+ * a littlefs partition (LFS_W25Q64_BLOCK_COUNT); switching a deployed unit
+ * reformats its littlefs volume.
+ */
+#ifndef RINGLOG_ENABLE
+#define RINGLOG_ENABLE        0
+#endif
+#ifndef RINGLOG_REC_SIZE
+#define RINGLOG_REC_SIZE      8u      /* logrec_t; pages hold whole records */
+#endif
+
+#define RINGLOG_SECTOR_SIZE   4096u
+#define RINGLOG_PAGE_SIZE      256u
+#define RINGLOG_PAGES         (RINGLOG_SECTOR_SIZE / RINGLOG_PAGE_SIZE)
+/* Records that fit any page, the first of a sector included */
+#define RINGLOG_PAGE_RECORDS  ((RINGLOG_PAGE_SIZE - 16u) / RINGLOG_REC_SIZE)
+
+typedef struct {
+    uint32_t sector;          /* next sector to visit */
+    uint32_t page;            /* next page in it */
+    uint32_t seq;             /* its sequence, 0 = header not read yet */
+    uint32_t left;            /* sectors still to visit */
+} RingLog_Cursor;
+
+typedef struct {
+    uint32_t sectors;         /* in the partition */
+    uint32_t used_sectors;    /* holding records */
+    uint32_t head_seq;        /* sequence number of the head sector */
+    uint32_t mount_reads;     /* flash reads the last recovery needed */
+} RingLog_Info;
+
+// Partition [base, base + bytes), both sector aligned. Flash must be awake
+// for every call below.
+int  RingLog_Init(uint32_t base, uint32_t bytes);
+// Recover the write head. Append and reads mount on first use.
+int  RingLog_Mount(void);
+// Append 'bytes' of whole records, one page program per page filled.
+// Returns 0, or -1 if the partition is not set up.
+int  RingLog_Append(const void *recs, uint32_t bytes);
+// Oldest to newest. Read fills buf (RINGLOG_PAGE_SIZE bytes) with the
+// records of the next valid page and returns their length, 0 at the end.
+void RingLog_ReadBegin(RingLog_Cursor *c);
+int  RingLog_Read(RingLog_Cursor *c, uint8_t *buf);
+// Erase every sector in use; the ring starts empty again.
+void RingLog_Erase(void);
+void RingLog_GetInfo(RingLog_Info *out);
+
+#ifdef __cplusplus
+}
+#endif
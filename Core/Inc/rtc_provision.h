@@ -19,6 +19,17 @@
 #define RTC_END_MAGIC          0xE0E0
 
 #define RTC_INTERVAL_DR        RTC_BKP_DR7   // logging interval (seconds)
+#define RTC_ERASE_MARK_DR      RTC_BKP_DR8   // flash erase in flight (lfs_w25q64.c)
+#define RTC_FLASH_AWAKE_LAST   RTC_BKP_DR9   // flash out of DPD last wake (us)
+#define RTC_FLASH_AWAKE_LO     RTC_BKP_DR10  // summed over wakes (us), low 32 bits
+#define RTC_FLASH_AWAKE_HI     RTC_BKP_DR11  // high 32 bits
+#define RTC_FLASH_WAKES_DR     RTC_BKP_DR12  // wakes in the sum
+#define RTC_MOUNT_SNAP_DR      RTC_BKP_DR13  // littlefs mount snapshot, DR13..DR27
+#define RTC_MOUNT_SNAP_WORDS   15u
+#define RTC_FS_USAGE_DR        RTC_BKP_DR28  // littlefs used-block count (lfs_w25q64.c)
+#define RTC_RETENTION_DR       RTC_BKP_DR29  // full-volume policy (log_rotate.c)
+#define RTC_MAINT_DR           RTC_BKP_DR30  // littlefs maintenance counters, DR30..DR31
+#define RTC_MAINT_WORDS        2u
 
 /* Provisioning & time */
 int  RTC_IsProvisioned(void);
@@ -42,6 +53,31 @@ void RTC_ClearEndEpoch(void);
 void     RTC_SetLoggingInterval(uint32_t sec);
 uint32_t RTC_GetLoggingInterval(void);
 
+/* Flash erase marker: survives a reset during an erase (0 = none) */
+void     RTC_SetEraseMarker(uint32_t mark);
+uint32_t RTC_GetEraseMarker(void);
+
+/* Flash awake time per wake, kept across standby until a backup-domain reset;
+ * the last-wake word saturates at UINT32_MAX us, the total does not */
+void RTC_AddFlashAwake(uint64_t us);
+void RTC_GetFlashAwake(uint32_t *last_us, uint64_t *total_us, uint32_t *wakes);
+
+/* littlefs mount snapshot (lfs_w25q64.c), n <= RTC_MOUNT_SNAP_WORDS */
+void RTC_LoadMountSnapshot(uint32_t *words, uint32_t n);
+void RTC_SaveMountSnapshot(const uint32_t *words, uint32_t n);
+
+/* littlefs used-block count (lfs_w25q64.c), 0 = none */
+uint32_t RTC_GetFsUsage(void);
+void     RTC_SetFsUsage(uint32_t word);
+
+/* Retention policy word and segment bucket (log_rotate.c), 0 = STOP */
+uint32_t RTC_GetRetention(void);
+void     RTC_SetRetention(uint32_t word);
+
+/* littlefs maintenance counters (lfs_w25q64.c), n <= RTC_MAINT_WORDS */
+void RTC_LoadMaint(uint32_t *words, uint32_t n);
+void RTC_SaveMaint(const uint32_t *words, uint32_t n);
+
 /* Helpers (status & eligibility) */
 int  RTC_ShouldLogNow(void);
 int  RTC_BuildStatus(char* out, size_t maxlen);
@@ -14,11 +14,28 @@ typedef enum {
     USB_SM_EXIT
 } usb_sm_state_t;
 
+/* Command latency (line received -> handler returned), in ms buckets:
+ * <1 <2 <5 <10 <20 <50 <100 <200 <500 >=500. Kept apart for commands that
+ * arrived while the idle hook reported background work. */
+#define USB_SM_LAT_BUCKETS 10
+typedef struct {
+    uint32_t idle[USB_SM_LAT_BUCKETS];
+    uint32_t busy[USB_SM_LAT_BUCKETS];
+    uint32_t max_idle_ms, max_busy_ms;
+} usb_sm_latency_t;
+
+/* Background work run between commands; return true while work remains */
+typedef bool (*usb_sm_idle_hook_t)(void);
+
 void USB_SM_Start(void);
 void USB_SM_Stop(void);
 bool USB_SM_IsActive(void);
 void USB_SM_PostCmdLine(const char *line);
 void USB_SM_RunStep(void);
+void USB_SM_SetIdleHook(usb_sm_idle_hook_t hook);
+bool USB_SM_IdleBusy(void);
+void USB_SM_GetLatency(usb_sm_latency_t *out);
+void USB_SM_ResetLatency(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Command replies on EP 0x81: a single-producer single-consumer byte ring
+ * between the main loop, which writes, and the USB interrupt, which sends.
+ * USB_Write copies the reply and returns; the transmit-complete interrupt
+ * starts the next contiguous run, so a reply only waits (in WFI) when the
+ * ring is full. head is written by the main loop only, tail by whoever
+ * owns the transfer (the interrupt, or the main loop with it masked).
+ *
+ * The GETLOG stream drains the ring first (USB_Tx_Flush) and then runs
+ * EP 0x81 from its own double buffer; its TX-complete handler passes
+ * completions on to USB_Tx_Cplt while no stream is active. */
+#ifndef USB_TX_RING_SIZE
+#define USB_TX_RING_SIZE   1024u   /* power of two: HELP and STATS fit whole */
+#endif
+#ifndef USB_TX_CHUNK_MAX
+#define USB_TX_CHUNK_MAX   512u    /* bytes per bulk transfer */
+#endif
+#ifndef USB_TX_TIMEOUT_MS
+#define USB_TX_TIMEOUT_MS  250u    /* ring full, host not reading: drop the rest */
+#endif
+
+typedef struct {
+    uint32_t queued, sent;        /* bytes */
+    uint32_t transfers, chained;  /* chained: started from the interrupt */
+    uint32_t waits, dropped;      /* writes that found the ring full; bytes lost */
+    uint32_t depth, high_water;   /* bytes in the ring now, at most */
+} USB_TxStats;
+
+// Queue len bytes, sleeping while the ring is full. Returns the bytes queued.
+uint32_t USB_Tx_Write(const void *data, uint32_t len);
+void     USB_Write(const char *s);
+// Start a transfer if none is in flight (after a refused start, say)
+void     USB_Tx_Kick(void);
+// Until everything queued has gone out. 0, or -1 on timeout or disconnect.
+int      USB_Tx_Flush(uint32_t timeout_ms);
+// New session: drop whatever is left and clear the statistics
+void     USB_Tx_Reset(void);
+// USB interrupt: the transfer in flight has completed
+void     USB_Tx_Cplt(void);
+void     USB_Tx_GetStats(USB_TxStats *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -9,20 +9,197 @@
 extern "C" {
 #endif
 
+/* Read command used by W25Q64_Read.
+ *  - NORMAL   0x03: no dummy cycles, limited to fR (50 MHz on W25Q64JV)
+ *  - FAST     0x0B: 8 dummy clocks, valid up to the full SPI clock
+ *  - DUAL_OUT 0x3B: 8 dummy clocks, data returned on IO0/IO1
+ *  - QUAD_OUT 0x6B: 8 dummy clocks, data returned on IO0..IO3 (sets QE)
+ * Dual/Quad output need a bus that can sample several data lines, see
+ * W25Q64_BindMultiIO(). SPI1 on this board is single-line only.
+ */
+typedef enum {
+    W25Q64_READ_NORMAL = 0,
+    W25Q64_READ_FAST,
+    W25Q64_READ_DUAL_OUT,
+    W25Q64_READ_QUAD_OUT,
+    W25Q64_READ_MODE_COUNT
+} W25Q64_ReadMode;
+
+/* Override at compile time to pick the boot-time read mode. */
+#ifndef W25Q64_READ_MODE_DEFAULT
+#define W25Q64_READ_MODE_DEFAULT   W25Q64_READ_NORMAL
+#endif
+
+/* Receive 'len' data bytes on 'lanes' (2 or 4) data lines while CS is held low.
+ * Command, address and dummy bytes have already been clocked out on IO0.
+ * Return 0 on success.
+ */
+typedef int (*W25Q64_MultiRxFn)(uint8_t lanes, uint8_t *buf, size_t len);
+
+/* Data-phase transfer accounting: which path (DMA or polled) moved the bytes */
+typedef struct {
+    uint32_t dma_xfers;
+    uint32_t dma_bytes;
+    uint32_t dma_errors;
+    uint32_t polled_xfers;
+    uint32_t polled_bytes;
+    uint32_t multi_errors;   /* dual/quad reads that failed and went again on one line */
+} W25Q64_XferStats;
+
+/* Operations that leave the part busy (WIP=1), each with its own wait policy */
+typedef enum {
+    W25Q64_OP_PAGE_PROGRAM = 0,   /* tPP  0.4 ms typ /   3 ms max */
+    W25Q64_OP_ERASE_4K,           /* tSE   45 ms typ / 400 ms max */
+    W25Q64_OP_ERASE_32K,          /* tBE1 120 ms typ / 1.6 s max  */
+    W25Q64_OP_ERASE_64K,          /* tBE2 150 ms typ /   2 s max  */
+    W25Q64_OP_WRITE_SR,           /* tW    10 ms typ /  15 ms max */
+    W25Q64_OP_ERASE_CHIP,         /* tCE   20 s typ  / 100 s max  (W25Q64) */
+    W25Q64_OP_SUSPEND,            /* tSUS 20 us max: 0x75 until reads may start */
+    W25Q64_OP_COUNT
+} W25Q64_BusyOp;
+
+/* Sleep first for roughly the typical time, then poll RDSR at a bounded
+ * cadence. Zero sleep/poll values give back-to-back polling. */
+typedef struct {
+    uint32_t sleep_first_us;   /* sleep before the first RDSR poll */
+    uint32_t poll_us;          /* sleep between further polls */
+    uint32_t timeout_us;       /* stop waiting after this (0 = never) */
+} W25Q64_BusyPolicy;
+
+typedef struct {
+    uint32_t ops;              /* completed waits */
+    uint32_t polls;            /* RDSR frames issued */
+    uint32_t timeouts;
+    uint32_t max_wait_us;
+    uint64_t waited_us;        /* command to WIP clear, summed over ops */
+} W25Q64_BusyStats;
+
+typedef struct {
+    uint32_t suspends;         /* background erases suspended for a read */
+    uint32_t deferred;         /* suspends held back by W25Q64_RESUME_MIN_US */
+    uint32_t max_suspend_us;   /* 0x75 to array ready for reads */
+} W25Q64_SuspendStats;
+
+/* Power state as last commanded by the driver. After an MCU reset the
+ * driver cannot know whether the part was left in deep power-down, so the
+ * first release always goes on the bus. */
+typedef enum {
+    W25Q64_POWER_UNKNOWN = 0,
+    W25Q64_POWER_AWAKE,
+    W25Q64_POWER_DPD
+} W25Q64_PowerState;
+
+typedef struct {
+    uint32_t releases;         /* 0xAB frames sent */
+    uint32_t enters;           /* 0xB9 frames sent */
+    uint32_t coalesced;        /* calls skipped: already in the requested state */
+    uint64_t awake_us;         /* time out of deep power-down since boot/reset */
+} W25Q64_PowerStats;
+
+/* Board services used while the part is busy. With no sleep hook bound the
+ * driver keeps polling; with no clock bound it falls back to HAL_GetTick. */
+typedef struct {
+    void     (*sleep_us)(uint32_t us);   /* low-power timed sleep */
+    uint32_t (*now_us)(void);            /* free-running microsecond counter */
+} W25Q64_Platform;
+
+/* Part geometry. W25Q64_Probe fills it from the SFDP Basic Flash Parameter
+ * Table, or from the JEDEC capacity code on parts without SFDP. Until a
+ * probe succeeds the driver assumes a W25Q64 (8 MiB, 256 B pages). */
+#define W25Q64_ERASE_TYPES   4u
+
+typedef struct {
+    uint8_t  jedec[3];
+    uint8_t  from_sfdp;                          /* 1 if the BFPT was parsed */
+    uint32_t capacity;                           /* bytes, clamped to 3-byte addressing */
+    uint32_t page_size;                          /* page program size */
+    uint32_t erase_size[W25Q64_ERASE_TYPES];     /* ascending, 0 = unused slot */
+    uint8_t  erase_opcode[W25Q64_ERASE_TYPES];
+    uint8_t  read_modes;                         /* bit n set: W25Q64_ReadMode n supported */
+} W25Q64_Geometry;
+
 /** \brief Bind the flash driver to a SPI handle and CS GPIO.
  *  The driver does not initialize SPI clocks or pins; do that in Cube or elsewhere.
  */
 void W25Q64_Bind(SPI_HandleTypeDef *hspi, GPIO_TypeDef *cs_gpio, uint16_t cs_pin);
 
+/* Optional multi-line data receive path (QUADSPI, bit-banged IO, host emulator).
+ * Pass NULL to unbind; the driver then drops back to a single-line read mode.
+ */
+void W25Q64_BindMultiIO(W25Q64_MultiRxFn rx);
+
+/* Use DMA for read and page-program data phases; the core sleeps (WFI) until
+ * the SPI completion callback. Requires hdmarx/hdmatx linked to the SPI handle
+ * (HAL_SPI_MspInit); otherwise the polled path stays in use.
+ */
+void W25Q64_EnableDMA(uint8_t enable);
+void W25Q64_GetXferStats(W25Q64_XferStats *out);
+void W25Q64_ResetXferStats(void);
+
+/* Busy-wait engine */
+void W25Q64_BindPlatform(const W25Q64_Platform *platform);
+void W25Q64_SetBusyPolicy(W25Q64_BusyOp op, const W25Q64_BusyPolicy *policy);
+void W25Q64_GetBusyStats(W25Q64_BusyOp op, W25Q64_BusyStats *out);
+void W25Q64_ResetBusyStats(void);
+
+/* Background erase (4K/32K/64K only; chip erase cannot be suspended).
+ * EraseStart returns as soon as the command is on the bus. While the erase
+ * runs, W25Q64_Read suspends it (0x75) unless the read hits the block being
+ * erased; EraseDone resumes it (0x7A) and reports completion without
+ * blocking. Every other command finishes the erase first. EraseStart
+ * returns -1 if the probed part has no erase of that size.
+ */
+int  W25Q64_EraseStart(W25Q64_BusyOp op, uint32_t addr);
+int  W25Q64_EraseDone(void);          /* 1 = idle, 0 = still erasing */
+void W25Q64_EraseWait(void);
+uint32_t W25Q64_NowUs(void);          /* platform clock, HAL tick without one */
+void W25Q64_EnableSuspend(uint8_t enable);
+void W25Q64_GetSuspendStats(W25Q64_SuspendStats *out);
+
+/* Identify the part (must be out of deep power-down). Returns 0 and updates
+ * the driver geometry if a device answered, -1 otherwise (geometry unchanged).
+ * 'out' may be NULL; it always receives the geometry in use.
+ */
+int  W25Q64_Probe(W25Q64_Geometry *out);
+void W25Q64_GetGeometry(W25Q64_Geometry *out);
+/* A geometry an earlier W25Q64_Probe returned (kept across Standby by the
+ * caller): taken as is, nothing goes on the bus */
+void W25Q64_SetGeometry(const W25Q64_Geometry *g);
+
+/* Runtime read-mode switch. Returns 0 on success, -1 if the mode needs a
+ * multi-line bus that is not bound or the probed part lacks it (the current
+ * mode is left unchanged).
+ */
+int             W25Q64_SetReadMode(W25Q64_ReadMode mode);
+W25Q64_ReadMode W25Q64_GetReadMode(void);
+
 /* Low-level commands */
-void W25Q64_WaitWhileBusy(void);
 void W25Q64_WriteEnable(void);
+/* Both are no-ops when the part is already in the requested state. The
+ * release waits tRES (3 us) on the platform clock, 1 ms without one. */
 void W25Q64_ReleaseFromDeepPowerDown(void);   /* 0xAB */
 void W25Q64_EnterDeepPowerDown(void);         /* 0xB9 */
+W25Q64_PowerState W25Q64_GetPowerState(void);
+/* The caller knows better than the driver, e.g. Standby is only ever entered
+ * with the part in deep power-down. W25Q64_Bind resets it to UNKNOWN. */
+void W25Q64_AssumePowerState(W25Q64_PowerState state);
+void W25Q64_GetPowerStats(W25Q64_PowerStats *out);   /* awake_us includes the current awake span */
+void W25Q64_ResetPowerStats(void);
 
-void W25Q64_Read(uint32_t addr, uint8_t *buf, size_t len);       /* 0x03 */
-void W25Q64_PageProgram(uint32_t addr, const uint8_t *buf, size_t len); /* 0x02, up to 256B per chunk */
-void W25Q64_SectorErase4K(uint32_t addr);                         /* 0x20 */
+/* -1: bus error, or a background erase that did not suspend or finish in time */
+int  W25Q64_Read(uint32_t addr, uint8_t *buf, size_t len);       /* 0x03/0x0B/0x3B/0x6B */
+int  W25Q64_PageProgram(uint32_t addr, const uint8_t *buf, size_t len);  /* 0x02, up to 256B per chunk; -1 DMA stopped mid-page */
+/* Opcodes from the probed erase types (0x20/0x52/0xD8 on Winbond parts);
+ * -1 if the part has no erase of that size */
+int  W25Q64_SectorErase4K(uint32_t addr);
+int  W25Q64_BlockErase32K(uint32_t addr);
+int  W25Q64_BlockErase64K(uint32_t addr);
+void W25Q64_ChipErase(void);                                      /* 0xC7 */
+/* Erase [addr, addr+len) with the largest probed erase type that is aligned
+ * and fits at each step. Both ends are rounded out to the smallest type. */
+void W25Q64_EraseRange(uint32_t addr, uint32_t len);
+int  W25Q64_ReadJedecID(uint8_t id[3]);                           /* 0x9F */
+int  W25Q64_ReadSFDP(uint32_t addr, uint8_t *buf, size_t len);   /* 0x5A */
 
 #ifdef __cplusplus
 }
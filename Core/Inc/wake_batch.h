@@ -0,0 +1,58 @@
+#pragma once
+#include "main.h"
+#include "lfs.h"
+#include "ring_log.h"
+#include "log_codec.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Records batched in SRAM2 across Standby and written to wake.bin in one
+ * append every WAKE_BATCH_RECORDS wakes (or WAKE_BATCH_FLUSH_BYTES).
+ * SRAM2 is kept across every Standby; a CRC over the block rejects what a
+ * power-on leaves behind. It also keeps the probed flash geometry
+ * (LFS_W25Q64_GeometryStore), so wakes after the first need no probe.
+ * WAKE_BATCH_RECORDS 1 writes every record on its own wake, as before. */
+#ifndef WAKE_BATCH_RECORDS
+#if RINGLOG_ENABLE
+#define WAKE_BATCH_RECORDS       RINGLOG_PAGE_RECORDS   /* one page program per flush */
+#else
+#define WAKE_BATCH_RECORDS       32u
+#endif
+#endif
+#ifndef WAKE_BATCH_FLUSH_BYTES
+#define WAKE_BATCH_FLUSH_BYTES  512u
+#endif
+#ifndef WAKE_BATCH_CAPACITY
+#define WAKE_BATCH_CAPACITY    2048u   /* room for flushes that fail (fs error) */
+#endif
+#ifndef WAKE_BATCH_FILE
+#if LOG_COMPRESS
+#define WAKE_BATCH_FILE   LOG_Z_FILE     /* frames, see log_codec.h */
+#else
+#define WAKE_BATCH_FILE   "wake.bin"
+#endif
+#endif
+
+// Queue one record. Returns 1 when a flush is due, 0 if not, -1 if there
+// was no room (the record is not queued).
+int      WakeBatch_Append(const void *rec, uint32_t len);
+uint32_t WakeBatch_Pending(void);          /* records queued */
+// Append the queued records to WAKE_BATCH_FILE on a mounted volume and
+// empty the batch. Returns 0 or a littlefs error (the batch is kept).
+int      WakeBatch_Flush(lfs_t *lfs);
+// Same on the global volume: mount, flush, unmount; with RINGLOG_ENABLE one
+// append to the ring instead. Flash must be awake.
+int      WakeBatch_Sync(void);
+void     WakeBatch_Discard(void);          /* wake.bin was erased */
+// LFS_W25Q64_GeometryStore in SRAM2 next to the batch
+void     WakeBatch_LoadGeometry(uint32_t *words, uint32_t n);
+void     WakeBatch_SaveGeometry(const uint32_t *words, uint32_t n);
+// Before Standby: SRAM2 retention on
+void     WakeBatch_ArmRetention(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,6 @@
 /* cdc_cmd.c (corrected)
  * - Robust command parsing (as in your file)
- * - Reliable short replies using blocking transmit (poll TxState)
+ * - Replies queued on the USB TX ring (usb_tx.c), sent from the interrupt
  */
 #include "cdc_cmd.h"
 #include <string.h>
@@ -9,33 +9,12 @@
 #include <stdio.h>
 #include "rtc_provision.h"
 #include "rtc.h"
-#include "usbd_cdc_if.h"
-#include "usb_device.h"
 #include "usb_service_sm.h"
+#include "usb_tx.h"
+#include "w25q64.h"
+#include "lfs_w25q64.h"
 #include "main.h"
 
-extern USBD_HandleTypeDef hUsbDeviceFS;
-
-static int CDC_WriteBlocking(const uint8_t *data, uint16_t len, uint32_t timeout_ms)
-{
-    uint32_t t0 = HAL_GetTick();
-    while ((HAL_GetTick() - t0) < timeout_ms) {
-        USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
-        if (hcdc && hcdc->TxState == 0) {
-            USBD_CDC_SetTxBuffer(&hUsbDeviceFS, (uint8_t*)data, len);
-            if (USBD_CDC_TransmitPacket(&hUsbDeviceFS) == USBD_OK) return 0;
-        }
-        HAL_Delay(1);
-    }
-    return -1;
-}
-
-static void USB_Write(const char* s)
-{
-    if (!s) return;
-    (void)CDC_WriteBlocking((const uint8_t*)s, (uint16_t)strlen(s), 250);
-}
-
 static inline void LED_Pulse(uint32_t ms)
 { HAL_GPIO_TogglePin(LED_GPIO_Port, LED_Pin); HAL_Delay(ms); HAL_GPIO_TogglePin(LED_GPIO_Port, LED_Pin); }
 
@@ -47,8 +26,90 @@ static bool parse_epoch_or_iso(const char *arg, uint32_t *out_epoch)
     return false;
 }
 
+// GETLOG OFFSET=<n> [LEN=<m>] [FRAMED], in any order
+static bool parse_window(const char *arg, uint32_t *off, uint32_t *len, bool *framed)
+{
+    bool any = false;
+    *off = *len = 0; *framed = false;
+    while (*arg) {
+        char *end = (char*)arg;
+        if (strncasecmp(arg, "OFFSET=", 7) == 0) *off = (uint32_t)strtoul(arg + 7, &end, 10);
+        else if (strncasecmp(arg, "LEN=", 4) == 0) *len = (uint32_t)strtoul(arg + 4, &end, 10);
+        else if (strncasecmp(arg, "FRAMED", 6) == 0) { end += 6; *framed = true; }
+        if (end == arg || (*end && *end != ' ' && *end != '\t')) return false;
+        any = true;
+        arg = end;
+        while (*arg == ' ' || *arg == '\t') arg++;
+    }
+    return any;
+}
+
 static void on_accept(void) { LED_Pulse(60); }
 
+static int format_hist(char *out, size_t len, const char *name, const uint32_t *h, uint32_t max_ms)
+{
+    static const char *edges[USB_SM_LAT_BUCKETS] = { "<1", "<2", "<5", "<10", "<20", "<50", "<100", "<200", "<500", ">=500" };
+    int n = snprintf(out, len, "lat_%s_ms", name);
+    for (int i = 0; i < USB_SM_LAT_BUCKETS && n > 0 && (size_t)n < len; i++)
+        n += snprintf(out + n, len - n, " %s:%lu", edges[i], (unsigned long)h[i]);
+    if (n > 0 && (size_t)n < len) n += snprintf(out + n, len - n, " max=%lu\r\n", (unsigned long)max_ms);
+    return (n >= (int)len) ? (int)len - 1 : n;
+}
+
+// Command latency histograms (idle vs background erase) and flash counters
+static void CMD_Stats(void)
+{
+    // each line is copied into the TX ring: one buffer does
+    static char out[200];
+    usb_sm_latency_t lat; USB_SM_GetLatency(&lat);
+    W25Q64_SuspendStats ss; W25Q64_GetSuspendStats(&ss);
+    LFS_W25Q64_EraseStats es; LFS_W25Q64_GetEraseStats(&es);
+    int n = format_hist(out, sizeof out, "idle", lat.idle, lat.max_idle_ms);
+    if (n > 0) (void)USB_Tx_Write(out, (uint32_t)n);
+    n = format_hist(out, sizeof out, "erase", lat.busy, lat.max_busy_ms);
+    if (n > 0) (void)USB_Tx_Write(out, (uint32_t)n);
+    n = snprintf(out, sizeof out, "flash suspends=%lu deferred=%lu max_suspend_us=%lu erases=%lu skipped=%lu\r\n",
+                 (unsigned long)ss.suspends, (unsigned long)ss.deferred, (unsigned long)ss.max_suspend_us,
+                 (unsigned long)es.erases, (unsigned long)es.skipped);
+    if (n > 0) (void)USB_Tx_Write(out, (uint32_t)n);
+    uint32_t last_us, wakes; uint64_t total_us;
+    RTC_GetFlashAwake(&last_us, &total_us, &wakes);
+    W25Q64_PowerStats ps; W25Q64_GetPowerStats(&ps);
+    n = snprintf(out, sizeof out, "flash awake last_us=%lu avg_us=%lu total_s=%lu wakes=%lu releases=%lu coalesced=%lu\r\n",
+                 (unsigned long)last_us, (unsigned long)(wakes ? total_us / wakes : 0),
+                 (unsigned long)(total_us / 1000000u), (unsigned long)wakes,
+                 (unsigned long)ps.releases, (unsigned long)ps.coalesced);
+    if (n > 0) (void)USB_Tx_Write(out, (uint32_t)n);
+    LFS_W25Q64_UsageStats us; LFS_W25Q64_GetUsageStats(&us);
+    n = snprintf(out, sizeof out, "fs usage walks=%lu checks=%lu drift_max=%lu\r\n",
+                 (unsigned long)us.walks, (unsigned long)us.checks, (unsigned long)us.drift_max);
+    if (n > 0) (void)USB_Tx_Write(out, (uint32_t)n);
+    // erased: taken off logging wakes; log_*: what logging wakes still did
+    LFS_W25Q64_MaintStats ms; LFS_W25Q64_GetMaintStats(&ms);
+    n = snprintf(out, sizeof out, "fs maint erased=%lu log_erases=%lu log_skipped=%lu wakes_since=%lu job=%u%%\r\n",
+                 (unsigned long)ms.erased, (unsigned long)ms.log_erases, (unsigned long)ms.log_skipped,
+                 (unsigned long)ms.wakes, (unsigned)LFS_W25Q64_PreEraseProgress());
+    if (n > 0) (void)USB_Tx_Write(out, (uint32_t)n);
+    // last GETLOG: idle = frames the host was NAKed throughout; pkts = 64-byte
+    // packets per frame with a transfer armed (19 is the full-speed ceiling)
+    CDC_StreamStats st; CMD_GetStreamStats(&st);
+    uint32_t armed = st.frames - st.idle;
+    uint32_t pkts_x100 = armed ? (uint32_t)((uint64_t)st.bytes * 100u / 64u / armed) : 0u;
+    n = snprintf(out, sizeof out, "usb stream bytes=%lu frames=%lu idle=%lu pkts=%lu.%02lu transfers=%lu chained=%lu\r\n",
+                 (unsigned long)st.bytes, (unsigned long)st.frames, (unsigned long)st.idle,
+                 (unsigned long)(pkts_x100 / 100u), (unsigned long)(pkts_x100 % 100u),
+                 (unsigned long)st.transfers, (unsigned long)st.chained);
+    if (n > 0) (void)USB_Tx_Write(out, (uint32_t)n);
+    // replies: depth and hw (high water) of the TX ring, in bytes; waits =
+    // writes that found it full
+    USB_TxStats ts; USB_Tx_GetStats(&ts);
+    n = snprintf(out, sizeof out, "usb tx queued=%lu sent=%lu transfers=%lu chained=%lu depth=%lu hw=%lu/%lu waits=%lu dropped=%lu\r\n",
+                 (unsigned long)ts.queued, (unsigned long)ts.sent, (unsigned long)ts.transfers,
+                 (unsigned long)ts.chained, (unsigned long)ts.depth, (unsigned long)ts.high_water,
+                 (unsigned long)USB_TX_RING_SIZE, (unsigned long)ts.waits, (unsigned long)ts.dropped);
+    if (n > 0) (void)USB_Tx_Write(out, (uint32_t)n);
+}
+
 void CDC_HandleLine(const char *line)
 {
     if (!line) return;
@@ -77,9 +138,13 @@ void CDC_HandleLine(const char *line)
             " ENDLOG   epoch=<sec> | iso=...\r\n"
             " STOPLOG\r\n"
             " SETINTERVAL <sec>\r\n"
-            " ERASELOG\r\n"
-            " GETLOG [SINCE=<sec>] | GETLOG BETWEEN=<a>,<b>\r\n"
+            " ERASELOG [FAST]\r\n"
+            " RETENTION [STOP|WRAP]\r\n"
+            " GETLOG [SINCE=<sec>] | GETLOG BETWEEN=<a>,<b> | GETLOG INDEX\r\n"
+            " GETLOG OFFSET=<byte> [LEN=<bytes>] [FRAMED]\r\n"
+            " GETLOG COMPRESS [SINCE=<sec> | BETWEEN=<a>,<b>]\r\n"
             " STATUS\r\n"
+            " STATS\r\n"
             " QUIT\r\n"
         );
         on_accept();
@@ -90,8 +155,9 @@ void CDC_HandleLine(const char *line)
         if (!arg) { USB_Write("ERR missing arg\r\n"); return; }
         if (strncmp(arg, "epoch=", 6) == 0) {
             uint32_t e = (uint32_t)strtoul(arg+6, NULL, 10);
-            RTC_SetFromEpoch(e); RTC_MarkProvisioned(); USB_Write("OK TIME SET\r\n"); on_accept();
+            CMD_LogTimeChanged(); RTC_SetFromEpoch(e); RTC_MarkProvisioned(); USB_Write("OK TIME SET\r\n"); on_accept();
         } else if (strncmp(arg, "iso=", 4) == 0) {
+            CMD_LogTimeChanged();   // a spare boundary if the time is rejected is harmless
             if (RTC_SetFromISO8601(arg+4) == 0) { RTC_MarkProvisioned(); USB_Write("OK TIME SET\r\n"); on_accept(); }
             else USB_Write("ERR bad ISO time\r\n");
         } else USB_Write("ERR arg\r\n");
@@ -122,28 +188,52 @@ void CDC_HandleLine(const char *line)
         RTC_SetLoggingInterval(sec); USB_Write("OK INTERVAL set\r\n"); on_accept(); return;
     }
 
-    if (strcasecmp(cmd, "ERASELOG") == 0) { CMD_EraseLog(); on_accept(); return; }
+    if (strcasecmp(cmd, "ERASELOG") == 0) {
+        if (arg && strcasecmp(arg, "FAST") == 0) CMD_EraseLogFast();
+        else CMD_EraseLog();
+        on_accept();
+        return;
+    }
 
     if (strcasecmp(cmd, "GETLOG") == 0) {
-        if (!arg || !*arg) { CMD_GetLog_All(); on_accept(); return; }
-        if (strncasecmp(arg, "SINCE=", 6) == 0) { uint32_t s = (uint32_t)strtoul(arg+6, NULL, 10); CMD_GetLog_Since(s); on_accept(); return; }
+        // COMPRESS in front of a plain or filtered GETLOG: log_codec frames
+        bool z = false;
+        if (arg && strncasecmp(arg, "COMPRESS", 8) == 0 && (arg[8] == '\0' || arg[8] == ' ' || arg[8] == '\t')) {
+            z = true;
+            arg += 8;
+            while (*arg == ' ' || *arg == '\t') arg++;
+        }
+        if (!arg || !*arg) { if (z) CMD_GetLog_Compress(0, UINT32_MAX); else CMD_GetLog_All(); on_accept(); return; }
+        if (!z && strcasecmp(arg, "INDEX") == 0) { CMD_GetLog_Index(); on_accept(); return; }
+        if (strncasecmp(arg, "SINCE=", 6) == 0) {
+            uint32_t s = (uint32_t)strtoul(arg+6, NULL, 10);
+            if (z) CMD_GetLog_Compress(s, UINT32_MAX); else CMD_GetLog_Since(s);
+            on_accept(); return;
+        }
         if (strncasecmp(arg, "BETWEEN=", 8) == 0) {
             uint32_t a=0,b=0; const char *p = arg+8; a = (uint32_t)strtoul(p, (char**)&p, 10);
             if (*p == ',' || *p == ';') { p++; b = (uint32_t)strtoul(p, NULL, 10); }
-            if (a && b && a <= b) { CMD_GetLog_Between(a,b); on_accept(); }
+            if (a && b && a <= b) { if (z) CMD_GetLog_Compress(a, b); else CMD_GetLog_Between(a,b); on_accept(); }
             else USB_Write("ERR bad range\r\n");
             return;
         }
+        uint32_t off, len; bool framed;
+        if (!z && parse_window(arg, &off, &len, &framed)) { CMD_GetLog_Window(off, len, framed); on_accept(); return; }
+        if (z) { USB_Write("ERR GETLOG COMPRESS [SINCE=|BETWEEN=]\r\n"); return; }
         CMD_GetLog_All(); on_accept(); return;
     }
 
+    if (strcasecmp(cmd, "RETENTION") == 0) { CMD_Retention(arg); on_accept(); return; }
+
     if (strcasecmp(cmd, "STATUS") == 0) {
         char out[200]; int n = CDC_BuildTimeStatus(out, sizeof out);
-        if (n > 0) (void)CDC_WriteBlocking((const uint8_t*)out, (uint16_t)n, 250);
+        if (n > 0) (void)USB_Tx_Write(out, (uint32_t)n);
         on_accept();
         return;
     }
 
+    if (strcasecmp(cmd, "STATS") == 0) { CMD_Stats(); on_accept(); return; }
+
     if (strcasecmp(cmd, "QUIT") == 0) { USB_SM_Stop(); USB_Write("OK bye\r\n"); on_accept(); return; }
 
     USB_Write("ERR unknown (type HELP)\r\n");
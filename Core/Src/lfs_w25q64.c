@@ -1,37 +1,167 @@
 #include "lfs_w25q64.h"
 #include "lfs.h"
+#include "lfs_util.h"
 #include <string.h>
 extern lfs_t lfs;
 extern struct lfs_config lfs_cfg;
 
+/* ---- Read-ahead window ----
+ * One contiguous range of flash mirrored in RAM. Never spans a block
+ * boundary, so an erase or program only ever touches one window. */
+#if LFS_W25Q64_READAHEAD
+static uint8_t ra_buf[LFS_W25Q64_READAHEAD];
+#else
+static uint8_t ra_buf[1];
+#endif
+static uint32_t ra_addr, ra_len, ra_next;
+static uint32_t ra_size = LFS_W25Q64_READAHEAD;
+static LFS_W25Q64_ReadStats read_stats;
+
+static void ra_write(uint32_t addr, const void *data, uint32_t size)
+{
+    if (!ra_len || addr >= ra_addr + ra_len || addr + size <= ra_addr) return;
+    uint32_t lo = addr > ra_addr ? addr : ra_addr;
+    uint32_t hi = (addr + size < ra_addr + ra_len) ? addr + size : ra_addr + ra_len;
+    if (data) memcpy(ra_buf + (lo - ra_addr), (const uint8_t*)data + (lo - addr), hi - lo);
+    else memset(ra_buf + (lo - ra_addr), 0xFF, hi - lo);
+}
+
 /*
- * Block-device hooks bridging littlefs <-> W25Q128
+ * Block-device hooks bridging littlefs <-> W25Qxx
  * Update the function names if your driver exposes different symbols.
  */
 static int bd_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
                    void *buffer, lfs_size_t size)
 {
     uint32_t addr = (uint32_t)block * c->block_size + off;
-    W25Q64_Read(addr, (uint8_t*)buffer, (size_t)size);
+    read_stats.reads++;
+    if (ra_len && addr >= ra_addr && addr + size <= ra_addr + ra_len) {
+        memcpy(buffer, ra_buf + (addr - ra_addr), size);
+        read_stats.hits++;
+        ra_next = addr + size;
+        return 0;
+    }
+    /* Only a read that continues the previous one starts a window: littlefs
+     * hops between blocks while walking metadata and CTZ lists, and reading
+     * ahead of a hop just wastes wire time */
+    int sequential = (addr == ra_next) && off;
+    ra_next = addr + size;
+    if (!sequential || size >= ra_size) {
+        read_stats.bypass++;
+        return W25Q64_Read(addr, (uint8_t*)buffer, (size_t)size) ? LFS_ERR_IO : 0;
+    }
+    uint32_t len = c->block_size - off;
+    if (len > ra_size) len = ra_size;
+    if (W25Q64_Read(addr, ra_buf, len) != 0) { ra_len = 0; return LFS_ERR_IO; }
+    ra_addr = addr; ra_len = len;
+    memcpy(buffer, ra_buf, size);
+    read_stats.misses++;
+    read_stats.fill_bytes += len;
     return 0;
 }
 
+static void pre_claim(lfs_block_t block);
+
 static int bd_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
                    const void *buffer, lfs_size_t size)
 {
     uint32_t addr = (uint32_t)block * c->block_size + off;
+    pre_claim(block);
     /* The driver should split across 256B page boundaries internally */
-    W25Q64_PageProgram(addr, (const uint8_t*)buffer, (size_t)size);
+    if (W25Q64_PageProgram(addr, (const uint8_t*)buffer, (size_t)size) != 0) {
+        ra_len = 0;   /* what landed is unknown: drop the window */
+        return LFS_ERR_IO;
+    }
+    ra_write(addr, buffer, size);   /* littlefs only programs erased bytes */
     return 0;
 }
 
+/* Erase marker values: 0 = idle, block + 1, or a chip erase / background
+ * pass in flight (nothing trusted blank until one completes) */
+#define ERASE_MARK_NONE   0u
+#define ERASE_MARK_ALL    0xFFFFFFFFu
+
+static LFS_W25Q64_EraseMarker erase_mark;
+static LFS_W25Q64_EraseStats erase_stats;
+
+/* Mount snapshot, see LFS_W25Q64_FastMount. Word 0 zero = no snapshot */
+static LFS_W25Q64_SnapshotStore snap_store;
+
+static void snap_discard(void)
+{
+    static const uint32_t none = 0;
+    if (snap_store.save) snap_store.save(&none, 1);
+}
+
+/* Early-out scan: used blocks almost always fail in the first bytes */
+static int block_is_blank(const struct lfs_config *c, uint32_t addr)
+{
+    uint32_t buf[64];
+    uint32_t off = 0, step = 16;
+    while (off < c->block_size) {
+        uint32_t n = (c->block_size - off < step) ? c->block_size - off : step;
+        if (W25Q64_Read(addr + off, (uint8_t*)buf, n) != 0) return 0;   /* erase it to be sure */
+        erase_stats.check_bytes += n;
+        for (uint32_t i = 0; i < n / 4u; i++) if (buf[i] != 0xFFFFFFFFu) return 0;
+        off += n;
+        step = sizeof buf;
+    }
+    return 1;
+}
+
 static int bd_erase(const struct lfs_config *c, lfs_block_t block)
 {
     uint32_t addr = (uint32_t)block * c->block_size;
-    W25Q64_SectorErase4K(addr);
+    uint32_t mark = erase_mark.get ? erase_mark.get() : ERASE_MARK_ALL;
+    pre_claim(block);
+
+    /* A stale marker from another block keeps its slot until that block is
+     * erased again; meanwhile nothing is trusted blank */
+    if (LFS_W25Q64_BLANK_CHECK && mark == ERASE_MARK_NONE && block_is_blank(c, addr)) {
+        erase_stats.skipped++;
+        return 0;
+    }
+    int own = (mark == ERASE_MARK_NONE || mark == block + 1u);
+    if (own && erase_mark.set) erase_mark.set(block + 1u);
+    int rc = W25Q64_SectorErase4K(addr);   /* -1: the part has no 4 KiB erase */
+    if (own && erase_mark.set) erase_mark.set(ERASE_MARK_NONE);
+    if (rc != 0) return LFS_ERR_IO;
+    ra_write(addr, NULL, c->block_size);
+    erase_stats.erases++;
     return 0;
 }
 
+/* ---- Probed geometry kept across Standby ---- */
+static LFS_W25Q64_GeometryStore geom_store;
+
+#define GEOM_MAGIC  0x47454F4Du   /* "GEOM" */
+
+static int geom_load(W25Q64_Geometry *g)
+{
+    uint32_t w[LFS_W25Q64_GEOMETRY_WORDS];
+    if (!geom_store.load) return 0;
+    geom_store.load(w, LFS_W25Q64_GEOMETRY_WORDS);
+    if (w[0] != GEOM_MAGIC) return 0;
+    if (lfs_crc(0xFFFFFFFFu, w, (LFS_W25Q64_GEOMETRY_WORDS - 1u) * sizeof w[0]) != w[LFS_W25Q64_GEOMETRY_WORDS - 1u]) return 0;
+    memcpy(g, &w[1], sizeof *g);
+    return 1;
+}
+
+static void geom_save(const W25Q64_Geometry *g)
+{
+    uint32_t w[LFS_W25Q64_GEOMETRY_WORDS] = { GEOM_MAGIC };
+    if (!geom_store.save) return;
+    memcpy(&w[1], g, sizeof *g);
+    w[LFS_W25Q64_GEOMETRY_WORDS - 1u] = lfs_crc(0xFFFFFFFFu, w, (LFS_W25Q64_GEOMETRY_WORDS - 1u) * sizeof w[0]);
+    geom_store.save(w, LFS_W25Q64_GEOMETRY_WORDS);
+}
+
+void LFS_W25Q64_BindGeometry(const LFS_W25Q64_GeometryStore *store)
+{
+    if (store) geom_store = *store;
+    else memset(&geom_store, 0, sizeof geom_store);
+}
+
 static int bd_sync(const struct lfs_config *c)
 {
     (void)c; /* NOR typically needs no explicit sync */
@@ -48,33 +178,56 @@ void LFS_W25Q64_InitConfig(struct lfs_config *cfg)
     cfg->erase = bd_erase;
     cfg->sync  = bd_sync;
 
+    /* Part geometry: kept from an earlier probe without touching the bus,
+     * else probed once and kept; a part that does not answer keeps the
+     * W25Q64 defaults and is probed again next time. A part in a known deep
+     * power-down goes back to it; after a reset the state is unknown and
+     * the part stays awake for the mount that follows. */
+    W25Q64_Geometry g;
+    if (geom_load(&g)) {
+        W25Q64_SetGeometry(&g);
+    } else {
+        W25Q64_PowerState ps = W25Q64_GetPowerState();
+        W25Q64_ReleaseFromDeepPowerDown();
+        if (W25Q64_Probe(&g) == 0) geom_save(&g);
+        if (ps == W25Q64_POWER_DPD) W25Q64_EnterDeepPowerDown();
+    }
+
     /* Geometry */
-    cfg->read_size      = LFS_W25Q128_READ_SIZE;
-    cfg->prog_size      = LFS_W25Q128_PROG_SIZE;
-    cfg->block_size     = LFS_W25Q128_BLOCK_SIZE;
-    cfg->block_count    = LFS_W25Q128_BLOCK_COUNT;
+    cfg->read_size      = LFS_W25Q64_READ_SIZE;
+    cfg->prog_size      = LFS_W25Q64_PROG_SIZE;
+    cfg->block_size     = LFS_W25Q64_BLOCK_SIZE;
+    cfg->block_count    = LFS_W25Q64_BLOCK_COUNT ? LFS_W25Q64_BLOCK_COUNT
+                                                 : g.capacity / LFS_W25Q64_BLOCK_SIZE;
 
-    /* Tunables */
-    cfg->cache_size     = LFS_W25Q128_CACHE_SIZE;
-    cfg->lookahead_size = LFS_W25Q128_LOOKAHEAD;
-    cfg->block_cycles   = LFS_W25Q128_BLOCK_CYCLES;
+    /* Tunables: one lookahead bit per block is enough, no point scanning more */
+    uint32_t la = ((cfg->block_count + 63u) / 64u) * 8u;
+    cfg->cache_size     = LFS_W25Q64_CACHE_SIZE;
+    cfg->lookahead_size = (la < LFS_W25Q64_LOOKAHEAD) ? la : LFS_W25Q64_LOOKAHEAD;
+    cfg->block_cycles   = LFS_W25Q64_BLOCK_CYCLES;
+    cfg->compact_thresh = LFS_W25Q64_COMPACT_THRESH;   /* lfs_fs_gc only */
 
     /* Optional compile-time safety checks (uncomment if desired) */
     /*
-    _Static_assert(LFS_W25Q128_CACHE_SIZE % LFS_W25Q128_READ_SIZE == 0, "cache%read");
-    _Static_assert(LFS_W25Q128_CACHE_SIZE % LFS_W25Q128_PROG_SIZE == 0, "cache%prog");
-    _Static_assert(LFS_W25Q128_BLOCK_SIZE % LFS_W25Q128_CACHE_SIZE == 0, "cache|block");
-    _Static_assert((LFS_W25Q128_LOOKAHEAD % 8) == 0, "lookahead%8");
+    _Static_assert(LFS_W25Q64_CACHE_SIZE % LFS_W25Q64_READ_SIZE == 0, "cache%read");
+    _Static_assert(LFS_W25Q64_CACHE_SIZE % LFS_W25Q64_PROG_SIZE == 0, "cache%prog");
+    _Static_assert(LFS_W25Q64_BLOCK_SIZE % LFS_W25Q64_CACHE_SIZE == 0, "cache|block");
+    _Static_assert((LFS_W25Q64_LOOKAHEAD % 8) == 0, "lookahead%8");
     */
 }
 
 int LFS_W25Q64_Mount(lfs_t *lfs, const struct lfs_config *cfg)
 {
+    ra_len = 0;   /* the flash may have been written since the last mount */
+    snap_discard();   /* and will be written behind the snapshot's back */
     return lfs_mount(lfs, cfg);
 }
 
 int LFS_W25Q64_FormatAndMount(lfs_t *lfs, const struct lfs_config *cfg)
 {
+    ra_len = 0;
+    snap_discard();
+    LFS_W25Q64_UsageInvalidate();
     int rc = lfs_format(lfs, cfg);
     if (rc) return rc;
     return lfs_mount(lfs, cfg);
@@ -85,9 +238,436 @@ void LFS_W25Q64_Unmount(lfs_t *lfs)
     (void)lfs_unmount(lfs);
 }
 
+int LFS_W25Q64_EraseAndFormat(lfs_t *lfs, const struct lfs_config *cfg)
+{
+    /* An interrupted chip erase leaves the marker set, which disables blank
+     * skipping until a chip erase completes */
+    if (erase_mark.set) erase_mark.set(ERASE_MARK_ALL);
+    snap_discard();
+    LFS_W25Q64_UsageInvalidate();
+    W25Q64_ChipErase();
+    ra_len = 0;
+    if (erase_mark.set) erase_mark.set(ERASE_MARK_NONE);
+    return lfs_format(lfs, cfg);
+}
+
+void LFS_W25Q64_BindEraseMarker(const LFS_W25Q64_EraseMarker *marker)
+{
+    if (marker) erase_mark = *marker;
+    else memset(&erase_mark, 0, sizeof erase_mark);
+}
+
+/* ---- Mount snapshot ----
+ * What lfs_mount learns by walking the metadata chain: root pair, allocator
+ * seed, on-disk gstate and the superblock limits. The revision words of the
+ * root pair are read back before trusting it, so a pair that was compacted
+ * or relocated since the snapshot forces the full mount.
+ * Rebuilding lfs_t by hand mirrors lfs_init and the tail of lfs_mount_ in
+ * littlefs v2.9; re-check both before allowing another version here. */
+#define SNAP_ENABLED  (LFS_W25Q64_FAST_MOUNT && LFS_VERSION == 0x00020009)
+#define SNAP_MAGIC    (0x534E0000u ^ LFS_VERSION)
+
+enum {
+    SNAP_TAG = 0, SNAP_ROOT0, SNAP_ROOT1, SNAP_REV0, SNAP_REV1, SNAP_SEED,
+    SNAP_GTAG, SNAP_GPAIR0, SNAP_GPAIR1, SNAP_BLOCKS,
+    SNAP_NAME_MAX, SNAP_FILE_MAX, SNAP_ATTR_MAX, SNAP_INLINE_MAX, SNAP_CRC
+};
+_Static_assert(SNAP_CRC + 1 == LFS_W25Q64_SNAPSHOT_WORDS, "snapshot layout");
+
+static uint32_t snap_rev(const struct lfs_config *c, lfs_block_t block)
+{
+    uint32_t rev;
+    if (W25Q64_Read((uint32_t)block * c->block_size, (uint8_t*)&rev, sizeof rev) != 0) return 0xFFFFFFFFu;
+    return rev;
+}
+
+static int snap_restore(lfs_t *lfs, const struct lfs_config *cfg)
+{
+    uint32_t w[LFS_W25Q64_SNAPSHOT_WORDS];
+    if (!SNAP_ENABLED || !snap_store.load) return 0;
+    snap_store.load(w, LFS_W25Q64_SNAPSHOT_WORDS);
+    if (w[SNAP_TAG] != SNAP_MAGIC) return 0;
+    snap_discard();   /* single use */
+    if (lfs_crc(0xFFFFFFFFu, w, SNAP_CRC * sizeof w[0]) != w[SNAP_CRC]) return 0;
+    if (!cfg->read_buffer || !cfg->prog_buffer || !cfg->lookahead_buffer) return 0;
+    if (!w[SNAP_BLOCKS] || (cfg->block_count && w[SNAP_BLOCKS] != cfg->block_count)) return 0;
+    if (w[SNAP_ROOT0] >= w[SNAP_BLOCKS] || w[SNAP_ROOT1] >= w[SNAP_BLOCKS]) return 0;
+    if (snap_rev(cfg, w[SNAP_ROOT0]) != w[SNAP_REV0] || snap_rev(cfg, w[SNAP_ROOT1]) != w[SNAP_REV1]) return 0;
+
+    /* lfs_init with caller-supplied buffers */
+    memset(lfs, 0, sizeof *lfs);
+    lfs->cfg = cfg;
+    lfs->rcache.buffer = cfg->read_buffer;
+    lfs->pcache.buffer = cfg->prog_buffer;
+    memset(lfs->rcache.buffer, 0xFF, cfg->cache_size);
+    memset(lfs->pcache.buffer, 0xFF, cfg->cache_size);
+    lfs->rcache.block = (lfs_block_t)-1;
+    lfs->pcache.block = (lfs_block_t)-1;
+    lfs->lookahead.buffer = cfg->lookahead_buffer;
+
+    /* what the walk would have found */
+    lfs->root[0] = w[SNAP_ROOT0];
+    lfs->root[1] = w[SNAP_ROOT1];
+    lfs->seed = w[SNAP_SEED];
+    lfs->gstate.tag = w[SNAP_GTAG];
+    lfs->gstate.pair[0] = w[SNAP_GPAIR0];
+    lfs->gstate.pair[1] = w[SNAP_GPAIR1];
+    lfs->gdisk = lfs->gstate;
+    lfs->block_count = w[SNAP_BLOCKS];
+    lfs->name_max = w[SNAP_NAME_MAX];
+    lfs->file_max = w[SNAP_FILE_MAX];
+    lfs->attr_max = w[SNAP_ATTR_MAX];
+    lfs->inline_max = w[SNAP_INLINE_MAX];
+
+    /* allocator start and lfs_alloc_drop, as at the end of lfs_mount_ */
+    lfs->lookahead.start = lfs->seed % lfs->block_count;
+    lfs->lookahead.ckpoint = lfs->block_count;
+    return 1;
+}
+
+int LFS_W25Q64_FastMount(lfs_t *lfs, const struct lfs_config *cfg, uint8_t *fast)
+{
+    ra_len = 0;
+    int ok = snap_restore(lfs, cfg);
+    if (fast) *fast = (uint8_t)ok;
+    return ok ? 0 : lfs_mount(lfs, cfg);
+}
+
+void LFS_W25Q64_FastUnmount(lfs_t *lfs)
+{
+    /* open files or a gstate change not yet on disk: next mount walks */
+    if (SNAP_ENABLED && snap_store.save && !lfs->mlist
+            && !memcmp(&lfs->gstate, &lfs->gdisk, sizeof lfs->gstate)) {
+        uint32_t w[LFS_W25Q64_SNAPSHOT_WORDS];
+        w[SNAP_TAG] = SNAP_MAGIC;
+        w[SNAP_ROOT0] = lfs->root[0];
+        w[SNAP_ROOT1] = lfs->root[1];
+        w[SNAP_REV0] = snap_rev(lfs->cfg, lfs->root[0]);
+        w[SNAP_REV1] = snap_rev(lfs->cfg, lfs->root[1]);
+        w[SNAP_SEED] = lfs->seed;
+        w[SNAP_GTAG] = lfs->gdisk.tag;
+        w[SNAP_GPAIR0] = lfs->gdisk.pair[0];
+        w[SNAP_GPAIR1] = lfs->gdisk.pair[1];
+        w[SNAP_BLOCKS] = lfs->block_count;
+        w[SNAP_NAME_MAX] = lfs->name_max;
+        w[SNAP_FILE_MAX] = lfs->file_max;
+        w[SNAP_ATTR_MAX] = lfs->attr_max;
+        w[SNAP_INLINE_MAX] = lfs->inline_max;
+        w[SNAP_CRC] = lfs_crc(0xFFFFFFFFu, w, SNAP_CRC * sizeof w[0]);
+        snap_store.save(w, LFS_W25Q64_SNAPSHOT_WORDS);
+    }
+    (void)lfs_unmount(lfs);
+}
+
+void LFS_W25Q64_BindSnapshot(const LFS_W25Q64_SnapshotStore *store)
+{
+    if (store) snap_store = *store;
+    else memset(&snap_store, 0, sizeof snap_store);
+}
+
+/* ---- Background erase of free blocks ----
+ * Free blocks are found once with lfs_fs_traverse; then each step issues at
+ * most one erase (64K/32K where a whole aligned run is free) and returns. */
+#define BLOCKS_PER_64K   (0x10000u / LFS_W25Q64_BLOCK_SIZE)
+#define BLOCKS_PER_32K   (0x8000u / LFS_W25Q64_BLOCK_SIZE)
+
+static struct {
+    uint8_t  used[LFS_W25Q64_MAX_BLOCKS / 8u];
+    uint32_t next, count, done;
+    uint32_t first, left, ahead;   /* maintenance: start block, free blocks to go */
+    uint32_t prev_mark;
+    uint8_t  active, trust_blank, maint;
+} pre;
+
+/* Maintenance counters, see LFS_W25Q64_MaintStats */
+#define MAINT_TAG        0x4D000000u
+#define MAINT_SAT(v)     ((v) < 0xFFFFu ? (v) : 0xFFFFu)
+
+static LFS_W25Q64_MaintStore maint_store;
+static LFS_W25Q64_MaintStats maint_stats;
+static uint8_t maint_loaded;
+static LFS_W25Q64_EraseStats maint_noted;   /* erase_stats already accounted */
+
+static void maint_load(void)
+{
+    uint32_t w[LFS_W25Q64_MAINT_WORDS] = { 0 };
+    if (maint_loaded) return;
+    maint_loaded = 1;
+    if (maint_store.load) maint_store.load(w, LFS_W25Q64_MAINT_WORDS);
+    if ((w[0] & 0xFF000000u) != MAINT_TAG) return;
+    maint_stats.wakes = (w[0] >> 16) & 0xFFu;
+    maint_stats.erased = w[0] & 0xFFFFu;
+    maint_stats.log_erases = w[1] >> 16;
+    maint_stats.log_skipped = w[1] & 0xFFFFu;
+}
+
+static void maint_save(void)
+{
+    uint32_t w[LFS_W25Q64_MAINT_WORDS];
+    if (!maint_store.save) return;
+    w[0] = MAINT_TAG | (maint_stats.wakes & 0xFFu) << 16 | MAINT_SAT(maint_stats.erased);
+    w[1] = MAINT_SAT(maint_stats.log_erases) << 16 | MAINT_SAT(maint_stats.log_skipped);
+    maint_store.save(w, LFS_W25Q64_MAINT_WORDS);
+}
+
+static int pre_mark_used(void *ctx, lfs_block_t block)
+{
+    (void)ctx;
+    if (block < pre.count) pre.used[block / 8u] |= (uint8_t)(1u << (block % 8u));
+    return 0;
+}
+
+/* littlefs allocated 'block' while a pass runs (a command between two
+ * steps wrote through the volume): the pass must not erase it, on its own
+ * or inside a 64K/32K run. The traversal only saw the blocks in use at the
+ * start. */
+static void pre_claim(lfs_block_t block)
+{
+    if (pre.active) (void)pre_mark_used(NULL, block);
+}
+
+static int pre_is_used(uint32_t block) { return (pre.used[block / 8u] >> (block % 8u)) & 1u; }
+
+static int pre_run_free(uint32_t block, uint32_t n)
+{
+    if (block + n > pre.count) return 0;
+    for (uint32_t i = 0; i < n; i++) if (pre_is_used(block + i)) return 0;
+    return 1;
+}
+
+static void pre_finish(void)
+{
+    W25Q64_EraseWait();
+    pre.active = 0;
+    if (pre.maint) maint_noted = erase_stats;   /* not a logging wake's */
+    /* every erase issued has completed, so the marker can go back */
+    if (erase_mark.set) erase_mark.set(pre.next >= pre.count ? ERASE_MARK_NONE : pre.prev_mark);
+}
+
+int LFS_W25Q64_PreEraseStart(lfs_t *lfs)
+{
+    if (pre.active) pre_finish();
+    if (lfs_cfg.block_count > LFS_W25Q64_MAX_BLOCKS) return LFS_ERR_INVAL;
+    memset(pre.used, 0, sizeof pre.used);
+    pre.count = lfs_cfg.block_count;
+    pre.next = 0; pre.done = 0;
+    pre.first = 0; pre.left = pre.ahead = pre.count; pre.maint = 0;
+    int rc = lfs_fs_traverse(lfs, pre_mark_used, NULL);
+    if (rc) return rc;
+    pre.prev_mark = erase_mark.get ? erase_mark.get() : ERASE_MARK_ALL;
+    /* after an interrupted erase, blank-looking blocks may be weakly erased */
+    pre.trust_blank = (pre.prev_mark == ERASE_MARK_NONE);
+    if (erase_mark.set) erase_mark.set(ERASE_MARK_ALL);
+    pre.active = 1;
+    return 0;
+}
+
+int LFS_W25Q64_PreEraseStep(void)
+{
+    if (!pre.active) return 0;
+    if (!W25Q64_EraseDone()) return 1;
+    while (pre.next < pre.count && pre.left) {
+        uint32_t b = (pre.first + pre.next) % pre.count, addr = b * LFS_W25Q64_BLOCK_SIZE;
+        if (pre_is_used(b)) { pre.next++; continue; }
+        /* maintenance erases only what is dirty: no 64K/32K over blank blocks */
+        if (!pre.maint && !(b % BLOCKS_PER_64K) && pre_run_free(b, BLOCKS_PER_64K) &&
+            W25Q64_EraseStart(W25Q64_OP_ERASE_64K, addr) == 0) {
+            ra_write(addr, NULL, 0x10000u);
+            pre.next += BLOCKS_PER_64K; pre.done += BLOCKS_PER_64K;
+            erase_stats.erases++;
+            return 1;
+        }
+        if (!pre.maint && !(b % BLOCKS_PER_32K) && pre_run_free(b, BLOCKS_PER_32K) &&
+            W25Q64_EraseStart(W25Q64_OP_ERASE_32K, addr) == 0) {
+            ra_write(addr, NULL, 0x8000u);
+            pre.next += BLOCKS_PER_32K; pre.done += BLOCKS_PER_32K;
+            erase_stats.erases++;
+            return 1;
+        }
+        pre.next++; pre.done++; pre.left--;
+        if (pre.trust_blank && block_is_blank(&lfs_cfg, addr)) { erase_stats.skipped++; return 1; }
+        if (W25Q64_EraseStart(W25Q64_OP_ERASE_4K, addr) != 0) continue;   /* no 4 KiB erase: left as is */
+        ra_write(addr, NULL, LFS_W25Q64_BLOCK_SIZE);
+        erase_stats.erases++;
+        if (pre.maint) maint_stats.erased++;
+        return 1;
+    }
+    pre_finish();
+    return 0;
+}
+
+void LFS_W25Q64_PreEraseCancel(void)
+{
+    if (pre.active) pre_finish();
+}
+
+uint8_t LFS_W25Q64_PreEraseProgress(void)
+{
+    if (!pre.active || !pre.count) return 100;
+    if (pre.ahead < pre.count) return (uint8_t)(((pre.ahead - pre.left) * 100u) / pre.ahead);
+    return (uint8_t)((pre.next * 100u) / pre.count);
+}
+
+int LFS_W25Q64_MaintainStart(lfs_t *lfs, uint32_t ahead)
+{
+    uint32_t e0 = erase_stats.erases;
+    maint_load();
+    if (pre.active) pre_finish();
+    int rc = lfs_fs_gc(lfs);
+    maint_stats.erased += erase_stats.erases - e0;   /* compactions */
+    maint_noted = erase_stats;
+    if (!rc) rc = LFS_W25Q64_PreEraseStart(lfs);
+    if (rc) { maint_save(); return rc; }
+    /* the traversal has fetched every mdir: lfs->seed is now what
+     * FastUnmount saves and the next FastMount starts allocating from */
+    pre.first = lfs->seed % pre.count;
+    pre.left = pre.ahead = (ahead && ahead < pre.count) ? ahead : pre.count;
+    pre.maint = 1;
+    maint_stats.wakes = 0;
+    maint_save();
+    return 0;
+}
+
+int LFS_W25Q64_Maintain(lfs_t *lfs, uint32_t budget_us)
+{
+    uint32_t t0 = W25Q64_NowUs();
+    maint_load();
+    uint32_t e0 = maint_stats.erased;
+    int rc = LFS_W25Q64_MaintainStart(lfs, LFS_W25Q64_MAINT_AHEAD);
+    if (rc) return rc;
+    /* nothing to yield to: sleep through each erase; the one started last
+     * may run past the budget by its own duration */
+    while ((W25Q64_NowUs() - t0) < budget_us && LFS_W25Q64_PreEraseStep()) W25Q64_EraseWait();
+    LFS_W25Q64_PreEraseCancel();
+    maint_save();
+    return (int)(maint_stats.erased - e0);
+}
+
+uint32_t LFS_W25Q64_MaintNoteWake(void)
+{
+    maint_load();
+    maint_stats.log_erases += erase_stats.erases - maint_noted.erases;
+    maint_stats.log_skipped += erase_stats.skipped - maint_noted.skipped;
+    maint_noted = erase_stats;
+    if (maint_stats.wakes < 0xFFu) maint_stats.wakes++;
+    maint_save();
+    return maint_stats.wakes;
+}
+
+void LFS_W25Q64_GetMaintStats(LFS_W25Q64_MaintStats *out)
+{
+    maint_load();
+    if (out) *out = maint_stats;
+}
+
+void LFS_W25Q64_BindMaint(const LFS_W25Q64_MaintStore *store)
+{
+    if (store) maint_store = *store;
+    else memset(&maint_store, 0, sizeof maint_store);
+    maint_loaded = 0;
+    memset(&maint_stats, 0, sizeof maint_stats);
+}
+
+void LFS_W25Q64_GetEraseStats(LFS_W25Q64_EraseStats *out)
+{
+    if (out) *out = erase_stats;
+}
+
+void LFS_W25Q64_SetReadAhead(uint32_t bytes)
+{
+    ra_size = (bytes < LFS_W25Q64_READAHEAD) ? bytes : LFS_W25Q64_READAHEAD;
+    ra_len = 0;
+}
+
+void LFS_W25Q64_ReadAheadInvalidate(void)
+{
+    ra_len = 0;
+}
+
+void LFS_W25Q64_GetReadStats(LFS_W25Q64_ReadStats *out)
+{
+    if (out) *out = read_stats;
+}
+
+void LFS_W25Q64_ResetReadStats(void)
+{
+    memset(&read_stats, 0, sizeof read_stats);
+}
+
+/* ---- Used-block accounting ----
+ * Kept word: USAGE_TAG | accounted writes since the last walk << 16 | blocks.
+ * Without a store bound the word lives in RAM for this power cycle. */
+#define USAGE_TAG     0xA5000000u
+#define USAGE_AGE(w)  (((w) >> 16) & 0xFFu)
+#define USAGE_USED(w) ((w) & 0xFFFFu)
+
+static LFS_W25Q64_UsageStore usage_store;
+static LFS_W25Q64_UsageStats usage_stats;
+static uint32_t usage_ram;
+
+static uint32_t usage_get(void) { return usage_store.get ? usage_store.get() : usage_ram; }
+static void usage_set(uint32_t w) { if (usage_store.set) usage_store.set(w); else usage_ram = w; }
+
+/* Blocks a CTZ file of 'size' bytes occupies, as lfs_ctz_index counts them;
+ * files up to inline_max live in their metadata pair */
+static uint32_t ctz_blocks(const lfs_t *lfs, lfs_soff_t size)
+{
+    if (size <= 0 || (lfs_size_t)size <= lfs->inline_max) return 0;
+    uint32_t off = (uint32_t)size - 1u;
+    uint32_t b = lfs->cfg->block_size - 2u * 4u;
+    uint32_t i = off / b;
+    if (i == 0) return 1;
+    i = (off - 4u * (lfs_popc(i - 1u) + 2u)) / b;
+    return i + 1u;
+}
+
+void LFS_W25Q64_BindUsage(const LFS_W25Q64_UsageStore *store)
+{
+    if (store) usage_store = *store;
+    else memset(&usage_store, 0, sizeof usage_store);
+}
+
+void LFS_W25Q64_UsageFileGrew(const lfs_t *lfs, lfs_soff_t old_size, lfs_soff_t new_size)
+{
+    uint32_t w = usage_get();
+    if ((w & 0xFF000000u) != USAGE_TAG) return;
+    uint32_t used = USAGE_USED(w) + ctz_blocks(lfs, new_size) - ctz_blocks(lfs, old_size);
+    uint32_t age = USAGE_AGE(w) + 1u;
+    if (used > 0xFFFFu || age > 0xFFu) { usage_set(0); return; }
+    usage_set(USAGE_TAG | age << 16 | used);
+}
+
+void LFS_W25Q64_UsageInvalidate(void)
+{
+    usage_set(0);
+}
+
+lfs_ssize_t LFS_W25Q64_UsedBlocks(lfs_t *lfs)
+{
+    uint32_t w = usage_get();
+    int kept = (w & 0xFF000000u) == USAGE_TAG;
+    if (kept && USAGE_AGE(w) < LFS_W25Q64_USAGE_RECOUNT) return (lfs_ssize_t)USAGE_USED(w);
+
+    lfs_ssize_t used = lfs_fs_size(lfs);
+    usage_stats.walks++;
+    if (used < 0) return used;
+    if (kept) {
+        uint32_t d = ((uint32_t)used > USAGE_USED(w)) ? (uint32_t)used - USAGE_USED(w) : USAGE_USED(w) - (uint32_t)used;
+        usage_stats.checks++;
+        if (d > usage_stats.drift_max) usage_stats.drift_max = d;
+    }
+    usage_set((uint32_t)used <= 0xFFFFu ? USAGE_TAG | (uint32_t)used : 0u);
+    return used;
+}
+
+void LFS_W25Q64_GetUsageStats(LFS_W25Q64_UsageStats *out)
+{
+    if (out) *out = usage_stats;
+}
+
 uint8_t FS_IsNearFull(uint32_t reserve_blocks)
 {
-    lfs_ssize_t used = lfs_fs_size(&lfs);
+    lfs_ssize_t used = LFS_W25Q64_UsedBlocks(&lfs);
     uint32_t total = lfs_cfg.block_count;
     if (used < 0 || total == 0) return 0; // conservative: not full
     return ((uint32_t)used >= (total - reserve_blocks)) ? 1 : 0;
@@ -0,0 +1,130 @@
+// log_codec.c - keyframe + zigzag varint record frames (see log_codec.h)
+#include "log_codec.h"
+#include <string.h>
+
+static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t unzigzag(uint32_t u) { return (int32_t)(u >> 1) ^ -(int32_t)(u & 1u); }
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80u) { *p++ = (uint8_t)(v | 0x80u); v >>= 7; }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+/* Returns the byte after the varint, NULL if it runs past 'end' */
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v)
+{
+    uint32_t x = 0;
+    for (uint32_t shift = 0; p < end && shift < 35u; shift += 7u) {
+        uint8_t b = *p++;
+        x |= (uint32_t)(b & 0x7Fu) << shift;
+        if (!(b & 0x80u)) { *v = x; return p; }
+    }
+    return NULL;
+}
+
+static uint16_t crc16(const uint8_t *p, uint32_t len)
+{
+    uint16_t crc = 0xFFFFu;
+    while (len--) {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (int i = 0; i < 8; i++) crc = (crc & 0x8000u) ? (uint16_t)(crc << 1 ^ 0x1021u) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+uint32_t LogCodec_EncodeFrame(const LogCodec_Rec *recs, uint32_t n, uint8_t *out)
+{
+    if (n == 0 || n > LOG_CODEC_KEY_EVERY) return 0;
+    uint8_t *p = out + LOG_CODEC_HDR;
+    memcpy(p, &recs[0], LOG_CODEC_KEY_SIZE);
+    p += LOG_CODEC_KEY_SIZE;
+    int32_t step = 0;
+    for (uint32_t i = 1; i < n; i++) {
+        int32_t d = (int32_t)(recs[i].epoch - recs[i - 1].epoch);
+        uint32_t jitter = (d != step);
+        p = put_varint(p, zigzag((int32_t)recs[i].t_x100 - recs[i - 1].t_x100) << 1 | jitter);
+        if (jitter) p = put_varint(p, zigzag(d - step));
+        p = put_varint(p, zigzag((int32_t)recs[i].rh_x100 - recs[i - 1].rh_x100));
+        step = d;
+    }
+    uint32_t len = (uint32_t)(p - out) - LOG_CODEC_HDR;
+    out[0] = LOG_CODEC_SYNC;
+    out[1] = (uint8_t)n;
+    out[2] = (uint8_t)len;
+    out[3] = (uint8_t)(len >> 8);
+    uint16_t crc = crc16(out + LOG_CODEC_HDR, len);
+    out[4] = (uint8_t)crc;
+    out[5] = (uint8_t)(crc >> 8);
+    return LOG_CODEC_HDR + len;
+}
+
+void LogCodec_DecoderInit(LogCodec_Decoder *d)
+{
+    d->have = d->need = 0;
+    d->frames = d->records = d->errors = 0;
+}
+
+/* Whole frame in d->buf; records go out only if all of them decode */
+static void decode_frame(LogCodec_Decoder *d, LogCodec_Sink sink, void *ctx)
+{
+    static LogCodec_Rec recs[LOG_CODEC_KEY_EVERY];
+    uint32_t n = d->buf[1];
+    const uint8_t *p = d->buf + LOG_CODEC_HDR + LOG_CODEC_KEY_SIZE, *end = d->buf + d->need;
+    if (crc16(d->buf + LOG_CODEC_HDR, d->need - LOG_CODEC_HDR) != (d->buf[4] | (uint16_t)d->buf[5] << 8)) {
+        d->errors++;
+        return;
+    }
+    memcpy(&recs[0], d->buf + LOG_CODEC_HDR, LOG_CODEC_KEY_SIZE);
+    int32_t step = 0;
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t dt, de = 0, dh;
+        if (!(p = get_varint(p, end, &dt)) || ((dt & 1u) && !(p = get_varint(p, end, &de)))
+                || !(p = get_varint(p, end, &dh))) { d->errors++; return; }
+        dt >>= 1;
+        step += unzigzag(de);
+        recs[i].epoch = recs[i - 1].epoch + (uint32_t)step;
+        recs[i].t_x100 = (int16_t)(recs[i - 1].t_x100 + unzigzag(dt));
+        recs[i].rh_x100 = (uint16_t)(recs[i - 1].rh_x100 + unzigzag(dh));
+    }
+    if (p != end) { d->errors++; return; }
+    d->frames++;
+    d->records += n;
+    for (uint32_t i = 0; i < n; i++) sink(&recs[i], ctx);
+}
+
+void LogCodec_Decode(LogCodec_Decoder *d, const uint8_t *in, uint32_t len,
+                     LogCodec_Sink sink, void *ctx)
+{
+    while (len) {
+        if (d->have == 0 && *in != LOG_CODEC_SYNC) {
+            // lost sync (damaged frame, foreign bytes): skip to the next sync byte
+            d->errors++;
+            while (len && *in != LOG_CODEC_SYNC) { in++; len--; }
+            continue;
+        }
+        uint32_t want = (d->have < LOG_CODEC_HDR) ? LOG_CODEC_HDR : d->need;
+        uint32_t take = (want - d->have < len) ? want - d->have : len;
+        memcpy(d->buf + d->have, in, take);
+        d->have += take; in += take; len -= take;
+        if (d->have < want) break;
+        if (want == LOG_CODEC_HDR) {
+            uint32_t n = d->buf[1], plen = d->buf[2] | (uint32_t)d->buf[3] << 8;
+            if (n == 0 || n > LOG_CODEC_KEY_EVERY || plen < LOG_CODEC_KEY_SIZE
+                    || LOG_CODEC_HDR + plen > sizeof d->buf) {
+                // not a frame after all: rescan from the byte after this sync
+                uint8_t rest[LOG_CODEC_HDR - 1u];
+                memcpy(rest, d->buf + 1, sizeof rest);
+                d->errors++;
+                d->have = 0;
+                LogCodec_Decode(d, rest, sizeof rest, sink, ctx);
+                continue;
+            }
+            d->need = LOG_CODEC_HDR + plen;
+            continue;
+        }
+        decode_frame(d, sink, ctx);
+        d->have = 0;
+    }
+}
@@ -0,0 +1,48 @@
+// log_frame.c - fixed-size CRC-32 frames for GETLOG FRAMED (see log_frame.h)
+#include "log_frame.h"
+#include "lfs_util.h"
+#include <string.h>
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* lfs_crc is the reflected 0x04C11DB7 CRC without the pre and post
+ * inversion: with both it is the zlib crc32 a host has at hand */
+uint32_t LogFrame_Crc32(const uint8_t *p, uint32_t len)
+{
+    return lfs_crc(0xFFFFFFFFu, p, len) ^ 0xFFFFFFFFu;
+}
+
+void LogFrame_Seal(uint8_t *frame, uint8_t type, uint32_t seq, uint32_t offset, uint32_t len)
+{
+    frame[0] = LOG_FRAME_SYNC;
+    frame[1] = type;
+    frame[2] = (uint8_t)len;
+    frame[3] = (uint8_t)(len >> 8);
+    put32(frame + 4, seq);
+    put32(frame + 8, offset);
+    memset(frame + LOG_FRAME_HDR + len, 0xFF, LOG_FRAME_PAYLOAD - len);
+    put32(frame + LOG_FRAME_SIZE - LOG_FRAME_CRC, LogFrame_Crc32(frame, LOG_FRAME_SIZE - LOG_FRAME_CRC));
+}
+
+bool LogFrame_Check(const uint8_t *frame, LogFrame_Hdr *hdr)
+{
+    uint16_t len = (uint16_t)(frame[2] | frame[3] << 8);
+    if (frame[0] != LOG_FRAME_SYNC || len > LOG_FRAME_PAYLOAD) return false;
+    if (LogFrame_Crc32(frame, LOG_FRAME_SIZE - LOG_FRAME_CRC) != get32(frame + LOG_FRAME_SIZE - LOG_FRAME_CRC))
+        return false;
+    if (hdr) {
+        hdr->type = frame[1];
+        hdr->len = len;
+        hdr->seq = get32(frame + 4);
+        hdr->offset = get32(frame + 8);
+    }
+    return true;
+}
@@ -0,0 +1,229 @@
+// log_query.c - time-range lookups in wake.bin (see log_query.h)
+#include "log_query.h"
+#include "lfs_w25q64.h"
+#include <string.h>
+
+static uint32_t seg_start[LOG_SEG_MAX + 1u];
+
+/* Segment starts, 0 first; returns the count, 0 if the index overflowed */
+static uint32_t load_segments(lfs_t *lfs)
+{
+    uint32_t n = 1;
+    seg_start[0] = 0;
+    lfs_file_t sf;
+    if (lfs_file_open(lfs, &sf, LOG_SEG_FILE, LFS_O_RDONLY) < 0) return n;
+    lfs_ssize_t r = lfs_file_read(lfs, &sf, &seg_start[1], LOG_SEG_MAX * sizeof seg_start[0]);
+    uint8_t more;
+    if (r > 0) n += (uint32_t)r / sizeof seg_start[0];
+    if (lfs_file_read(lfs, &sf, &more, 1) == 1) n = 0;
+    lfs_file_close(lfs, &sf);
+    return n;
+}
+
+static uint32_t rec_epoch(lfs_t *lfs, lfs_file_t *f, uint32_t idx)
+{
+    uint32_t e = 0;
+    (void)lfs_file_seek(lfs, f, (lfs_soff_t)(idx * LOG_REC_SIZE), LFS_SEEK_SET);
+    (void)lfs_file_read(lfs, f, &e, sizeof e);
+    return e;
+}
+
+/* First record in [lo, hi) with epoch >= t, or epoch > t when 'after' */
+static uint32_t rec_bound(lfs_t *lfs, lfs_file_t *f, uint32_t lo, uint32_t hi,
+                          uint32_t t, bool after, LogQuery_Stats *st)
+{
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        uint32_t e = rec_epoch(lfs, f, mid);
+        st->probes++;
+        if (after ? (e <= t) : (e < t)) lo = mid + 1u;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static bool entry_ok(const LogQuery_IndexEntry *e, uint32_t i, uint32_t total)
+{
+    return e->rec == i * LOG_IDX_RECORDS && e->rec + LOG_IDX_RECORDS <= total && e->min <= e->max;
+}
+
+/* Hand out the runs of indexed blocks that can hold [lo, hi]; returns the
+ * first record the index does not cover */
+static uint32_t index_ranges(lfs_t *lfs, lfs_file_t *xf, lfs_file_t *f, uint32_t total,
+                             uint32_t lo, uint32_t hi, LogQuery_Sink sink, void *ctx, uint32_t *out)
+{
+    static LogQuery_IndexEntry ent[16];
+    uint32_t i = 0, from = 0, to = 0;
+    for (;;) {
+        lfs_ssize_t r = lfs_file_read(lfs, xf, ent, sizeof ent);
+        uint32_t n = (r > 0) ? (uint32_t)r / sizeof ent[0] : 0u, k;
+        for (k = 0; k < n && entry_ok(&ent[k], i, total); k++, i++) {
+            if (ent[k].min > hi || ent[k].max < lo) continue;
+            if (to != ent[k].rec) {
+                if (from < to) { sink(f, from, to, true, ctx); *out += to - from; }
+                from = ent[k].rec;
+            }
+            to = ent[k].rec + LOG_IDX_RECORDS;
+        }
+        if (k < n || n < sizeof ent / sizeof ent[0]) break;
+    }
+    if (from < to) { sink(f, from, to, true, ctx); *out += to - from; }
+    return i * LOG_IDX_RECORDS;
+}
+
+uint32_t LogQuery_Ranges(lfs_t *lfs, lfs_file_t *f, uint32_t lo, uint32_t hi,
+                         LogQuery_Sink sink, void *ctx, LogQuery_Stats *st)
+{
+    LogQuery_Stats local;
+    if (!st) st = &local;
+    memset(st, 0, sizeof *st);
+    lfs_soff_t size = lfs_file_size(lfs, f);
+    uint32_t total = (size > 0) ? (uint32_t)size / LOG_REC_SIZE : 0u;
+    if (!total) return 0;
+
+    if (lo == 0 && hi == UINT32_MAX) {
+        sink(f, 0, total, false, ctx);
+        return total;
+    }
+    uint32_t out = 0, start = 0;
+    lfs_file_t xf;
+    if (lfs_file_open(lfs, &xf, LOG_IDX_FILE, LFS_O_RDONLY) >= 0) {
+        start = index_ranges(lfs, &xf, f, total, lo, hi, sink, ctx, &out);
+        lfs_file_close(lfs, &xf);
+    }
+    st->indexed = start;
+    if (total - start <= LOG_IDX_RECORDS) {
+        // the unindexed tail is at most one block: no search needed
+        if (start < total) { sink(f, start, total, true, ctx); out += total - start; }
+        return out;
+    }
+
+    uint32_t nseg = load_segments(lfs);
+    st->segments = nseg;
+    if (!nseg) {
+        sink(f, start, total, true, ctx);
+        return out + (total - start);
+    }
+    for (uint32_t i = 0; i < nseg; i++) {
+        uint32_t s0 = (seg_start[i] < total) ? seg_start[i] : total;
+        uint32_t s1 = (i + 1u < nseg && seg_start[i + 1u] < total) ? seg_start[i + 1u] : total;
+        if (s0 < start) s0 = start;
+        if (s0 >= s1) continue;
+        uint32_t from = rec_bound(lfs, f, s0, s1, lo, false, st);
+        uint32_t to = rec_bound(lfs, f, from, s1, hi, true, st);
+        if (from < to) {
+            sink(f, from, to, false, ctx);
+            out += to - from;
+        }
+    }
+    return out;
+}
+
+uint32_t LogQuery_Sorted(lfs_t *lfs, lfs_file_t *f, uint32_t lo, uint32_t hi,
+                         LogQuery_Sink sink, void *ctx, LogQuery_Stats *st)
+{
+    LogQuery_Stats local;
+    if (!st) st = &local;
+    memset(st, 0, sizeof *st);
+    lfs_soff_t size = lfs_file_size(lfs, f);
+    uint32_t total = (size > 0) ? (uint32_t)size / LOG_REC_SIZE : 0u;
+    st->segments = 1;
+    uint32_t from = rec_bound(lfs, f, 0, total, lo, false, st);
+    uint32_t to = rec_bound(lfs, f, from, total, hi, true, st);
+    if (from < to) sink(f, from, to, false, ctx);
+    return to - from;
+}
+
+int LogQuery_MarkSegment(lfs_t *lfs)
+{
+    struct lfs_info info;
+    if (lfs_stat(lfs, LOG_FILE, &info) != 0 || info.size < LOG_REC_SIZE) return 0;
+    uint32_t idx = info.size / LOG_REC_SIZE, last = 0;
+    lfs_file_t sf;
+    int rc = lfs_file_open(lfs, &sf, LOG_SEG_FILE, LFS_O_RDWR | LFS_O_CREAT | LFS_O_APPEND);
+    if (rc < 0) return rc;
+    lfs_soff_t sz = lfs_file_size(lfs, &sf);
+    if (sz >= (lfs_soff_t)sizeof last) {
+        (void)lfs_file_seek(lfs, &sf, sz - (lfs_soff_t)sizeof last, LFS_SEEK_SET);
+        (void)lfs_file_read(lfs, &sf, &last, sizeof last);
+    }
+    if (idx != last) {
+        lfs_ssize_t w = lfs_file_write(lfs, &sf, &idx, sizeof idx);
+        if (w < 0) rc = (int)w;
+    }
+    int cr = lfs_file_close(lfs, &sf);
+    if (rc >= 0 && cr >= 0 && idx != last) LFS_W25Q64_UsageFileGrew(lfs, sz, sz + (lfs_soff_t)sizeof idx);
+    return (rc < 0) ? rc : cr;
+}
+
+/* Entries in the open index that match wake.bin; -1 if any does not */
+static int index_check(lfs_t *lfs, lfs_file_t *xf, uint32_t total, bool verify)
+{
+    lfs_soff_t sz = lfs_file_size(lfs, xf);
+    if (sz < 0 || sz % (lfs_soff_t)sizeof(LogQuery_IndexEntry)) return -1;
+    uint32_t n = (uint32_t)sz / sizeof(LogQuery_IndexEntry);
+    if (!n) return 0;
+    static LogQuery_IndexEntry ent[16];
+    uint32_t i = verify ? 0u : n - 1u;
+    (void)lfs_file_seek(lfs, xf, (lfs_soff_t)(i * sizeof ent[0]), LFS_SEEK_SET);
+    while (i < n) {
+        lfs_ssize_t r = lfs_file_read(lfs, xf, ent, sizeof ent);
+        if (r < (lfs_ssize_t)sizeof ent[0]) return -1;
+        for (uint32_t k = 0; k < (uint32_t)r / sizeof ent[0]; k++, i++)
+            if (!entry_ok(&ent[k], i, total)) return -1;
+    }
+    return (int)n;
+}
+
+int LogQuery_IndexUpdate(lfs_t *lfs, bool verify, bool *rebuilt)
+{
+    static uint8_t buf[512];
+    if (rebuilt) *rebuilt = false;
+    lfs_file_t f, xf;
+    int rc = lfs_file_open(lfs, &f, LOG_FILE, LFS_O_RDONLY);
+    if (rc == LFS_ERR_NOENT) {
+        rc = lfs_remove(lfs, LOG_IDX_FILE);
+        return (rc == LFS_ERR_NOENT) ? 0 : rc;
+    }
+    if (rc < 0) return rc;
+    lfs_soff_t size = lfs_file_size(lfs, &f);
+    uint32_t total = (size > 0) ? (uint32_t)size / LOG_REC_SIZE : 0u;
+
+    rc = lfs_file_open(lfs, &xf, LOG_IDX_FILE, LFS_O_RDWR | LFS_O_CREAT);
+    if (rc < 0) { lfs_file_close(lfs, &f); return rc; }
+    int n = index_check(lfs, &xf, total, verify);
+    if (n < 0) {
+        // stale or damaged: start over from the first block
+        rc = lfs_file_truncate(lfs, &xf, 0);
+        n = 0;
+        LFS_W25Q64_UsageInvalidate();   // blocks freed behind the count's back
+        if (rebuilt) *rebuilt = true;
+    }
+    lfs_soff_t grown_from = lfs_file_seek(lfs, &xf, 0, LFS_SEEK_END);
+
+    for (uint32_t b = (uint32_t)n; rc >= 0 && (b + 1u) * LOG_IDX_RECORDS <= total; b++) {
+        LogQuery_IndexEntry e = { b * LOG_IDX_RECORDS, UINT32_MAX, 0 };
+        uint32_t left = LOG_IDX_RECORDS * LOG_REC_SIZE;
+        (void)lfs_file_seek(lfs, &f, (lfs_soff_t)(e.rec * LOG_REC_SIZE), LFS_SEEK_SET);
+        while (left) {
+            lfs_ssize_t r = lfs_file_read(lfs, &f, buf, left < sizeof buf ? left : sizeof buf);
+            if (r <= 0) { rc = (r < 0) ? (int)r : LFS_ERR_CORRUPT; break; }
+            for (uint32_t i = 0; i + LOG_REC_SIZE <= (uint32_t)r; i += LOG_REC_SIZE) {
+                uint32_t t; memcpy(&t, buf + i, sizeof t);
+                if (t < e.min) e.min = t;
+                if (t > e.max) e.max = t;
+            }
+            left -= (uint32_t)r;
+        }
+        if (rc < 0) break;
+        lfs_ssize_t w = lfs_file_write(lfs, &xf, &e, sizeof e);
+        if (w < 0) rc = (int)w;
+        else n++;
+    }
+    lfs_soff_t grown_to = lfs_file_size(lfs, &xf);
+    int cr = lfs_file_close(lfs, &xf);
+    lfs_file_close(lfs, &f);
+    if (cr >= 0 && grown_from >= 0 && grown_to > grown_from) LFS_W25Q64_UsageFileGrew(lfs, grown_from, grown_to);
+    if (rc < 0) return rc;
+    return (cr < 0) ? cr : n;
+}
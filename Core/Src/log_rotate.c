@@ -0,0 +1,451 @@
+// log_rotate.c - log segments, their manifest and retention (see log_rotate.h)
+#include "log_rotate.h"
+#include "log_query.h"
+#include "log_codec.h"
+#include "lfs_w25q64.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* as WAKE_BATCH_FILE; wake_batch.h needs the HAL */
+#define ACTIVE_FILE  (LOG_COMPRESS ? LOG_Z_FILE : LOG_FILE)
+#define MAN_NEW_FILE LOG_MAN_FILE ".new"
+
+static LogRotate_PolicyStore policy_store;
+static uint32_t policy_ram;
+
+/* The policy word: POLICY_TAG, the policy in bit 0 and, while bit 15 is
+ * set, the active segment's LOG_SEGMENT_SECONDS bucket (low 14 bits) in
+ * bits 14..1, so LogRotate_Check need not open the segment for it */
+#define POLICY_TAG   0x52540000u   /* "RT": a blank register reads as STOP */
+#define POLICY_WRAP  0x0001u
+#define BUCKET_BITS  0xFFFEu
+
+static uint32_t policy_word(void)
+{
+    uint32_t w = policy_store.get ? policy_store.get() : policy_ram;
+    return ((w & 0xFFFF0000u) == POLICY_TAG) ? w : POLICY_TAG;
+}
+
+static void policy_put(uint32_t w)
+{
+    if (w == policy_word()) return;
+    if (policy_store.set) policy_store.set(w);
+    else policy_ram = w;
+}
+
+void LogRotate_BindPolicy(const LogRotate_PolicyStore *store)
+{
+    if (store) policy_store = *store;
+    else memset(&policy_store, 0, sizeof policy_store);
+}
+
+void LogRotate_SetPolicy(LogRotate_Policy policy)
+{
+    uint32_t w = policy_word() & ~POLICY_WRAP;
+    policy_put(policy == LOG_RETAIN_WRAP ? (w | POLICY_WRAP) : w);
+}
+
+LogRotate_Policy LogRotate_GetPolicy(void)
+{
+    return (policy_word() & POLICY_WRAP) ? LOG_RETAIN_WRAP : LOG_RETAIN_STOP;
+}
+
+uint32_t LogRotate_SegmentBytes(void)
+{
+    if (LOG_SEGMENT_BYTES) return LOG_SEGMENT_BYTES;
+    return (LogRotate_GetPolicy() == LOG_RETAIN_WRAP) ? LOG_WRAP_SEGMENT_BYTES : 0u;
+}
+
+/* 0 while the active segment's bucket is not known */
+static void bucket_put(uint32_t bucket)
+{
+    policy_put((policy_word() & ~BUCKET_BITS) | bucket);
+}
+
+#if LOG_SEGMENT_SECONDS
+static uint32_t bucket_of(uint32_t epoch)
+{
+    return 0x8000u | (((epoch / LOG_SEGMENT_SECONDS) << 1) & 0x7FFEu);
+}
+#endif
+
+void LogRotate_Name(char *buf, uint32_t name)
+{
+    snprintf(buf, LOG_ARCHIVE_NAME_MAX, LOG_ARCHIVE_DIR "/%lu", (unsigned long)name);
+}
+
+/* ---- manifest ---- */
+
+typedef struct {
+    uint32_t adds, drops;
+    LogRotate_Segment last;             /* newest entry, valid if adds */
+} man_info_t;
+
+typedef struct {
+    uint32_t skip;                      /* entries dropped, oldest first */
+    uint32_t live, seen;                /* entries after them, and walked so far */
+    lfs_t *lfs;                         /* set: pass over a gone end entry */
+    LogRotate_Visit visit;
+    void *ctx;
+    int n;
+} man_visit_t;
+
+/* Every entry of the open manifest, from the start, to fn */
+static int man_walk(lfs_t *lfs, lfs_file_t *mf, void (*fn)(const LogRotate_Segment *, void *), void *ctx)
+{
+    static LogRotate_Segment ent[16];
+    lfs_ssize_t r;
+    (void)lfs_file_rewind(lfs, mf);
+    while ((r = lfs_file_read(lfs, mf, ent, sizeof ent)) > 0)
+        for (uint32_t k = 0; k < (uint32_t)r / sizeof ent[0]; k++) fn(&ent[k], ctx);
+    return (r < 0) ? (int)r : 0;
+}
+
+static void count_entry(const LogRotate_Segment *s, void *ctx)
+{
+    man_info_t *m = (man_info_t *)ctx;
+    if (s->records == LOG_MAN_DROP) m->drops++;
+    else { m->adds++; m->last = *s; }
+}
+
+static bool seg_gone(lfs_t *lfs, const LogRotate_Segment *s)
+{
+    char name[LOG_ARCHIVE_NAME_MAX];
+    struct lfs_info info;
+    LogRotate_Name(name, s->name);
+    return lfs_stat(lfs, name, &info) == LFS_ERR_NOENT;
+}
+
+/* Only an end entry can lack its file: the newest when a reset cut a
+ * rotation short before the rename, the oldest when it cut an eviction
+ * short before the tombstone. Such an entry is not visited or counted, so
+ * it moves no offset; the next rotation or eviction drops it for good. */
+static void visit_entry(const LogRotate_Segment *s, void *ctx)
+{
+    man_visit_t *v = (man_visit_t *)ctx;
+    if (s->records == LOG_MAN_DROP) return;
+    if (v->skip) { v->skip--; return; }
+    uint32_t i = v->seen++;
+    if (v->lfs && (i == 0 || i + 1 == v->live) && seg_gone(v->lfs, s)) return;
+    v->n++;
+    if (v->visit) v->visit(s, v->ctx);
+}
+
+/* Count, then visit the live entries; *m (may be NULL) gets the counts.
+ * checked: leave out an end entry whose file is gone (visit_entry). */
+static int man_read(lfs_t *lfs, LogRotate_Visit visit, void *ctx, man_info_t *m, bool checked)
+{
+    man_info_t local;
+    if (!m) m = &local;
+    memset(m, 0, sizeof *m);
+    lfs_file_t mf;
+    int rc = lfs_file_open(lfs, &mf, LOG_MAN_FILE, LFS_O_RDONLY);
+    if (rc == LFS_ERR_NOENT) return 0;
+    if (rc < 0) return rc;
+    rc = man_walk(lfs, &mf, count_entry, m);
+    man_visit_t v = { m->drops, m->adds - m->drops, 0, checked ? lfs : NULL, visit, ctx, 0 };
+    if (rc == 0 && (visit || m->drops || checked)) rc = man_walk(lfs, &mf, visit_entry, &v);
+    else v.n = (int)m->adds;
+    lfs_file_close(lfs, &mf);
+    return (rc < 0) ? rc : v.n;
+}
+
+static int man_append(lfs_t *lfs, const LogRotate_Segment *s)
+{
+    lfs_file_t mf;
+    int rc = lfs_file_open(lfs, &mf, LOG_MAN_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
+    if (rc < 0) return rc;
+    lfs_soff_t before = lfs_file_size(lfs, &mf);
+    lfs_ssize_t w = lfs_file_write(lfs, &mf, s, sizeof *s);
+    rc = lfs_file_close(lfs, &mf);
+    if (w < 0) return (int)w;
+    if (rc == 0 && before >= 0) LFS_W25Q64_UsageFileGrew(lfs, before, before + w);
+    return rc;
+}
+
+typedef struct {
+    lfs_t *lfs;
+    lfs_file_t *nf;
+} man_copy_t;
+
+static void copy_entry(const LogRotate_Segment *s, void *ctx)
+{
+    man_copy_t *c = (man_copy_t *)ctx;
+    (void)lfs_file_write(c->lfs, c->nf, s, sizeof *s);
+}
+
+/* Rewrite the live entries once enough tombstones have piled up, or
+ * (force) now; gone end entries are left out */
+static int man_compact(lfs_t *lfs, bool force)
+{
+    man_info_t m;
+    int n = man_read(lfs, NULL, NULL, &m, false);
+    if (n < 0 || (!force && m.drops < LOG_MAN_COMPACT)) return (n < 0) ? n : 0;
+    struct lfs_info old;
+    int rc = lfs_stat(lfs, LOG_MAN_FILE, &old);
+    if (rc < 0) return rc;
+    lfs_file_t nf;
+    rc = lfs_file_open(lfs, &nf, MAN_NEW_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    if (rc < 0) return rc;
+    man_copy_t copy = { lfs, &nf };
+    rc = man_read(lfs, copy_entry, &copy, NULL, true);
+    lfs_soff_t size = lfs_file_size(lfs, &nf);
+    int cr = lfs_file_close(lfs, &nf);
+    if (rc >= 0 && cr == 0 && size == (lfs_soff_t)((uint32_t)rc * sizeof(LogRotate_Segment)))
+        rc = lfs_rename(lfs, MAN_NEW_FILE, LOG_MAN_FILE);   // atomic: old list or new
+    else
+        rc = (rc < 0) ? rc : (cr < 0) ? cr : LFS_ERR_CORRUPT;
+    if (rc == 0) LFS_W25Q64_UsageFileGrew(lfs, (lfs_soff_t)old.size, size);
+    else { (void)lfs_remove(lfs, MAN_NEW_FILE); LFS_W25Q64_UsageInvalidate(); }
+    return rc;
+}
+
+/* ---- segments ---- */
+
+int LogRotate_Segments(lfs_t *lfs, LogRotate_Visit visit, void *ctx)
+{
+    return man_read(lfs, visit, ctx, NULL, true);
+}
+
+#if LOG_COMPRESS
+static void scan_record(const LogCodec_Rec *rec, void *ctx)
+{
+    LogRotate_Segment *s = (LogRotate_Segment *)ctx;
+    if (!s->records++) s->name = rec->epoch;
+    else if (rec->epoch < s->max) s->flags &= ~LOG_MAN_SORTED;
+    if (rec->epoch < s->min) s->min = rec->epoch;
+    if (rec->epoch > s->max) s->max = rec->epoch;
+}
+#endif
+
+/* Epoch range of the active segment; returns its records, 0 if none */
+static int active_scan(lfs_t *lfs, LogRotate_Segment *s)
+{
+    static uint8_t buf[512];
+    lfs_file_t f;
+    int rc = lfs_file_open(lfs, &f, ACTIVE_FILE, LFS_O_RDONLY);
+    if (rc < 0) return (rc == LFS_ERR_NOENT) ? 0 : rc;
+    *s = (LogRotate_Segment){ 0, UINT32_MAX, 0, 0, LOG_MAN_SORTED };
+    lfs_ssize_t r;
+#if LOG_COMPRESS
+    static LogCodec_Decoder dec;
+    LogCodec_DecoderInit(&dec);
+    while ((r = lfs_file_read(lfs, &f, buf, sizeof buf)) > 0)
+        LogCodec_Decode(&dec, buf, (uint32_t)r, scan_record, s);
+#else
+    while ((r = lfs_file_read(lfs, &f, buf, sizeof buf)) > 0) {
+        for (uint32_t i = 0; i + LOG_REC_SIZE <= (uint32_t)r; i += LOG_REC_SIZE) {
+            uint32_t t; memcpy(&t, buf + i, sizeof t);
+            if (!s->records++) s->name = t;
+            else if (t < s->max) s->flags &= ~LOG_MAN_SORTED;   // SETTIME moved it back
+            if (t < s->min) s->min = t;
+            if (t > s->max) s->max = t;
+        }
+    }
+#endif
+    lfs_file_close(lfs, &f);
+    if (r < 0) return (int)r;
+    return (int)(s->records > INT32_MAX ? INT32_MAX : s->records);
+}
+
+int LogRotate_Rotate(lfs_t *lfs)
+{
+    LogRotate_Segment seg;
+    int rc = active_scan(lfs, &seg);
+    if (rc <= 0) return rc;
+    man_info_t m;
+    int n = man_read(lfs, NULL, NULL, &m, false);
+    if (n < 0) return n;
+    if (n > 0 && seg_gone(lfs, &m.last)) {
+        // the last rotation listed this file and never renamed it: drop
+        // that entry before listing the file again
+        rc = man_compact(lfs, true);
+        if (rc == 0) rc = man_read(lfs, NULL, NULL, &m, false);
+        if (rc < 0) return rc;
+    }
+    rc = lfs_mkdir(lfs, LOG_ARCHIVE_DIR);
+    if (rc == 0) LFS_W25Q64_UsageInvalidate();   // a new metadata pair
+    else if (rc != LFS_ERR_EXIST) return rc;
+
+    // named after its first record; a name already taken (clock set back,
+    // or the last entry of a rotation cut short) moves up a second
+    char name[LOG_ARCHIVE_NAME_MAX];
+    struct lfs_info info;
+    for (;;) {
+        LogRotate_Name(name, seg.name);
+        if ((!m.adds || m.last.name != seg.name) && lfs_stat(lfs, name, &info) == LFS_ERR_NOENT) break;
+        seg.name++;
+    }
+    // listed first: a reset before the rename leaves an entry without a
+    // file, which readers skip, rather than a file no one can find
+    rc = man_append(lfs, &seg);
+    if (rc < 0) return rc;
+    rc = lfs_rename(lfs, ACTIVE_FILE, name);
+    if (rc < 0) return rc;
+    bucket_put(0);
+#if !LOG_COMPRESS
+    // they number the records of the segment that just left
+    struct lfs_info x;
+    if (lfs_stat(lfs, LOG_IDX_FILE, &x) == 0 && lfs_remove(lfs, LOG_IDX_FILE) == 0)
+        LFS_W25Q64_UsageFileGrew(lfs, (lfs_soff_t)x.size, 0);
+    if (lfs_stat(lfs, LOG_SEG_FILE, &x) == 0 && lfs_remove(lfs, LOG_SEG_FILE) == 0)
+        LFS_W25Q64_UsageFileGrew(lfs, (lfs_soff_t)x.size, 0);
+#endif
+    return 1;
+}
+
+/* First epoch of the active segment */
+static int active_first(lfs_t *lfs, uint32_t *epoch)
+{
+    lfs_file_t f;
+    int rc = lfs_file_open(lfs, &f, ACTIVE_FILE, LFS_O_RDONLY);
+    if (rc < 0) return rc;
+    // wake.z opens with a frame header, then the keyframe
+    (void)lfs_file_seek(lfs, &f, LOG_COMPRESS ? (lfs_soff_t)LOG_CODEC_HDR : 0, LFS_SEEK_SET);
+    lfs_ssize_t r = lfs_file_read(lfs, &f, epoch, sizeof *epoch);
+    lfs_file_close(lfs, &f);
+    return (r == (lfs_ssize_t)sizeof *epoch) ? 0 : LFS_ERR_CORRUPT;
+}
+
+int LogRotate_Check(lfs_t *lfs, uint32_t next_epoch)
+{
+    uint32_t limit = LogRotate_SegmentBytes();
+#if !LOG_SEGMENT_SECONDS
+    if (!limit) return 0;   // one file: not even a stat on the flush path
+#endif
+    struct lfs_info info;
+    bool empty = lfs_stat(lfs, ACTIVE_FILE, &info) < 0 || info.size == 0;
+#if LOG_SEGMENT_SECONDS
+    // the batch about to be appended starts the segment's bucket
+    uint32_t next = bucket_of(next_epoch);
+    if (empty) { bucket_put(next); return 0; }
+    uint32_t have = policy_word() & BUCKET_BITS, first;
+    if (!have && active_first(lfs, &first) == 0) bucket_put(have = bucket_of(first));
+    if ((!limit || info.size < limit) && (!have || have == next)) return 0;
+    int rc = LogRotate_Rotate(lfs);
+    if (rc >= 0) bucket_put(next);
+    return rc;
+#else
+    (void)next_epoch;
+    (void)active_first;
+    if (empty || info.size < limit) return 0;
+    return LogRotate_Rotate(lfs);
+#endif
+}
+
+static void keep_oldest(const LogRotate_Segment *s, void *ctx)
+{
+    LogRotate_Segment *o = (LogRotate_Segment *)ctx;
+    if (o->records == LOG_MAN_DROP) *o = *s;
+}
+
+int LogRotate_Evict(lfs_t *lfs)
+{
+    // unchecked: a tombstone drops the oldest entry, gone file or not
+    LogRotate_Segment oldest = { .records = LOG_MAN_DROP };
+    int n = man_read(lfs, keep_oldest, &oldest, NULL, false);
+    if (n == 0) {
+        n = LogRotate_Rotate(lfs);
+        if (n <= 0) return n;
+        n = man_read(lfs, keep_oldest, &oldest, NULL, false);
+    }
+    if (n <= 0) return n;
+    char name[LOG_ARCHIVE_NAME_MAX];
+    struct lfs_info info;
+    LogRotate_Name(name, oldest.name);
+    int rc = lfs_stat(lfs, name, &info);
+    if (rc == 0) {
+        rc = lfs_remove(lfs, name);
+        if (rc == 0) LFS_W25Q64_UsageFileGrew(lfs, (lfs_soff_t)info.size, 0);
+    }
+    if (rc < 0 && rc != LFS_ERR_NOENT) return rc;   // gone already: only the entry is left
+    LogRotate_Segment drop = { oldest.name, 0, 0, LOG_MAN_DROP, 0 };
+    rc = man_append(lfs, &drop);
+    if (rc == 0) (void)man_compact(lfs, false);
+    return (rc < 0) ? rc : 1;
+}
+
+/* ---- byte windows (GETLOG OFFSET/LEN) ---- */
+
+typedef struct {
+    lfs_t *lfs;
+    uint32_t pos;             /* records before the current file */
+    uint32_t first, end;      /* window, records */
+    LogQuery_Sink sink;
+    void *ctx;
+    uint32_t base;
+    int err;
+} window_t;
+
+/* The part of [first, end) in the n records from w->pos */
+static void window_file(window_t *w, lfs_file_t *f, uint32_t n)
+{
+    uint32_t from = (w->first > w->pos) ? w->first - w->pos : 0u;
+    uint32_t to = (w->end > w->pos) ? w->end - w->pos : 0u;
+    if (to > n) to = n;
+    if (from < to) w->sink(f, from, to, false, w->ctx);
+    w->pos += n;
+}
+
+static void window_segment(const LogRotate_Segment *seg, void *ctx)
+{
+    window_t *w = (window_t *)ctx;
+    char name[LOG_ARCHIVE_NAME_MAX];
+    lfs_file_t f;
+    if (!w->base) w->base = seg->name;
+    if (w->pos + seg->records <= w->first || w->pos >= w->end) { w->pos += seg->records; return; }
+    LogRotate_Name(name, seg->name);
+    int rc = lfs_file_open(w->lfs, &f, name, LFS_O_RDONLY);
+    if (rc < 0) { w->err = rc; w->pos += seg->records; return; }
+    window_file(w, &f, seg->records);
+    lfs_file_close(w->lfs, &f);
+}
+
+int LogRotate_Window(lfs_t *lfs, uint32_t first, uint32_t count,
+                     LogQuery_Sink sink, void *ctx, uint32_t *base)
+{
+#if LOG_COMPRESS
+    (void)lfs; (void)first; (void)count; (void)sink; (void)ctx;
+    if (base) *base = 0;
+    return LFS_ERR_INVAL;   // segments hold frames: no record offsets
+#else
+    window_t w = { lfs, 0, first, count ? first + count : UINT32_MAX, sink, ctx, 0, 0 };
+    if (w.end < first) w.end = UINT32_MAX;
+    int rc = LogRotate_Segments(lfs, window_segment, &w);
+    if (base) *base = w.base;
+    if (rc < 0) return rc;
+    lfs_file_t f;
+    rc = lfs_file_open(lfs, &f, ACTIVE_FILE, LFS_O_RDONLY);
+    if (rc >= 0) {
+        lfs_soff_t sz = lfs_file_size(lfs, &f);
+        window_file(&w, &f, (sz > 0) ? (uint32_t)sz / LOG_REC_SIZE : 0u);
+        lfs_file_close(lfs, &f);
+    } else if (rc != LFS_ERR_NOENT) {
+        return rc;
+    }
+    return w.err ? w.err : (int)w.pos;
+#endif
+}
+
+int LogRotate_RemoveAll(lfs_t *lfs)
+{
+    // by directory, not by manifest: files a reset left unlisted go too
+    char name[LOG_ARCHIVE_NAME_MAX + LFS_NAME_MAX];
+    for (;;) {
+        lfs_dir_t dir;
+        struct lfs_info info;
+        int rc = lfs_dir_open(lfs, &dir, LOG_ARCHIVE_DIR);
+        if (rc < 0) break;
+        bool found = false;
+        while (!found && lfs_dir_read(lfs, &dir, &info) > 0) found = (info.type == LFS_TYPE_REG);
+        lfs_dir_close(lfs, &dir);
+        if (!found) break;
+        snprintf(name, sizeof name, LOG_ARCHIVE_DIR "/%s", info.name);
+        if (lfs_remove(lfs, name) < 0) break;
+    }
+    (void)lfs_remove(lfs, MAN_NEW_FILE);
+    (void)lfs_remove(lfs, LOG_MAN_FILE);
+    int rc = lfs_remove(lfs, LOG_ARCHIVE_DIR);
+    return (rc == LFS_ERR_NOENT) ? 0 : rc;
+}
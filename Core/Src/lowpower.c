@@ -1,5 +1,14 @@
 #include "lowpower.h"
 
+LPTIM_HandleTypeDef hlptim1;
+
+#define LP_LSE_HZ            32768u
+#define LP_SLEEP_MIN_TICKS   4u          // below ~120 us the Stop entry/exit is not worth it
+#define LP_SLEEP_MAX_US      1900000u    // 16-bit ARR at 32.768 kHz covers 2 s
+
+static volatile uint8_t s_lptim_fired;
+static uint32_t s_stop_rem_us;           // sub-ms part of Stop time not yet folded into uwTick
+
 void SPI1_EnterLowPower(void)
 {
     HAL_GPIO_WritePin(GPIOA, GPIO_PIN_4, GPIO_PIN_SET);
@@ -19,3 +28,72 @@ void Pins_StandbyQuiescent_Config(void)
     HAL_PWREx_EnableGPIOPullDown (PWR_GPIO_A, PWR_GPIO_BIT_6); // MISO low
     HAL_PWREx_EnablePullUpPullDownConfig();
 }
+
+static void LPTIM1_OnDemand_Init(void)
+{
+    hlptim1.Instance = LPTIM1;
+    hlptim1.Init.Clock.Source = LPTIM_CLOCKSOURCE_APBCLOCK_LPOSC; // LSE, see HAL_LPTIM_MspInit
+    hlptim1.Init.Clock.Prescaler = LPTIM_PRESCALER_DIV1;
+    hlptim1.Init.Trigger.Source = LPTIM_TRIGSOURCE_SOFTWARE;
+    hlptim1.Init.OutputPolarity = LPTIM_OUTPUTPOLARITY_HIGH;
+    hlptim1.Init.UpdateMode = LPTIM_UPDATE_IMMEDIATE;
+    hlptim1.Init.CounterSource = LPTIM_COUNTERSOURCE_INTERNAL;
+    hlptim1.Init.Input1Source = LPTIM_INPUT1SOURCE_GPIO;
+    hlptim1.Init.Input2Source = LPTIM_INPUT2SOURCE_GPIO;
+    HAL_LPTIM_Init(&hlptim1);
+}
+
+void HAL_LPTIM_AutoReloadMatchCallback(LPTIM_HandleTypeDef *hlptim)
+{
+    if (hlptim->Instance == LPTIM1) s_lptim_fired = 1;
+}
+
+// SysTick is frozen in Stop: credit the slept time to the HAL tick
+static void LP_CreditStopTime(uint32_t us)
+{
+    s_stop_rem_us += us;
+    uwTick += s_stop_rem_us / 1000u;
+    s_stop_rem_us %= 1000u;
+}
+
+uint32_t LP_NowUs(void)
+{
+    uint32_t ms, val;
+    do { ms = HAL_GetTick(); val = SysTick->VAL; } while (ms != HAL_GetTick());
+    uint32_t load = SysTick->LOAD + 1u;
+    return ms * 1000u + s_stop_rem_us + (uint32_t)(((uint64_t)(load - val) * 1000u) / load);
+}
+
+void LP_SleepUs(uint32_t us)
+{
+    while (us) {
+        uint32_t slice = (us > LP_SLEEP_MAX_US) ? LP_SLEEP_MAX_US : us;
+        uint32_t ticks = (uint32_t)(((uint64_t)slice * LP_LSE_HZ) / 1000000u);
+        us -= slice;
+
+        if (ticks < LP_SLEEP_MIN_TICKS) {
+            uint32_t t0 = LP_NowUs();
+            while ((LP_NowUs() - t0) < slice) { }
+            continue;
+        }
+
+        if (hlptim1.State == HAL_LPTIM_STATE_RESET) LPTIM1_OnDemand_Init();
+        s_lptim_fired = 0;
+        HAL_LPTIM_Counter_Start_IT(&hlptim1, ticks - 1u);
+
+        if (__HAL_RCC_GET_SYSCLK_SOURCE() == RCC_SYSCLKSOURCE_STATUS_PLLCLK) {
+            // USB session: PLL and the USB peripheral must keep running, Sleep only
+            while (!s_lptim_fired) HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+        } else {
+            // Stop 2 is not reachable from low-power run; Stop 1 is the LPR equivalent
+            HAL_SuspendTick();
+            while (!s_lptim_fired) {
+                if (READ_BIT(PWR->CR1, PWR_CR1_LPR)) HAL_PWREx_EnterSTOP1Mode(PWR_STOPENTRY_WFI);
+                else HAL_PWREx_EnterSTOP2Mode(PWR_STOPENTRY_WFI);
+            }
+            HAL_ResumeTick();
+            LP_CreditStopTime((uint32_t)(((uint64_t)ticks * 1000000u) / LP_LSE_HZ));
+        }
+        HAL_LPTIM_Counter_Stop_IT(&hlptim1);
+    }
+}
@@ -12,6 +12,9 @@
 #include "lowpower.h"
 #include "usb_device.h"
 #include "rtc_provision.h"
+#include "wake_batch.h"
+#include "ring_log.h"
+#include "log_rotate.h"
 
 void StandbyUSB_BootPath(void);
 void Standby_ArmUSBWake_AndEnter(void);
@@ -21,24 +24,70 @@ static void Configure_PA2_As_WakeupPin4(bool);
 #define LED_FIRST_LOG_MAGIC   ((uint32_t)0x1ED0)   // any non-zero magic
 #define LED_FIRST_LOG_REG     RTC_BKP_DR0          // choose DR0..DR31 per your MCU
 
+// --- Clock boost around the flash/littlefs burst ---
+// The wake idles at 2 MHz MSI in low-power run; mount/append/unmount run
+// faster and cheaper out of LP run with a higher MSI range and a faster SCK
+// (see the "clock" section of tools/hostsim/bench.c). 0 keeps 2 MHz / 250 kHz.
+#ifndef STORAGE_CLOCK_BOOST
+#define STORAGE_CLOCK_BOOST        1
+#endif
+#ifndef STORAGE_BOOST_MSI_RANGE
+#define STORAGE_BOOST_MSI_RANGE    RCC_MSIRANGE_8            // 16 MHz
+#endif
+#ifndef STORAGE_BOOST_SPI_PRESCALER
+#define STORAGE_BOOST_SPI_PRESCALER SPI_BAUDRATEPRESCALER_2  // 8 MHz SCK
+#endif
+
+#if RINGLOG_ENABLE && !LFS_W25Q64_BLOCK_COUNT
+#error "RINGLOG_ENABLE needs LFS_W25Q64_BLOCK_COUNT: littlefs keeps the low blocks, the ring the rest"
+#endif
+#if RINGLOG_ENABLE && LOG_COMPRESS
+#error "LOG_COMPRESS applies to the littlefs log; ring pages hold whole 8-byte records"
+#endif
+
+// --- Storage maintenance on battery: lfs_fs_gc and the free blocks the next
+// wakes will allocate erased now, every N wakes that mount the volume, within
+// a time budget (see the "maint" section of tools/hostsim/bench.c). A USB
+// session runs the whole pass on VBUS. 0 = under USB only ---
+#ifndef MAINT_EVERY_WAKES
+#define MAINT_EVERY_WAKES          4u
+#endif
+#ifndef MAINT_BUDGET_US
+#define MAINT_BUDGET_US            250000u
+#endif
+
+// --- Low battery: PVD threshold that forces the SRAM2 batch out to flash ---
+// PVD level 5 trips below ~2.8 V, still inside the W25Q64JV 2.7 V minimum
+#ifndef LOWBATT_PVD_LEVEL
+#define LOWBATT_PVD_LEVEL          PWR_PVDLEVEL_5
+#endif
+
 lfs_t lfs;
 lfs_file_t f;
 struct lfs_config lfs_cfg;
 RTC_HandleTypeDef hrtc;
 SPI_HandleTypeDef hspi1;
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
 
 typedef struct __attribute__((packed)) {
     uint32_t epoch;
     int16_t  t_x100;
     uint16_t rh_x100;
 } logrec_t;
+_Static_assert(sizeof(logrec_t) == sizeof(LogCodec_Rec), "log_codec.h mirrors logrec_t");
 
 static void SystemClock_Config_Base_LSE_MSI2MHz(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_SPI1_Init(void);
 static void MX_RTC_Init_LSE(void);
 static void Enter_LowPowerRun2MHz(void);
 static void Exit_LowPowerRun(void);
+static void Storage_ClockBoost(void);
+static void Storage_ClockRestore(void);
+static uint8_t Supply_IsLow(void);
+static uint8_t VBUS_Present(void);
 
 int main(void)
 {
@@ -46,6 +95,7 @@ int main(void)
     SystemClock_Config_Base_LSE_MSI2MHz();
     MX_GPIO_Init();
     MX_RTC_Init_LSE();
+    MX_DMA_Init();
     MX_SPI1_Init();
 
     // Allow writing to the RTC backup registers
@@ -65,8 +115,44 @@ int main(void)
     HAL_DBGMCU_DisableDBGStandbyMode();
 
     W25Q64_Bind(&hspi1, GPIOA, GPIO_PIN_4);
+    // Every way into Standby puts the flash in deep power-down first
+    if (__HAL_PWR_GET_FLAG(PWR_FLAG_SB) != RESET) W25Q64_AssumePowerState(W25Q64_POWER_DPD);
+    W25Q64_EnableDMA(1);   // long reads / page programs sleep in WFI
+    static const W25Q64_Platform flash_platform = { LP_SleepUs, LP_NowUs };
+    W25Q64_BindPlatform(&flash_platform);   // erase/program waits sleep on LPTIM1
+    static const LFS_W25Q64_EraseMarker erase_marker = { RTC_GetEraseMarker, RTC_SetEraseMarker };
+    LFS_W25Q64_BindEraseMarker(&erase_marker);   // blank blocks skip their erase
+    static const LFS_W25Q64_SnapshotStore mount_snapshot = { RTC_LoadMountSnapshot, RTC_SaveMountSnapshot };
+    LFS_W25Q64_BindSnapshot(&mount_snapshot);    // next wake skips the metadata walk
+    static const LFS_W25Q64_UsageStore fs_usage = { RTC_GetFsUsage, RTC_SetFsUsage };
+    LFS_W25Q64_BindUsage(&fs_usage);             // near-full check without lfs_fs_size
+    static const LogRotate_PolicyStore retention = { RTC_GetRetention, RTC_SetRetention };
+    LogRotate_BindPolicy(&retention);            // STOP or WRAP once the volume is full
+    static const LFS_W25Q64_MaintStore maint_counters = { RTC_LoadMaint, RTC_SaveMaint };
+    LFS_W25Q64_BindMaint(&maint_counters);       // erases moved off the logging wakes
+    static const LFS_W25Q64_GeometryStore flash_geometry = { WakeBatch_LoadGeometry, WakeBatch_SaveGeometry };
+    LFS_W25Q64_BindGeometry(&flash_geometry);    // probed once, kept in SRAM2
     LFS_W25Q64_InitConfig(&lfs_cfg);
 
+    static uint8_t lfs_read_buf [LFS_W25Q64_CACHE_SIZE];
+    static uint8_t lfs_prog_buf [LFS_W25Q64_CACHE_SIZE];
+    static uint8_t lfs_lookahead [LFS_W25Q64_LOOKAHEAD];
+
+    lfs_cfg.read_buffer      = lfs_read_buf;
+    lfs_cfg.prog_buffer      = lfs_prog_buf;
+    lfs_cfg.lookahead_buffer = lfs_lookahead;   // FIXED: use dedicated lookahead buffer
+
+#if RINGLOG_ENABLE
+    // Records live in a raw ring above the littlefs partition
+    W25Q64_Geometry geo;
+    W25Q64_GetGeometry(&geo);
+    uint32_t lfs_bytes = lfs_cfg.block_count * lfs_cfg.block_size;
+    RingLog_Init(lfs_bytes, geo.capacity - lfs_bytes);
+#endif
+    // Only a probe (first wake after power-on) leaves the part awake; every
+    // path below that needs it releases it again
+    W25Q64_EnterDeepPowerDown();
+
     StandbyUSB_BootPath();
     Enter_LowPowerRun2MHz();
 
@@ -74,25 +160,8 @@ int main(void)
     HAL_RTC_GetTime(&hrtc, &t, RTC_FORMAT_BIN);
     HAL_RTC_GetDate(&hrtc, &d, RTC_FORMAT_BIN);
     uint32_t now = rtc_datetime_to_epoch(&d, &t);
-    W25Q64_ReleaseFromDeepPowerDown();
-
-    static uint8_t lfs_read_buf [LFS_W25Q128_CACHE_SIZE];
-    static uint8_t lfs_prog_buf [LFS_W25Q128_CACHE_SIZE];
-    static uint8_t lfs_lookahead [LFS_W25Q128_LOOKAHEAD];
-
-    lfs_cfg.read_buffer      = lfs_read_buf;
-    lfs_cfg.prog_buffer      = lfs_prog_buf;
-    lfs_cfg.lookahead_buffer = lfs_lookahead;   // FIXED: use dedicated lookahead buffer
-
-    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) {
-        LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
-    }
-
-    // --- Filesystem near-full detection (centralized helper) ---
-    // Keep 2 blocks reserved for metadata/erase safety
-    uint8_t fs_full = FS_IsNearFull(2);
 
-    // --- Read sensor and append a binary record ---
+    // --- Read sensor first: I2C1 timing is set for PCLK1 = 2 MHz ---
     I2C1_OnDemand_Init();
     sht4x_reading_t r = SHT4x_ReadSingleShot(SHT4X_CMD_MED_PREC);
     I2C1_OnDemand_DeInit();
@@ -103,9 +172,58 @@ int main(void)
         .rh_x100= r.ok ? (uint16_t)lroundf(r.rh*100.0f)    : UINT16_MAX
     };
 
-    if (lfs_file_open(&lfs, &f, "wake.bin", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) == 0) {
-        (void)lfs_file_write(&lfs, &f, &rec, sizeof(rec));
-        lfs_file_close(&lfs, &f);
+    // --- ENDLOG stop check ---
+    uint32_t endE = 0;
+    int hasEnd = (RTC_GetEndEpoch(&endE) == 0);
+    uint8_t end_reached = (hasEnd && now >= endE) ? 1 : 0;
+
+    // Quick VBUS detect: if present, offer USB service window
+    uint8_t usb = VBUS_Present();
+
+    // --- Queue the record in SRAM2; the flash only wakes for a group flush,
+    // and before USB service, ENDLOG or a low battery ---
+    int queued = WakeBatch_Append(&rec, sizeof(rec));
+    uint8_t fs_full = 0;
+    uint8_t supply_low = Supply_IsLow();   // 1 ms of PVD settling: sample once
+    if (queued != 0 || end_reached || usb || supply_low) {
+        Storage_ClockBoost();
+        W25Q64_ReleaseFromDeepPowerDown();
+
+#if RINGLOG_ENABLE
+        // --- Append the batch to the ring: page programs only, no mount ---
+        if (WakeBatch_Sync() == 0 && queued < 0) {
+            (void)WakeBatch_Append(&rec, sizeof(rec));   // had no room before the flush
+            (void)WakeBatch_Sync();
+        }
+#else
+        if (LFS_W25Q64_FastMount(&lfs, &lfs_cfg, NULL) != 0) {
+            LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
+        }
+
+        // --- Filesystem near-full detection (centralized helper) ---
+        // Keep 2 blocks reserved for metadata/erase safety
+        fs_full = FS_IsNearFull(2);
+
+        // --- WRAP retention: make room by dropping the oldest segments ---
+        while (fs_full && LogRotate_GetPolicy() == LOG_RETAIN_WRAP && LogRotate_Evict(&lfs) > 0)
+            fs_full = FS_IsNearFull(2);
+
+        // --- Append the batch to wake.bin ---
+        if (WakeBatch_Flush(&lfs) == 0 && queued < 0) {
+            (void)WakeBatch_Append(&rec, sizeof(rec));   // had no room before the flush
+            (void)WakeBatch_Flush(&lfs);
+        }
+
+        // --- Maintenance after the records are safe; not with USB (the
+        // session does it on VBUS), a low supply or Standby for good ahead ---
+        uint32_t since = LFS_W25Q64_MaintNoteWake();
+        if (MAINT_EVERY_WAKES && since >= MAINT_EVERY_WAKES && !usb && !fs_full && !end_reached && !supply_low)
+            (void)LFS_W25Q64_Maintain(&lfs, MAINT_BUDGET_US);
+
+        LFS_W25Q64_FastUnmount(&lfs);
+#endif
+        W25Q64_EnterDeepPowerDown();
+        Storage_ClockRestore();
     }
 
     // If this was the first-ever log, mark it done and turn LED OFF
@@ -114,33 +232,22 @@ int main(void)
         HAL_GPIO_WritePin(LED_GPIO_Port, LED_Pin, GPIO_PIN_RESET);
     }
 
-    LFS_W25Q64_Unmount(&lfs);
-    W25Q64_EnterDeepPowerDown();
-    HAL_Delay(5);
-
-    // Quick VBUS detect: if present, offer USB service window
-    __HAL_RCC_GPIOA_CLK_ENABLE();
-    GPIO_InitTypeDef g = {0};
-    g.Pin = GPIO_PIN_2;
-    g.Mode = GPIO_MODE_INPUT;
-    g.Pull = GPIO_PULLDOWN;
-    g.Speed = GPIO_SPEED_FREQ_LOW;
-    HAL_GPIO_Init(GPIOA, &g);
-    HAL_Delay(5);
-    if (HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_2) == GPIO_PIN_SET) {
+    if (usb) {
         Exit_LowPowerRun();
         W25Q64_ReleaseFromDeepPowerDown();
         USB_Service_UploadWakeLog();
         W25Q64_EnterDeepPowerDown();
-        HAL_Delay(5);
     }
 
-    // --- ENDLOG stop check ---
-    uint32_t endE = 0;
-    int hasEnd = (RTC_GetEndEpoch(&endE) == 0);
-    uint8_t end_reached = (hasEnd && now >= endE) ? 1 : 0;
+    W25Q64_EnterDeepPowerDown();   // whatever ran above, Standby finds it in DPD
+
+    // Flash time out of deep power-down this wake, summed over the deployment
+    W25Q64_PowerStats fp;
+    W25Q64_GetPowerStats(&fp);
+    RTC_AddFlashAwake(fp.awake_us);
 
-    // --- Infinite Standby policy: if memory full OR ENDLOG reached ---
+    // --- Infinite Standby policy: if memory full (STOP, or WRAP with
+    // nothing left to evict) OR ENDLOG reached ---
     if (fs_full || end_reached) {
         SPI1_EnterLowPower();
         Pins_StandbyQuiescent_Config();
@@ -207,6 +314,16 @@ static void MX_GPIO_Init(void)
     HAL_GPIO_Init(LED_GPIO_Port, &GPIO_InitStruct);
 }
 
+static void MX_DMA_Init(void)
+{
+    // SPI1_RX -> DMA1_Channel2, SPI1_TX -> DMA1_Channel3 (request 1)
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Channel3_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+}
+
 static void MX_RTC_Init_LSE(void)
 {
     __HAL_RCC_RTC_ENABLE();
@@ -223,6 +340,72 @@ static void MX_RTC_Init_LSE(void)
 static void Enter_LowPowerRun2MHz(void) { HAL_PWREx_EnableLowPowerRunMode(); }
 static void Exit_LowPowerRun(void)      { HAL_PWREx_DisableLowPowerRunMode(); }
 
+static void MSI_SetRange(uint32_t range)
+{
+    // HAL orders the flash wait states against the MSI change and retunes SysTick
+    RCC_OscInitTypeDef osc = {0};
+    osc.OscillatorType = RCC_OSCILLATORTYPE_MSI;
+    osc.MSIState = RCC_MSI_ON;
+    osc.MSICalibrationValue = 0;
+    osc.MSIClockRange = range;
+    osc.PLL.PLLState = RCC_PLL_NONE;
+    HAL_RCC_OscConfig(&osc);
+}
+
+static void SPI1_SetPrescaler(uint32_t prescaler)
+{
+    // SPE is set again by the next HAL transfer
+    __HAL_SPI_DISABLE(&hspi1);
+    MODIFY_REG(hspi1.Instance->CR1, SPI_CR1_BR, prescaler);
+    hspi1.Init.BaudRatePrescaler = prescaler;
+}
+
+// Leave LP run (limited to 2 MHz) for the storage burst
+static void Storage_ClockBoost(void)
+{
+#if STORAGE_CLOCK_BOOST
+    Exit_LowPowerRun();
+    MSI_SetRange(STORAGE_BOOST_MSI_RANGE);
+    SPI1_SetPrescaler(STORAGE_BOOST_SPI_PRESCALER);
+#endif
+}
+
+static void Storage_ClockRestore(void)
+{
+#if STORAGE_CLOCK_BOOST
+    SPI1_SetPrescaler(SPI_BAUDRATEPRESCALER_8);
+    MSI_SetRange(RCC_MSIRANGE_5);
+    Enter_LowPowerRun2MHz();
+#endif
+}
+
+// PVD sampled once per wake, then switched off again
+static uint8_t Supply_IsLow(void)
+{
+    PWR_PVDTypeDef pvd = {0};
+    pvd.PVDLevel = LOWBATT_PVD_LEVEL;
+    pvd.Mode = PWR_PVD_MODE_NORMAL;
+    HAL_PWR_ConfigPVD(&pvd);
+    HAL_PWR_EnablePVD();
+    HAL_Delay(1);   // comparator settling
+    uint8_t low = (__HAL_PWR_GET_FLAG(PWR_FLAG_PVDO) != RESET) ? 1 : 0;
+    HAL_PWR_DisablePVD();
+    return low;
+}
+
+static uint8_t VBUS_Present(void)
+{
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    GPIO_InitTypeDef g = {0};
+    g.Pin = GPIO_PIN_2;
+    g.Mode = GPIO_MODE_INPUT;
+    g.Pull = GPIO_PULLDOWN;
+    g.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(GPIOA, &g);
+    HAL_Delay(5);
+    return (HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_2) == GPIO_PIN_SET) ? 1 : 0;
+}
+
 static void Configure_PA2_As_WakeupPin4(bool active_high)
 {
     __HAL_RCC_GPIOA_CLK_ENABLE();
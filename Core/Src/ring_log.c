@@ -0,0 +1,225 @@
+// ring_log.c - append-only record ring on raw flash (see ring_log.h)
+#include "ring_log.h"
+#include "w25q64.h"
+#include "lfs_util.h"
+#include <string.h>
+
+#define RING_MAGIC    0x474F4C52u   /* "RLOG" */
+#define SECTOR_HDR    8u
+#define PAGE_HDR      8u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+} sector_hdr_t;
+
+typedef struct {
+    uint16_t len;
+    uint16_t nlen;            /* ~len, tells a header from a torn program */
+    uint32_t crc;             /* sector seq, page index, payload */
+} page_hdr_t;
+
+static struct {
+    uint32_t base, sectors;
+    uint32_t head, page, seq;   /* head sector, next free page in it, its sequence */
+    uint8_t  mounted, empty;
+    uint32_t reads, mount_reads;
+} ring;
+
+static uint32_t sector_addr(uint32_t s) { return ring.base + s * RINGLOG_SECTOR_SIZE; }
+
+/* The first page of a sector starts after the sector header */
+static uint32_t page_addr(uint32_t s, uint32_t p)
+{
+    return sector_addr(s) + p * RINGLOG_PAGE_SIZE + (p ? 0u : SECTOR_HDR);
+}
+
+static uint32_t page_room(uint32_t p)
+{
+    uint32_t room = RINGLOG_PAGE_SIZE - PAGE_HDR - (p ? 0u : SECTOR_HDR);
+    return room - room % RINGLOG_REC_SIZE;
+}
+
+static uint32_t page_crc(uint32_t seq, uint32_t p, const void *payload, uint32_t len)
+{
+    uint32_t crc = lfs_crc(0xFFFFFFFFu, &seq, sizeof seq);
+    crc = lfs_crc(crc, &p, sizeof p);
+    return lfs_crc(crc, payload, len);
+}
+
+/* Sequence number of a sector, 0 if its header is blank or torn */
+static uint32_t sector_seq(uint32_t s)
+{
+    sector_hdr_t h;
+    W25Q64_Read(sector_addr(s), (uint8_t*)&h, sizeof h);
+    ring.reads++;
+    return (h.magic == RING_MAGIC && h.seq != 0xFFFFFFFFu) ? h.seq : 0;
+}
+
+static int page_used(uint32_t s, uint32_t p)
+{
+    page_hdr_t h;
+    W25Q64_Read(page_addr(s, p), (uint8_t*)&h, sizeof h);
+    ring.reads++;
+    return h.len != 0xFFFFu || h.nlen != 0xFFFFu || h.crc != 0xFFFFFFFFu;
+}
+
+static int page_blank(uint32_t s, uint32_t p)
+{
+    uint32_t buf[RINGLOG_PAGE_SIZE / 4u];
+    uint32_t len = RINGLOG_PAGE_SIZE - (p ? 0u : SECTOR_HDR);
+    W25Q64_Read(page_addr(s, p), (uint8_t*)buf, len);
+    ring.reads++;
+    for (uint32_t i = 0; i < len / 4u; i++) if (buf[i] != 0xFFFFFFFFu) return 0;
+    return 1;
+}
+
+int RingLog_Init(uint32_t base, uint32_t bytes)
+{
+    memset(&ring, 0, sizeof ring);
+    if (base % RINGLOG_SECTOR_SIZE || bytes < 2u * RINGLOG_SECTOR_SIZE) return -1;
+    ring.base = base;
+    ring.sectors = bytes / RINGLOG_SECTOR_SIZE;
+    return 0;
+}
+
+int RingLog_Mount(void)
+{
+    if (!ring.sectors) return -1;
+    uint32_t reads0 = ring.reads;
+    ring.mounted = 1;
+    ring.empty = 0;
+
+    uint32_t s0 = sector_seq(0);
+    if (!s0) {
+        /* sector 0 blank: an empty ring, or it was being reopened after a
+         * wrap and the head is still the last sector */
+        ring.seq = sector_seq(ring.sectors - 1u);
+        if (!ring.seq) {
+            ring.empty = 1;
+            ring.head = 0; ring.page = 0;
+            ring.mount_reads = ring.reads - reads0;
+            return 0;
+        }
+        ring.head = ring.sectors - 1u;
+    } else {
+        /* sectors [0, head] carry seq >= s0; after the head come blank
+         * sectors or the previous lap, all below s0 */
+        uint32_t lo = 0, hi = ring.sectors - 1u, seq = s0;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo + 1u) / 2u;
+            uint32_t q = sector_seq(mid);
+            if (q >= s0) { lo = mid; seq = q; }
+            else hi = mid - 1u;
+        }
+        ring.head = lo;
+        ring.seq = seq;
+    }
+
+    /* pages are written in order: first page with a blank header */
+    uint32_t lo = 0, hi = RINGLOG_PAGES;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2u;
+        if (page_used(ring.head, mid)) lo = mid + 1u;
+        else hi = mid;
+    }
+    /* a program cut short can leave the header blank but not the payload */
+    if (lo < RINGLOG_PAGES && !page_blank(ring.head, lo)) lo++;
+    ring.page = lo;
+    ring.mount_reads = ring.reads - reads0;
+    return 0;
+}
+
+/* Erase the sector after the head (the oldest once the ring has wrapped) */
+static void open_next(void)
+{
+    uint32_t s = ring.empty ? 0u : (ring.head + 1u) % ring.sectors;
+    W25Q64_SectorErase4K(sector_addr(s));
+    ring.head = s;
+    ring.page = 0;
+    ring.seq++;
+    ring.empty = 0;
+}
+
+int RingLog_Append(const void *recs, uint32_t bytes)
+{
+    const uint8_t *src = (const uint8_t*)recs;
+    if (!ring.sectors) return -1;
+    if (!ring.mounted) RingLog_Mount();
+    while (bytes) {
+        if (ring.empty || ring.page >= RINGLOG_PAGES) open_next();
+        uint32_t room = page_room(ring.page);
+        uint32_t n = (bytes < room) ? bytes : room;
+        uint8_t buf[RINGLOG_PAGE_SIZE];
+        uint32_t off = 0;
+        if (ring.page == 0) {
+            sector_hdr_t sh = { RING_MAGIC, ring.seq };
+            memcpy(buf, &sh, sizeof sh);
+            off = SECTOR_HDR;
+        }
+        page_hdr_t ph = { (uint16_t)n, (uint16_t)~n, page_crc(ring.seq, ring.page, src, n) };
+        memcpy(buf + off, &ph, sizeof ph);
+        memcpy(buf + off + PAGE_HDR, src, n);
+        W25Q64_PageProgram(sector_addr(ring.head) + ring.page * RINGLOG_PAGE_SIZE, buf, off + PAGE_HDR + n);
+        ring.page++;
+        src += n;
+        bytes -= n;
+    }
+    return 0;
+}
+
+void RingLog_ReadBegin(RingLog_Cursor *c)
+{
+    if (!ring.mounted) RingLog_Mount();
+    /* from the sector after the head around to the head; before the first
+     * wrap the blank ones are skipped on their header */
+    c->sector = ring.sectors ? (ring.head + 1u) % ring.sectors : 0u;
+    c->page = 0;
+    c->seq = 0;
+    c->left = ring.empty ? 0u : ring.sectors;
+}
+
+int RingLog_Read(RingLog_Cursor *c, uint8_t *buf)
+{
+    while (c->left) {
+        if (!c->seq) c->seq = sector_seq(c->sector);
+        if (!c->seq || c->page >= RINGLOG_PAGES) {
+            c->sector = (c->sector + 1u) % ring.sectors;
+            c->page = 0;
+            c->seq = 0;
+            c->left--;
+            continue;
+        }
+        uint32_t p = c->page++;
+        uint32_t len = RINGLOG_PAGE_SIZE - (p ? 0u : SECTOR_HDR);
+        W25Q64_Read(page_addr(c->sector, p), buf, len);
+        page_hdr_t h;
+        memcpy(&h, buf, sizeof h);
+        /* blank or torn pages are skipped, a later page may still be valid */
+        if ((h.len ^ h.nlen) != 0xFFFFu || h.len > len - PAGE_HDR) continue;
+        if (page_crc(c->seq, p, buf + PAGE_HDR, h.len) != h.crc) continue;
+        memmove(buf, buf + PAGE_HDR, h.len);
+        return h.len;
+    }
+    return 0;
+}
+
+void RingLog_Erase(void)
+{
+    /* a sector without a header is erased again before it is reused */
+    for (uint32_t s = 0; s < ring.sectors; s++) {
+        if (sector_seq(s)) W25Q64_SectorErase4K(sector_addr(s));
+    }
+    ring.mounted = 1;
+    ring.empty = 1;
+    ring.head = 0; ring.page = 0; ring.seq = 0;
+}
+
+void RingLog_GetInfo(RingLog_Info *out)
+{
+    if (!out) return;
+    out->sectors = ring.sectors;
+    out->used_sectors = ring.empty ? 0u : (ring.seq < ring.sectors ? ring.seq : ring.sectors);
+    out->head_seq = ring.seq;
+    out->mount_reads = ring.mount_reads;
+}
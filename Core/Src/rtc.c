@@ -1,4 +1,5 @@
 #include "rtc.h"
+#include "wake_batch.h"
 
 extern RTC_HandleTypeDef hrtc;
 
@@ -45,7 +46,7 @@ void RTC_ScheduleNextAlarm_AndStandby(uint32_t seconds_from_now)
     a.AlarmMask = RTC_ALARMMASK_NONE;
     a.AlarmTime = at;
     HAL_RTC_SetAlarm_IT(&hrtc, &a, RTC_FORMAT_BIN);
-    /* HAL helper: disables SRAM2 content retention in Standby */
-    HAL_PWREx_DisableSRAM2ContentRetention();
+    /* SRAM2 keeps the batch and the flash geometry */
+    WakeBatch_ArmRetention();
     HAL_PWR_EnterSTANDBYMode();
 }
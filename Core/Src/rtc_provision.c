@@ -129,6 +129,67 @@ uint32_t RTC_GetLoggingInterval(void) {
     return v;
 }
 
+/* ---- Flash erase marker ---- */
+void RTC_SetEraseMarker(uint32_t mark) {
+    HAL_RTCEx_BKUPWrite(&hrtc, RTC_ERASE_MARK_DR, mark);
+}
+uint32_t RTC_GetEraseMarker(void) {
+    return HAL_RTCEx_BKUPRead(&hrtc, RTC_ERASE_MARK_DR);
+}
+
+/* ---- Flash awake time ---- */
+void RTC_AddFlashAwake(uint64_t us) {
+    uint64_t total = ((uint64_t)HAL_RTCEx_BKUPRead(&hrtc, RTC_FLASH_AWAKE_HI) << 32)
+                   | HAL_RTCEx_BKUPRead(&hrtc, RTC_FLASH_AWAKE_LO);
+    total += us;
+    HAL_RTCEx_BKUPWrite(&hrtc, RTC_FLASH_AWAKE_LAST, us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    HAL_RTCEx_BKUPWrite(&hrtc, RTC_FLASH_AWAKE_LO, (uint32_t)total);
+    HAL_RTCEx_BKUPWrite(&hrtc, RTC_FLASH_AWAKE_HI, (uint32_t)(total >> 32));
+    HAL_RTCEx_BKUPWrite(&hrtc, RTC_FLASH_WAKES_DR, HAL_RTCEx_BKUPRead(&hrtc, RTC_FLASH_WAKES_DR) + 1u);
+}
+void RTC_GetFlashAwake(uint32_t *last_us, uint64_t *total_us, uint32_t *wakes) {
+    if (last_us)  *last_us  = HAL_RTCEx_BKUPRead(&hrtc, RTC_FLASH_AWAKE_LAST);
+    if (total_us) *total_us = ((uint64_t)HAL_RTCEx_BKUPRead(&hrtc, RTC_FLASH_AWAKE_HI) << 32)
+                            | HAL_RTCEx_BKUPRead(&hrtc, RTC_FLASH_AWAKE_LO);
+    if (wakes)    *wakes    = HAL_RTCEx_BKUPRead(&hrtc, RTC_FLASH_WAKES_DR);
+}
+
+/* ---- littlefs mount snapshot ---- */
+void RTC_LoadMountSnapshot(uint32_t *words, uint32_t n) {
+    if (n > RTC_MOUNT_SNAP_WORDS) n = RTC_MOUNT_SNAP_WORDS;
+    for (uint32_t i = 0; i < n; i++) words[i] = HAL_RTCEx_BKUPRead(&hrtc, RTC_MOUNT_SNAP_DR + i);
+}
+void RTC_SaveMountSnapshot(const uint32_t *words, uint32_t n) {
+    if (n > RTC_MOUNT_SNAP_WORDS) n = RTC_MOUNT_SNAP_WORDS;
+    for (uint32_t i = 0; i < n; i++) HAL_RTCEx_BKUPWrite(&hrtc, RTC_MOUNT_SNAP_DR + i, words[i]);
+}
+
+/* ---- littlefs used-block count ---- */
+uint32_t RTC_GetFsUsage(void) {
+    return HAL_RTCEx_BKUPRead(&hrtc, RTC_FS_USAGE_DR);
+}
+void RTC_SetFsUsage(uint32_t word) {
+    HAL_RTCEx_BKUPWrite(&hrtc, RTC_FS_USAGE_DR, word);
+}
+
+/* ---- Retention policy ---- */
+uint32_t RTC_GetRetention(void) {
+    return HAL_RTCEx_BKUPRead(&hrtc, RTC_RETENTION_DR);
+}
+void RTC_SetRetention(uint32_t word) {
+    HAL_RTCEx_BKUPWrite(&hrtc, RTC_RETENTION_DR, word);
+}
+
+/* ---- littlefs maintenance counters ---- */
+void RTC_LoadMaint(uint32_t *words, uint32_t n) {
+    if (n > RTC_MAINT_WORDS) n = RTC_MAINT_WORDS;
+    for (uint32_t i = 0; i < n; i++) words[i] = HAL_RTCEx_BKUPRead(&hrtc, RTC_MAINT_DR + i);
+}
+void RTC_SaveMaint(const uint32_t *words, uint32_t n) {
+    if (n > RTC_MAINT_WORDS) n = RTC_MAINT_WORDS;
+    for (uint32_t i = 0; i < n; i++) HAL_RTCEx_BKUPWrite(&hrtc, RTC_MAINT_DR + i, words[i]);
+}
+
 /* ---- Should log now? ---- */
 int RTC_ShouldLogNow(void) {
     uint32_t startE=0;
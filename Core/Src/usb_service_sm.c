@@ -1,32 +1,35 @@
-// usb_service_sm.c (unchanged core; robust blocking TX helper inside)
+// usb_service_sm.c (unchanged core; replies go through usb_tx.c)
 #include "usb_service_sm.h"
 #include "usb_device.h"
 #include "usbd_cdc_if.h"
 #include "cdc_cmd.h"
+#include "usb_tx.h"
 #include <string.h>
 
 extern USBD_HandleTypeDef hUsbDeviceFS;
 
-// Robust transmit: retry while USBD_BUSY, bounded by timeout
-static int USB_TxBlocking(const uint8_t *data, uint16_t len, uint32_t timeout_ms) {
-    uint32_t t0 = HAL_GetTick();
-    while ((HAL_GetTick() - t0) < timeout_ms) {
-        if (CDC_Transmit_FS((uint8_t*)data, len) == USBD_OK) {
-            return 0;
-        }
-        HAL_Delay(1); // give USB ISR/LL time to progress
-    }
-    return -1; // timeout
-}
-
-static void USB_Write(const char *s) {
-    if (!s) return;
-    (void)USB_TxBlocking((const uint8_t*)s, (uint16_t)strlen(s), 250);
-}
-
 static usb_sm_state_t s_state = USB_SM_IDLE;
 static volatile bool s_has_line = false;
 static char s_line[200];
+static volatile uint32_t s_line_tick;
+static usb_sm_idle_hook_t s_idle_hook;
+static bool s_idle_busy;
+static usb_sm_latency_t s_lat;
+
+static const uint16_t s_lat_edges_ms[USB_SM_LAT_BUCKETS - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+
+static void RecordLatency(uint32_t ms, bool busy)
+{
+    uint32_t i = 0;
+    while (i < USB_SM_LAT_BUCKETS - 1 && ms >= s_lat_edges_ms[i]) i++;
+    if (busy) { s_lat.busy[i]++; if (ms > s_lat.max_busy_ms) s_lat.max_busy_ms = ms; }
+    else      { s_lat.idle[i]++; if (ms > s_lat.max_idle_ms) s_lat.max_idle_ms = ms; }
+}
+
+void USB_SM_SetIdleHook(usb_sm_idle_hook_t hook) { s_idle_hook = hook; s_idle_busy = (hook != NULL); }
+bool USB_SM_IdleBusy(void) { return s_idle_busy; }
+void USB_SM_GetLatency(usb_sm_latency_t *out) { if (out) *out = s_lat; }
+void USB_SM_ResetLatency(void) { memset(&s_lat, 0, sizeof s_lat); }
 
 void USB_SM_Start(void) { s_state = USB_SM_INIT; }
 void USB_SM_Stop(void)  { s_state = USB_SM_EXIT; }
@@ -37,6 +40,7 @@ void USB_SM_PostCmdLine(const char *line)
     if (!line) return;
     size_t n = strnlen(line, sizeof s_line - 1);
     memcpy(s_line, line, n); s_line[n] = 0;
+    s_line_tick = HAL_GetTick();
     s_has_line = true;
 }
 
@@ -66,6 +70,7 @@ void USB_SM_RunStep(void)
             crs.HSI48CalibrationValue = 0x20;
             HAL_RCCEx_CRSConfig(&crs);
         }
+        USB_Tx_Reset();                 // nothing from a previous session
         USB_Write("Ready. Type HELP for commands.\r\n");
         s_state = USB_SM_READY;
         break;
@@ -73,9 +78,16 @@ void USB_SM_RunStep(void)
         s_state = USB_SM_RX_CMD;
         break;
     case USB_SM_RX_CMD:
+        USB_Tx_Kick();   // a reply the class refused to start earlier
         if (s_has_line) {
+            bool busy = s_idle_busy;
             s_has_line = false;
             CDC_HandleLine(s_line);
+            RecordLatency(HAL_GetTick() - s_line_tick, busy);
+        } else if (s_idle_hook) {
+            // one slice of background work, then back to polling for lines
+            s_idle_busy = s_idle_hook();
+            if (!s_idle_busy) s_idle_hook = NULL;
         }
         break;
     case USB_SM_EXIT:
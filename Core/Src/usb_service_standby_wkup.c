@@ -1,16 +1,26 @@
 // usb_service_standby_wkup.c (corrected)
 // - Pure binary streaming for GETLOG (no banners)
-// - ZLP at end if total bytes multiple of 64
-// - No reliance on TX-complete callbacks
+// - GETLOG double-buffered: flash reads overlap multi-packet bulk transfers
+// - Text replies go through the usb_tx.c ring (USB_Write) and are sent from
+//   TX-complete: USB_CDC_TxCplt hands completions to USB_Tx_Cplt outside a
+//   GETLOG stream, which flushes the ring before taking EP 0x81
 
 #include "main.h"
 #include "usb_device.h"
 #include "usbd_cdc_if.h"
 #include "lfs.h"
+#include "lfs_w25q64.h"
 #include "cdc_cmd.h"
+#include "usb_tx.h"
 #include "rtc_provision.h"
 #include "rtc.h"
 #include "usb_service_sm.h"
+#include "wake_batch.h"
+#include "ring_log.h"
+#include "log_query.h"
+#include "log_rotate.h"
+#include "log_frame.h"
+#include "log_codec.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -48,98 +58,579 @@ static uint8_t WaitForVBUS(uint8_t want_high, uint32_t stable_ms, uint32_t overa
     return 0;
 }
 
-// Short text writes (prompts) – blocking but lightweight
-static inline int USB_TxBlockingShort(const uint8_t *data, uint16_t len, uint32_t timeout_ms)
+void CMD_EraseLog(void)
 {
-    uint32_t t0 = HAL_GetTick();
-    while ((HAL_GetTick() - t0) < timeout_ms) {
-        USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
-        if (hcdc && hcdc->TxState == 0) {
-            USBD_CDC_SetTxBuffer(&hUsbDeviceFS, (uint8_t*)data, len);
-            if (USBD_CDC_TransmitPacket(&hUsbDeviceFS) == USBD_OK) return 0;
-        }
-        HAL_Delay(1);
+#if RINGLOG_ENABLE
+    RingLog_Erase();
+    WakeBatch_Discard();
+    USB_Write("OK ring erased\r\n");
+#else
+    LFS_W25Q64_PreEraseCancel();   // littlefs is about to write
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) {
+        LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
     }
-    return -1;
+    int rc = lfs_remove(&lfs, WAKE_BATCH_FILE);
+    (void)lfs_remove(&lfs, LOG_COMPRESS ? "wake.bin" : LOG_Z_FILE);   // left by the other format
+    (void)lfs_remove(&lfs, LOG_SEG_FILE);
+    (void)lfs_remove(&lfs, LOG_IDX_FILE);
+    (void)LogRotate_RemoveAll(&lfs);
+    LFS_W25Q64_UsageInvalidate();
+    LFS_W25Q64_Unmount(&lfs);
+    WakeBatch_Discard();   // records queued before the erase go with it
+    USB_Write(rc == 0 ? "OK wake.bin erased\r\n" : "ERR erase failed\r\n");
+#endif
 }
-static inline void USB_Write(const char *s)
-{ if (s) (void)USB_TxBlockingShort((const uint8_t*)s, (uint16_t)strlen(s), 250); }
 
-// Packet-level blocking transmit with completion wait; supports ZLP (len==0)
-static int USB_TxPacketBlocking(const uint8_t *data,
-                                uint16_t len,
-                                uint32_t start_timeout_ms,
-                                uint32_t complete_timeout_ms)
+#if !RINGLOG_ENABLE
+static bool EraseJob_Step(void) { return LFS_W25Q64_PreEraseStep() != 0; }
+
+// VBUS pays for the maintenance pass: lfs_fs_gc, then every free block that
+// is not blank erased between commands, so the logging wakes that follow on
+// battery find their blocks blank. ERASELOG stops it, ERASELOG FAST replaces it.
+static void MaintJob_Begin(void)
 {
-    static uint8_t zlp_dummy; // used when len==0
-    uint32_t t0 = HAL_GetTick();
-    // Wait for ready
-    while ((HAL_GetTick() - t0) < start_timeout_ms) {
-        USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
-        if (hcdc && hcdc->TxState == 0) {
-            const uint8_t *ptr = (len == 0 && data == NULL) ? &zlp_dummy : data;
-            USBD_CDC_SetTxBuffer(&hUsbDeviceFS, (uint8_t*)ptr, len);
-            if (USBD_CDC_TransmitPacket(&hUsbDeviceFS) == USBD_OK) {
-                // Wait until completion
-                uint32_t tw = HAL_GetTick();
-                while (hcdc->TxState != 0 && (HAL_GetTick() - tw) < complete_timeout_ms) {
-                    HAL_Delay(1);
-                }
-                if (hcdc->TxState == 0) return 0;
-                return -2;
-            }
-        }
-        HAL_Delay(1);
-    }
-    return -1;
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) return;
+    int rc = LFS_W25Q64_MaintainStart(&lfs, 0);
+    LFS_W25Q64_Unmount(&lfs);
+    if (rc == 0) USB_SM_SetIdleHook(EraseJob_Step);
 }
+#endif
 
-void CMD_EraseLog(void)
+// ERASELOG FAST: remove wake.bin, then erase every free block in the
+// background (64K/32K where possible, suspendable) between USB commands,
+// so the following log writes on battery skip their 4K erases
+void CMD_EraseLogFast(void)
 {
+#if RINGLOG_ENABLE
+    CMD_EraseLog();   // the ring only erases the sectors it used
+#else
+    LFS_W25Q64_PreEraseCancel();
     if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) {
         LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
     }
-    int rc = lfs_remove(&lfs, "wake.bin");
+    int rc = lfs_remove(&lfs, WAKE_BATCH_FILE);
+    (void)lfs_remove(&lfs, LOG_COMPRESS ? "wake.bin" : LOG_Z_FILE);   // left by the other format
+    (void)lfs_remove(&lfs, LOG_SEG_FILE);
+    (void)lfs_remove(&lfs, LOG_IDX_FILE);
+    (void)LogRotate_RemoveAll(&lfs);
+    LFS_W25Q64_UsageInvalidate();
+    if (rc == 0 || rc == LFS_ERR_NOENT) rc = LFS_W25Q64_PreEraseStart(&lfs);
     LFS_W25Q64_Unmount(&lfs);
-    USB_Write(rc == 0 ? "OK wake.bin erased\r\n" : "ERR erase failed\r\n");
+    WakeBatch_Discard();
+    if (rc == 0) {
+        USB_SM_SetIdleHook(EraseJob_Step);
+        USB_Write("OK wake.bin erased, erasing free space\r\n");
+    } else {
+        USB_Write("ERR erase failed\r\n");
+    }
+#endif
 }
 
-static void stream_file_filtered(uint32_t since, uint32_t a, uint32_t b,
-                                 bool use_since, bool use_between)
+// GETLOG stream: APP_TX_DATA_SIZE split in two halves. One half goes out
+// as a single multi-packet bulk transfer while the next is read from flash
+// into the other, so at SCK 6 MHz the dump runs at the flash read rate
+// instead of one 64-byte packet per HAL_Delay tick (bench "stream").
+// A half filled while the other is on the bus is queued and started from
+// the TX-complete interrupt, so EP 0x81 (double-buffered, usbd_conf.c)
+// gets its next packets without waiting for the main loop to wake.
+// A full half is a multiple of 64: the CDC class closes it with a ZLP.
+// FRAMED: each half is one log_frame.h frame, sealed when its payload is full.
+#define STREAM_HALF (APP_TX_DATA_SIZE / 2u)
+#if LOG_FRAME_SIZE * 2 != APP_TX_DATA_SIZE
+#error "GETLOG FRAMED sends one frame per TX half"
+#endif
+#ifndef STREAM_TIMEOUT_MS
+#define STREAM_TIMEOUT_MS 2000u   // host stopped reading: drop the rest
+#endif
+
+extern void USBD_LL_SofIrq(uint8_t on);
+
+static struct {
+    uint8_t *buf;             // CDC_TxBuffer_FS(), two STREAM_HALF halves
+    uint32_t fill;            // bytes in the half being filled
+    uint8_t  cur;             // half being filled
+    uint8_t  qhalf;           // half waiting for the one in flight
+    uint8_t  framed;
+    uint32_t seq, off;        // FRAMED: next frame, log offset of its payload
+    volatile uint8_t failed;
+    volatile uint8_t busy;    // a transfer is in flight
+    volatile uint8_t active;  // frames are counted
+    volatile uint32_t queued; // length of qhalf, 0 if none
+} tx;
+
+static volatile CDC_StreamStats stream_stats;
+
+// GETLOG COMPRESS: records go out as log_codec.h frames of up to
+// LOG_CODEC_KEY_EVERY records, the format wake.z stores, and the host
+// decodes them with the same log_codec.c (tools/getlog). The encoder reads
+// straight into rec: 256 + LOG_CODEC_FRAME_MAX bytes of static RAM.
+static struct {
+    bool on;
+    uint32_t n;
+    LogCodec_Rec rec[LOG_CODEC_KEY_EVERY];
+    uint8_t frame[LOG_CODEC_FRAME_MAX];
+} wz;
+
+static void tx_start(uint8_t half, uint32_t len)
 {
-    (void)since; (void)a; (void)b; (void)use_since; (void)use_between;
+    tx.busy = 1;   // before the start: completion may come first
+    if (CDC_Transmit_FS(tx.buf + half * STREAM_HALF, (uint16_t)len) != USBD_OK) {
+        tx.busy = 0;
+        tx.failed = 1;
+        return;
+    }
+    stream_stats.bytes += len;
+    stream_stats.transfers++;
+}
 
-    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) { USB_Write("ERR mount\r\n"); return; }
+// CDC_TransmitCplt_FS, USB interrupt: chain the queued half. Outside a
+// stream the transfer was the reply ring's.
+void USB_CDC_TxCplt(void)
+{
+    if (!tx.active) { USB_Tx_Cplt(); return; }
+    tx.busy = 0;
+    uint32_t len = tx.queued;
+    if (len && !tx.failed) {
+        tx.queued = 0;
+        tx_start(tx.qhalf, len);
+        stream_stats.chained++;
+    }
+}
+
+// HAL_PCD_SOFCallback, USB interrupt, only while the stream runs. An idle
+// frame had nothing armed on EP 0x81: the host got NAKs all through it.
+void USB_CDC_Sof(void)
+{
+    if (!tx.active) return;
+    stream_stats.frames++;
+    if (!tx.busy) stream_stats.idle++;
+}
+
+void CMD_GetStreamStats(CDC_StreamStats *out)
+{
+    __disable_irq();
+    *out = stream_stats;
+    __enable_irq();
+}
+
+// Until the half in flight is done (all: and nothing is queued behind it)
+static int tx_wait(bool all)
+{
+    uint32_t t0 = HAL_GetTick();
+    __disable_irq();
+    while ((tx.queued || (all && tx.busy)) && !tx.failed) {
+        __WFI();   // the USB interrupt or SysTick ends it
+        __enable_irq();
+        __disable_irq();
+        if ((HAL_GetTick() - t0) >= STREAM_TIMEOUT_MS || !USB_Detected()) tx.failed = 1;
+    }
+    tx.queued = 0;
+    __enable_irq();
+    return tx.failed ? -1 : 0;
+}
+
+// Start the half being filled, or queue it behind the one in flight, then
+// switch to the other half once it is free
+static void tx_send(void)
+{
+    uint32_t len = tx.fill;
+    tx.fill = tx.framed ? LOG_FRAME_HDR : 0u;
+    if (tx.failed) return;
+    __disable_irq();
+    if (tx.busy) { tx.qhalf = tx.cur; tx.queued = len; }
+    else tx_start(tx.cur, len);
+    __enable_irq();
+    tx.cur ^= 1u;
+    (void)tx_wait(false);
+}
+
+// Replies queued before the stream go out first: EP 0x81 is then ours
+static void tx_begin(bool framed, uint32_t offset)
+{
+    (void)USB_Tx_Flush(STREAM_TIMEOUT_MS);
+    tx.buf = CDC_TxBuffer_FS();
+    tx.framed = framed;
+    tx.fill = framed ? LOG_FRAME_HDR : 0u;
+    tx.seq = 0;
+    tx.off = offset;
+    tx.queued = 0;
+    tx.cur = tx.failed = 0;
+    tx.busy = 0;
+    wz.on = false;
+    wz.n = 0;
+    memset((void*)&stream_stats, 0, sizeof stream_stats);
+    tx.active = 1;
+    USBD_LL_SofIrq(1);
+}
+
+static void tx_stop(void)
+{
+    USBD_LL_SofIrq(0);
+    tx.active = 0;
+}
+
+static uint32_t tx_limit(void) { return tx.framed ? LOG_FRAME_HDR + LOG_FRAME_PAYLOAD : STREAM_HALF; }
+
+// Free space in the half being filled; tx_commit(n) once n bytes are in
+static uint8_t *tx_room(uint32_t *room)
+{
+    *room = tx_limit() - tx.fill;
+    return tx.buf + tx.cur * STREAM_HALF + tx.fill;
+}
+
+static void tx_seal(uint8_t type)
+{
+    uint32_t n = tx.fill - LOG_FRAME_HDR;
+    LogFrame_Seal(tx.buf + tx.cur * STREAM_HALF, type, tx.seq++, tx.off, n);
+    if (type == LOG_FRAME_T_DATA) tx.off += n;
+    tx.fill = LOG_FRAME_SIZE;
+}
+
+static void tx_commit(uint32_t n)
+{
+    tx.fill += n;
+    if (tx.fill < tx_limit()) return;
+    if (tx.framed) tx_seal(LOG_FRAME_T_DATA);
+    tx_send();
+}
+
+static void tx_put(const uint8_t *p, uint32_t len)
+{
+    while (len && !tx.failed) {
+        uint32_t room;
+        uint8_t *dst = tx_room(&room);
+        if (room > len) room = len;
+        memcpy(dst, p, room);
+        p += room; len -= room;
+        tx_commit(room);
+    }
+}
+
+static void wz_flush(void)
+{
+    if (!wz.n) return;
+    tx_put(wz.frame, LogCodec_EncodeFrame(wz.rec, wz.n, wz.frame));
+    wz.n = 0;
+}
+
+// Whole records out: as they are, or into the next frame
+static void out_records(const uint8_t *p, uint32_t len)
+{
+    if (!wz.on) { tx_put(p, len); return; }
+    for (; len >= LOG_REC_SIZE && !tx.failed; p += LOG_REC_SIZE, len -= LOG_REC_SIZE) {
+        memcpy(&wz.rec[wz.n++], p, LOG_REC_SIZE);
+        if (wz.n == LOG_CODEC_KEY_EVERY) wz_flush();
+    }
+}
+
+// Last partial half, then wait it out. An empty reply still needs its ZLP.
+// FRAMED: the last data frame, then 'end' with the frame count and length.
+static void tx_end(LogFrame_Trailer *end)
+{
+    wz_flush();
+    if (tx.framed && tx.fill > LOG_FRAME_HDR) tx_seal(LOG_FRAME_T_DATA);
+    if (tx.fill > (tx.framed ? LOG_FRAME_HDR : 0u)) tx_send();
+    if (tx.framed && end) {
+        uint32_t room;
+        end->frames = tx.seq;
+        end->len = tx.off - end->offset;
+        memcpy(tx_room(&room), end, sizeof *end);
+        tx.fill += sizeof *end;
+        tx_seal(LOG_FRAME_T_END);
+        tx_send();
+    }
+    if (!tx.failed && stream_stats.bytes == 0) tx_start(tx.cur, 0);
+    (void)tx_wait(true);
+    tx_stop();
+}
 
-    lfs_file_t f; uint8_t buf[512];
-    uint32_t usb_total_sent = 0;
-    if (lfs_file_open(&lfs, &f, "wake.bin", LFS_O_RDONLY) >= 0) {
-        (void)lfs_file_seek(&lfs, &f, 0, LFS_SEEK_SET);
-        lfs_ssize_t r;
-        while ((r = lfs_file_read(&lfs, &f, buf, sizeof buf)) > 0) {
-            size_t off = 0;
-            while (off < (size_t)r) {
-                size_t chunk = ((r - off) > 64) ? 64 : (r - off);
-                int rc = USB_TxPacketBlocking(buf + off, (uint16_t)chunk,
-                                              /*start*/5000, /*complete*/2000);
-                if (rc == 0) { off += chunk; usb_total_sent += chunk; }
-                else { HAL_Delay(5); }
+typedef struct {
+    uint32_t lo, hi;
+} getlog_ctx_t;
+
+#if !RINGLOG_ENABLE && !LOG_COMPRESS
+// LogQuery sink: stream records [from, to), dropping those out of range if 'check'
+static void stream_records(lfs_file_t *lf, uint32_t from, uint32_t to, bool check, void *ctx)
+{
+    getlog_ctx_t *g = (getlog_ctx_t*)ctx;
+    (void)lfs_file_seek(&lfs, lf, (lfs_soff_t)(from * LOG_REC_SIZE), LFS_SEEK_SET);
+    while (from < to && !tx.failed) {
+        // read straight into the TX half, or the encoder's input: no copy
+        uint32_t want = (to - from) * LOG_REC_SIZE, room;
+        uint8_t *buf;
+        if (wz.on) {
+            buf = (uint8_t*)&wz.rec[wz.n];
+            room = (LOG_CODEC_KEY_EVERY - wz.n) * LOG_REC_SIZE;
+        } else {
+            buf = tx_room(&room);
+        }
+        if (want > room) want = room;
+        lfs_ssize_t r = lfs_file_read(&lfs, lf, buf, want);
+        if (r <= 0) break;
+        uint32_t n = (uint32_t)r / LOG_REC_SIZE, keep = n * LOG_REC_SIZE;
+        if (check) {
+            keep = 0;
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t e; memcpy(&e, buf + i * LOG_REC_SIZE, sizeof e);
+                if (!LogQuery_Match(e, g->lo, g->hi)) continue;
+                memmove(buf + keep, buf + i * LOG_REC_SIZE, LOG_REC_SIZE);
+                keep += LOG_REC_SIZE;
             }
         }
-        lfs_file_close(&lfs, &f);
-        // If last packet was exactly 64B, send a ZLP to terminate cleanly
-        if ((usb_total_sent & 63) == 0) {
-            (void)USB_TxPacketBlocking(NULL, 0, 2000, 2000);
+        if (!wz.on) tx_commit(keep);
+        else if ((wz.n += keep / LOG_REC_SIZE) == LOG_CODEC_KEY_EVERY) wz_flush();
+        from += n;
+    }
+}
+#endif
+
+#if LOG_COMPRESS
+// LogCodec sink: keep the records in range
+static void decoded_record(const LogCodec_Rec *rec, void *ctx)
+{
+    getlog_ctx_t *g = (getlog_ctx_t*)ctx;
+    if (!LogQuery_Match(rec->epoch, g->lo, g->hi)) return;
+    out_records((const uint8_t*)rec, sizeof *rec);
+}
+
+// One file of frames; a frame cut short at its end is dropped with it
+static void stream_frames(lfs_file_t *zf, getlog_ctx_t *g)
+{
+    static uint8_t in[256];
+    static LogCodec_Decoder dec;
+    lfs_ssize_t r;
+    LogCodec_DecoderInit(&dec);
+    while (!tx.failed && (r = lfs_file_read(&lfs, zf, in, sizeof in)) > 0)
+        LogCodec_Decode(&dec, in, (uint32_t)r, decoded_record, g);
+}
+#endif
+
+#if !RINGLOG_ENABLE
+// Manifest visitor: stream an archived segment if its epoch range meets the query
+static void stream_segment(const LogRotate_Segment *seg, void *ctx)
+{
+    getlog_ctx_t *g = (getlog_ctx_t*)ctx;
+    char name[LOG_ARCHIVE_NAME_MAX];
+    lfs_file_t af;
+    if (seg->max < g->lo || seg->min > g->hi) return;
+    LogRotate_Name(name, seg->name);
+    if (lfs_file_open(&lfs, &af, name, LFS_O_RDONLY) < 0) return;   // reset mid-rotation
+#if LOG_COMPRESS
+    stream_frames(&af, g);
+#else
+    // a segment the query covers whole goes out unchecked; at the edges of
+    // the range a sorted one is binary searched, any other filtered
+    lfs_soff_t sz = lfs_file_size(&lfs, &af);
+    bool edge = seg->min < g->lo || seg->max > g->hi;
+    if (edge && (seg->flags & LOG_MAN_SORTED)) (void)LogQuery_Sorted(&lfs, &af, g->lo, g->hi, stream_records, g, NULL);
+    else if (sz > 0) stream_records(&af, 0, (uint32_t)sz / LOG_REC_SIZE, edge, g);
+#endif
+    lfs_file_close(&lfs, &af);
+}
+#endif
+
+static void stream_file_filtered(uint32_t lo, uint32_t hi, bool compress)
+{
+    getlog_ctx_t g = { lo, hi };
+
+#if RINGLOG_ENABLE
+    // The ring has no per-record index: filter each page as it is read
+    static uint8_t page[RINGLOG_PAGE_SIZE];
+    RingLog_Cursor c;
+    int n;
+    RingLog_ReadBegin(&c);
+    tx_begin(false, 0);
+    wz.on = compress;
+    while (!tx.failed && (n = RingLog_Read(&c, page)) > 0) {
+        uint32_t keep = 0;
+        for (uint32_t i = 0; i + LOG_REC_SIZE <= (uint32_t)n; i += LOG_REC_SIZE) {
+            uint32_t e; memcpy(&e, page + i, sizeof e);
+            if (!LogQuery_Match(e, g.lo, g.hi)) continue;
+            memmove(page + keep, page + i, LOG_REC_SIZE);
+            keep += LOG_REC_SIZE;
         }
+        out_records(page, keep);
+    }
+    tx_end(NULL);
+#elif LOG_COMPRESS
+    // Frames are decoded here: the host still receives 8-byte records
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) { USB_Write("ERR mount\r\n"); return; }
+
+    tx_begin(false, 0);
+    wz.on = compress;
+    int archived = LogRotate_Segments(&lfs, stream_segment, &g);   // oldest first
+    lfs_file_t f;
+    int rc = lfs_file_open(&lfs, &f, LOG_Z_FILE, LFS_O_RDONLY);
+    if (rc >= 0) {
+        stream_frames(&f, &g);
+        lfs_file_close(&lfs, &f);
+    }
+    if (rc >= 0 || archived) {
+        tx_end(NULL);
     } else {
+        tx_stop();
+        USB_Write("ERR open wake.z\r\n");
+    }
+    LFS_W25Q64_Unmount(&lfs);
+#else
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) { USB_Write("ERR mount\r\n"); return; }
+
+    // Half-sized reads gain nothing from the window and a 1 KiB fetch every
+    // other half stalls the overlap
+    LFS_W25Q64_SetReadAhead(0);
+    tx_begin(false, 0);
+    wz.on = compress;
+    int archived = LogRotate_Segments(&lfs, stream_segment, &g);   // oldest first
+    lfs_file_t f;
+    int rc = lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_RDONLY);
+    if (rc >= 0) {
+        (void)LogQuery_Ranges(&lfs, &f, g.lo, g.hi, stream_records, &g, NULL);
+        lfs_file_close(&lfs, &f);
+    }
+    LFS_W25Q64_SetReadAhead(LFS_W25Q64_READAHEAD);
+    if (rc >= 0 || archived) {   // right after a rotation only segments exist
+        tx_end(NULL);
+    } else {
+        tx_stop();
         USB_Write("ERR open wake.bin\r\n");
     }
     LFS_W25Q64_Unmount(&lfs);
+#endif
+}
+
+// GETLOG OFFSET=<n> LEN=<m> [FRAMED]: bytes [n, n + m) of the whole log
+// (m 0: to the end), whole records only. FRAMED wraps them in log_frame.h
+// frames and closes with an END frame, error or not.
+void CMD_GetLog_Window(uint32_t offset, uint32_t len, bool framed)
+{
+#if RINGLOG_ENABLE || LOG_COMPRESS
+    (void)offset; (void)len; (void)framed;
+    USB_Write("ERR OFFSET needs the wake.bin log\r\n");
+#else
+    if ((offset | len) % LOG_REC_SIZE) { USB_Write("ERR OFFSET/LEN not whole records\r\n"); return; }
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) { USB_Write("ERR mount\r\n"); return; }
+    getlog_ctx_t g = { 0u, UINT32_MAX };
+    uint32_t base = 0;
+    LFS_W25Q64_SetReadAhead(0);   // as in stream_file_filtered
+    tx_begin(framed, offset);
+    int total = LogRotate_Window(&lfs, offset / LOG_REC_SIZE, len / LOG_REC_SIZE, stream_records, &g, &base);
+    LFS_W25Q64_SetReadAhead(LFS_W25Q64_READAHEAD);
+    if (framed) {
+        LogFrame_Trailer end = {
+            .total = (total > 0) ? (uint32_t)total : 0u,
+            .base = base,
+            .offset = offset,
+            .status = (total < 0) ? total : 0,
+        };
+        tx_end(&end);
+    } else if (total < 0 && tx.fill == 0 && stream_stats.bytes == 0) {
+        tx_stop();
+        USB_Write("ERR read log\r\n");
+    } else {
+        tx_end(NULL);
+    }
+    LFS_W25Q64_Unmount(&lfs);
+#endif
 }
 
-void CMD_GetLog_All(void)      { stream_file_filtered(0,0,0,false,false); }
-void CMD_GetLog_Since(uint32_t s){ stream_file_filtered(s,0,0,true,false); }
-void CMD_GetLog_Between(uint32_t a, uint32_t b){ stream_file_filtered(0,a,b,false,true); }
+// SETTIME: records written from now on start a new monotone segment
+void CMD_LogTimeChanged(void)
+{
+#if !RINGLOG_ENABLE
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) return;
+    (void)WakeBatch_Flush(&lfs);   // queued records belong to the old clock
+#if !LOG_COMPRESS
+    (void)LogQuery_MarkSegment(&lfs);
+#endif
+    LFS_W25Q64_Unmount(&lfs);
+#endif
+}
+
+// GETLOG INDEX: bring wake.idx up to date (rebuilding it if it does not
+// match wake.bin), then list it as text, one "<rec> <min> <max>" per block
+void CMD_GetLog_Index(void)
+{
+#if RINGLOG_ENABLE
+    USB_Write("ERR no index in ring mode\r\n");
+#elif LOG_COMPRESS
+    USB_Write("ERR no index for wake.z\r\n");
+#else
+    static char line[80];
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) { USB_Write("ERR mount\r\n"); return; }
+    bool rebuilt = false;
+    int n = LogQuery_IndexUpdate(&lfs, true, &rebuilt);
+    struct lfs_info info;
+    uint32_t total = (lfs_stat(&lfs, LOG_FILE, &info) == 0) ? info.size / LOG_REC_SIZE : 0u;
+    if (n < 0) {
+        snprintf(line, sizeof line, "ERR index %d\r\n", n);
+        USB_Write(line);
+        LFS_W25Q64_Unmount(&lfs);
+        return;
+    }
+    snprintf(line, sizeof line, "INDEX every=%lu entries=%d records=%lu tail=%lu rebuilt=%d\r\n",
+             (unsigned long)LOG_IDX_RECORDS, n, (unsigned long)total,
+             (unsigned long)(total - (uint32_t)n * LOG_IDX_RECORDS), rebuilt ? 1 : 0);
+    USB_Write(line);
+    lfs_file_t xf;
+    if (lfs_file_open(&lfs, &xf, LOG_IDX_FILE, LFS_O_RDONLY) >= 0) {
+        LogQuery_IndexEntry e;
+        while (lfs_file_read(&lfs, &xf, &e, sizeof e) == (lfs_ssize_t)sizeof e) {
+            int len = snprintf(line, sizeof line, "%lu %lu %lu\r\n",
+                               (unsigned long)e.rec, (unsigned long)e.min, (unsigned long)e.max);
+            (void)USB_Tx_Write(line, (uint32_t)len);
+        }
+        lfs_file_close(&lfs, &xf);
+    }
+    LFS_W25Q64_Unmount(&lfs);
+    USB_Write("END\r\n");
+#endif
+}
+
+#if !RINGLOG_ENABLE
+static void segment_span(const LogRotate_Segment *seg, void *ctx)
+{
+    LogRotate_Segment *s = (LogRotate_Segment*)ctx;
+    if (seg->min < s->min) s->min = seg->min;
+    if (seg->max > s->max) s->max = seg->max;
+    s->records += seg->records;
+}
+#endif
+
+// RETENTION [STOP|WRAP]: set the full-volume policy, or report it with
+// the epoch span and record count of the archived segments
+void CMD_Retention(const char *arg)
+{
+#if RINGLOG_ENABLE
+    if (arg && strcasecmp(arg, "STOP") == 0) { USB_Write("ERR ring always wraps\r\n"); return; }
+    USB_Write("RETENTION wrap ring\r\n");
+#else
+    static char line[128];
+    if (arg && *arg) {
+        if (strcasecmp(arg, "STOP") == 0) LogRotate_SetPolicy(LOG_RETAIN_STOP);
+        else if (strcasecmp(arg, "WRAP") == 0) LogRotate_SetPolicy(LOG_RETAIN_WRAP);
+        else { USB_Write("ERR STOP or WRAP\r\n"); return; }
+        USB_Write(LogRotate_GetPolicy() == LOG_RETAIN_WRAP ? "OK RETENTION wrap\r\n" : "OK RETENTION stop\r\n");
+        return;
+    }
+    LogRotate_Segment span = { 0, UINT32_MAX, 0, 0, 0 };
+    int n = 0;
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) == 0) {
+        n = LogRotate_Segments(&lfs, segment_span, &span);
+        LFS_W25Q64_Unmount(&lfs);
+    }
+    if (n <= 0) span.min = span.max = 0;
+    snprintf(line, sizeof line, "RETENTION %s segments=%d min=%lu max=%lu records=%lu kib=%lu secs=%lu\r\n",
+             LogRotate_GetPolicy() == LOG_RETAIN_WRAP ? "wrap" : "stop", n,
+             (unsigned long)span.min, (unsigned long)span.max, (unsigned long)span.records,
+             (unsigned long)(LogRotate_SegmentBytes() / 1024u), (unsigned long)LOG_SEGMENT_SECONDS);
+    USB_Write(line);
+#endif
+}
+
+void CMD_GetLog_All(void)      { stream_file_filtered(0, UINT32_MAX, false); }
+void CMD_GetLog_Since(uint32_t s){ stream_file_filtered(s, UINT32_MAX, false); }
+void CMD_GetLog_Between(uint32_t a, uint32_t b){ stream_file_filtered(a, b, false); }
+void CMD_GetLog_Compress(uint32_t lo, uint32_t hi){ stream_file_filtered(lo, hi, true); }
 
 int CDC_BuildTimeStatus(char *buf, int buflen)
 {
@@ -153,7 +644,7 @@ int CDC_BuildTimeStatus(char *buf, int buflen)
     uint32_t ivl = RTC_GetLoggingInterval();
     uint32_t fs_used = 0, fs_total = 0, fs_full = 0;
     if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) == 0) {
-        lfs_ssize_t u = lfs_fs_size(&lfs);
+        lfs_ssize_t u = LFS_W25Q64_UsedBlocks(&lfs);
         fs_total = lfs_cfg.block_count;
         fs_used = (u > 0) ? (uint32_t)u : 0;
         fs_full = (fs_total && fs_used >= fs_total - 2) ? 1 : 0; // 2-block reserve
@@ -161,13 +652,14 @@ int CDC_BuildTimeStatus(char *buf, int buflen)
     }
     return snprintf(buf, buflen,
         "time=%04d-%02d-%02d %02d:%02d:%02d provisioned=%d "
-        "start=%s(%lu) end=%s(%lu) interval=%lu fs_used=%lu fs_total=%lu full=%u\r\n",
+        "start=%s(%lu) end=%s(%lu) interval=%lu fs_used=%lu fs_total=%lu full=%u erase=%u%%\r\n",
         2000 + d.Year, d.Month, d.Date, t.Hours, t.Minutes, t.Seconds,
         RTC_IsProvisioned(),
         hasStart ? "set" : "none", hasStart ? (unsigned long)startE : 0ul,
         hasEnd ? "set" : "none", hasEnd ? (unsigned long)endE : 0ul,
         (unsigned long)ivl,
-        (unsigned long)fs_used, (unsigned long)fs_total, (unsigned)fs_full);
+        (unsigned long)fs_used, (unsigned long)fs_total, (unsigned)fs_full,
+        (unsigned)LFS_W25Q64_PreEraseProgress());
 }
 
 void Standby_ArmUSBWake_AndEnter(void)
@@ -194,7 +686,7 @@ void Standby_ArmUSBWake_AndEnter(void)
     __HAL_PWR_CLEAR_FLAG(PWR_FLAG_WU);
     __HAL_PWR_CLEAR_FLAG(PWR_FLAG_SB);
     HAL_PWR_EnableWakeUpPin(USB_WKUP_PIN_POLARITY);
-    HAL_PWREx_DisableSRAM2ContentRetention();
+    WakeBatch_ArmRetention();
     HAL_PWR_EnterSTANDBYMode();
 }
 
@@ -204,6 +696,9 @@ void USB_Service_UploadWakeLog(void)
 {
     if (!WaitForVBUS(1, 20, 1000)) return;
 
+    // GETLOG must see the records still batched in SRAM2
+    (void)WakeBatch_Sync();
+
     // Bring up USB state machine
     USB_SM_Start();
     const uint32_t ENUM_MAX_MS = 60000;
@@ -218,11 +713,17 @@ void USB_Service_UploadWakeLog(void)
         USBD_DeInit(&hUsbDeviceFS);
         return;
     }
+#if !RINGLOG_ENABLE
+    MaintJob_Begin();
+#endif
     while (USB_SM_IsActive() && (hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED) && USB_Detected()) {
         USB_SM_RunStep();
         HAL_Delay(1);
     }
+    LFS_W25Q64_PreEraseCancel();   // let an in-flight erase finish before DPD
+    USB_SM_SetIdleHook(NULL);
     USB_SM_Stop();
+    (void)USB_Tx_Flush(USB_TX_TIMEOUT_MS);   // "OK bye" is still in the ring
     USBD_Stop(&hUsbDeviceFS);
     USBD_DeInit(&hUsbDeviceFS);
 }
@@ -239,7 +740,6 @@ void StandbyUSB_BootPath(void)
             W25Q64_ReleaseFromDeepPowerDown();
             USB_Service_UploadWakeLog();
             W25Q64_EnterDeepPowerDown();
-            HAL_Delay(5);
             (void)WaitForVBUS(0, /*stable_ms=*/300, /*overall_timeout_ms=*/5000);
             Standby_ArmUSBWake_AndEnter();
         }
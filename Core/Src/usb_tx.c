@@ -0,0 +1,124 @@
+// usb_tx.c - command replies through an SPSC ring, sent from the USB interrupt
+#include "usb_tx.h"
+#include "main.h"
+#include "usb_device.h"
+#include "usbd_cdc_if.h"
+#include <string.h>
+
+#if (USB_TX_RING_SIZE & (USB_TX_RING_SIZE - 1u)) != 0
+#error "USB_TX_RING_SIZE must be a power of two"
+#endif
+#define RING_MASK (USB_TX_RING_SIZE - 1u)
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+static uint8_t ring[USB_TX_RING_SIZE];
+static volatile uint32_t head;       // free-running: next byte written
+static volatile uint32_t tail;       // free-running: next byte to send
+static volatile uint32_t inflight;   // bytes of the transfer on the bus, 0 if none
+static USB_TxStats stats;            // depth filled in by USB_Tx_GetStats
+
+// Interrupt, or main loop with interrupts masked: send the next
+// contiguous run. A refused start (the class still busy) is retried by
+// the next write, wait or kick.
+static bool start(void)
+{
+    uint32_t n = head - tail;
+    if (inflight || !n) return false;
+    uint32_t at = tail & RING_MASK;
+    if (n > USB_TX_RING_SIZE - at) n = USB_TX_RING_SIZE - at;
+    if (n > USB_TX_CHUNK_MAX) n = USB_TX_CHUNK_MAX;
+    inflight = n;
+    if (CDC_Transmit_FS(ring + at, (uint16_t)n) != USBD_OK) { inflight = 0; return false; }
+    stats.transfers++;
+    return true;
+}
+
+void USB_Tx_Cplt(void)
+{
+    uint32_t n = inflight;
+    if (!n) return;
+    tail += n;
+    stats.sent += n;
+    inflight = 0;
+    if (start()) stats.chained++;
+}
+
+void USB_Tx_Kick(void)
+{
+    __disable_irq();
+    (void)start();
+    __enable_irq();
+}
+
+static bool link_up(void) { return hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED; }
+
+// Sleep until there is room (all: until the ring is empty); the USB
+// interrupt or SysTick ends each WFI
+static bool wait_ring(bool all, uint32_t t0, uint32_t timeout_ms)
+{
+    bool ok = true;
+    __disable_irq();
+    while (all ? head != tail : head - tail == USB_TX_RING_SIZE) {
+        if ((HAL_GetTick() - t0) >= timeout_ms || !link_up()) { ok = false; break; }
+        (void)start();
+        __WFI();
+        __enable_irq();
+        __disable_irq();
+    }
+    __enable_irq();
+    return ok;
+}
+
+uint32_t USB_Tx_Write(const void *data, uint32_t len)
+{
+    const uint8_t *p = (const uint8_t*)data;
+    uint32_t done = 0, t0 = HAL_GetTick();
+    bool waited = false;
+    while (done < len) {
+        uint32_t room = USB_TX_RING_SIZE - (head - tail);
+        if (!room) {
+            if (!waited) { stats.waits++; waited = true; }
+            if (!wait_ring(false, t0, USB_TX_TIMEOUT_MS)) break;
+            continue;
+        }
+        uint32_t at = head & RING_MASK, n = len - done;
+        if (n > room) n = room;
+        if (n > USB_TX_RING_SIZE - at) n = USB_TX_RING_SIZE - at;
+        memcpy(ring + at, p + done, n);
+        __DMB();   // the bytes before the index that publishes them
+        head += n;
+        done += n;
+        if (head - tail > stats.high_water) stats.high_water = head - tail;
+        USB_Tx_Kick();
+    }
+    stats.queued += done;
+    stats.dropped += len - done;
+    return done;
+}
+
+void USB_Write(const char *s)
+{
+    if (s) (void)USB_Tx_Write(s, (uint32_t)strlen(s));
+}
+
+int USB_Tx_Flush(uint32_t timeout_ms)
+{
+    return wait_ring(true, HAL_GetTick(), timeout_ms) ? 0 : -1;
+}
+
+void USB_Tx_Reset(void)
+{
+    __disable_irq();
+    head = tail = inflight = 0;
+    memset(&stats, 0, sizeof stats);
+    __enable_irq();
+}
+
+void USB_Tx_GetStats(USB_TxStats *out)
+{
+    __disable_irq();
+    *out = stats;
+    out->depth = head - tail;
+    __enable_irq();
+}
@@ -8,81 +8,541 @@
 #define CMD_RDSR 0x05
 #define CMD_PP   0x02
 #define CMD_READ 0x03
+#define CMD_FAST_READ 0x0B
+#define CMD_READ_DUAL 0x3B
+#define CMD_READ_QUAD 0x6B
+#define CMD_RDSR2 0x35
+#define CMD_WRSR2 0x31
 #define CMD_SECTOR_ERASE 0x20
+#define CMD_BLOCK_ERASE_32K 0x52
+#define CMD_BLOCK_ERASE_64K 0xD8
+#define CMD_CHIP_ERASE 0xC7
+#define CMD_SUSPEND 0x75
+#define CMD_RESUME 0x7A
 #define CMD_DP   0xB9
 #define CMD_RELEASE 0xAB
 #define CMD_RDID 0x9F
+#define CMD_RDSFDP 0x5A
+
+#define SR1_WIP  0x01
+#define SR2_QE   0x02
+#define SR2_SUS  0x80
+
+// tSUS: WIP drops within 20 us of a suspend
+#define W25Q64_TSUS_US  20u
+
+// tRES1: CS high after 0xAB until the part accepts commands; tDP: CS high
+// after 0xB9 until the part is in deep power-down
+#define W25Q64_TRES_US  3u
+#define W25Q64_TDP_US   3u
+
+// Keep the array erasing at least this long between a resume and the next
+// suspend, otherwise back-to-back reads can starve the erase
+#ifndef W25Q64_RESUME_MIN_US
+#define W25Q64_RESUME_MIN_US  2000u
+#endif
+
+// Data phases shorter than this stay polled: DMA setup costs more than it saves
+#ifndef W25Q64_DMA_MIN_LEN
+#define W25Q64_DMA_MIN_LEN  16u
+#endif
+
+// Opcode, dummy bytes and data lines for each W25Q64_ReadMode
+static const struct {
+    uint8_t opcode;
+    uint8_t dummy;
+    uint8_t lanes;
+} read_modes[W25Q64_READ_MODE_COUNT] = {
+    [W25Q64_READ_NORMAL]   = { CMD_READ,      0, 1 },
+    [W25Q64_READ_FAST]     = { CMD_FAST_READ, 1, 1 },
+    [W25Q64_READ_DUAL_OUT] = { CMD_READ_DUAL, 1, 2 },
+    [W25Q64_READ_QUAD_OUT] = { CMD_READ_QUAD, 1, 4 },
+};
+
+// Sleep a little under the typical time, poll every ~5-10% of it after that,
+// and give up a margin past the datasheet maximum
+static const W25Q64_BusyPolicy busy_defaults[W25Q64_OP_COUNT] = {
+    [W25Q64_OP_PAGE_PROGRAM] = {    300u,   100u,    5000u },
+    [W25Q64_OP_ERASE_4K]     = {  40000u,  2000u,  500000u },
+    [W25Q64_OP_ERASE_32K]    = { 110000u,  5000u, 2000000u },
+    [W25Q64_OP_ERASE_64K]    = { 140000u,  5000u, 2500000u },
+    [W25Q64_OP_WRITE_SR]     = {   8000u,  1000u,   20000u },
+    // 8 s covers the smallest part (W25Q32 tCE 10 s); the timeout covers W25Q128 max
+    [W25Q64_OP_ERASE_CHIP]   = { 8000000u, 250000u, 220000000u },
+    [W25Q64_OP_SUSPEND]      = { W25Q64_TSUS_US, 5u, 5u * W25Q64_TSUS_US },
+};
+
+// Assumed until W25Q64_Probe identifies the part
+static const W25Q64_Geometry geom_default = {
+    .jedec        = { 0xEF, 0x40, 0x17 },
+    .capacity     = 8u * 1024u * 1024u,
+    .page_size    = 256u,
+    .erase_size   = { 4096u, 32768u, 65536u, 0u },
+    .erase_opcode = { CMD_SECTOR_ERASE, CMD_BLOCK_ERASE_32K, CMD_BLOCK_ERASE_64K, 0x00 },
+    .read_modes   = (1u << W25Q64_READ_MODE_COUNT) - 1u,
+};
 
 static struct {
     SPI_HandleTypeDef *hspi;
     GPIO_TypeDef *cs_gpio;
     uint16_t cs_pin;
-} w25_ctx = {0};
+    W25Q64_MultiRxFn multi_rx;
+    W25Q64_ReadMode read_mode;
+    uint8_t use_dma;
+    W25Q64_XferStats xfer;
+    W25Q64_Platform plat;
+    W25Q64_BusyPolicy busy_policy[W25Q64_OP_COUNT];
+    W25Q64_BusyStats busy_stats[W25Q64_OP_COUNT];
+    W25Q64_Geometry geom;
+    // background erase (W25Q64_EraseStart)
+    W25Q64_BusyOp async_op;          // W25Q64_OP_COUNT when idle
+    uint32_t async_addr, async_size, async_t0, resume_t0;
+    uint8_t suspended, suspend_enabled;
+    W25Q64_SuspendStats susp;
+    // deep power-down tracking
+    W25Q64_PowerState power;
+    uint32_t awake_t0;
+    W25Q64_PowerStats pwr;
+} w25_ctx = { .read_mode = W25Q64_READ_MODE_DEFAULT, .geom = geom_default,
+              .async_op = W25Q64_OP_COUNT, .suspend_enabled = 1 };
+
+static volatile uint8_t dma_done, dma_err;
 
 static inline void CS_L(void){ HAL_GPIO_WritePin(w25_ctx.cs_gpio, w25_ctx.cs_pin, GPIO_PIN_RESET); }
 static inline void CS_H(void){ HAL_GPIO_WritePin(w25_ctx.cs_gpio, w25_ctx.cs_pin, GPIO_PIN_SET); }
 
 void W25Q64_Bind(SPI_HandleTypeDef *hspi, GPIO_TypeDef *cs_gpio, uint16_t cs_pin){
     w25_ctx.hspi = hspi; w25_ctx.cs_gpio = cs_gpio; w25_ctx.cs_pin = cs_pin;
+    memcpy(w25_ctx.busy_policy, busy_defaults, sizeof busy_defaults);
+    w25_ctx.power = W25Q64_POWER_UNKNOWN;
     CS_H();
+    if (read_modes[w25_ctx.read_mode].lanes > 1 && !w25_ctx.multi_rx)
+        w25_ctx.read_mode = W25Q64_READ_FAST;
+}
+
+void W25Q64_BindMultiIO(W25Q64_MultiRxFn rx){
+    w25_ctx.multi_rx = rx;
+    if (!rx && read_modes[w25_ctx.read_mode].lanes > 1)
+        w25_ctx.read_mode = W25Q64_READ_FAST;
+}
+
+void W25Q64_EnableDMA(uint8_t enable){
+    w25_ctx.use_dma = (enable && w25_ctx.hspi && w25_ctx.hspi->hdmarx && w25_ctx.hspi->hdmatx) ? 1 : 0;
+}
+
+void W25Q64_GetXferStats(W25Q64_XferStats *out){ if (out) *out = w25_ctx.xfer; }
+void W25Q64_ResetXferStats(void){ memset(&w25_ctx.xfer, 0, sizeof w25_ctx.xfer); }
+
+// SPI1 is owned by the flash driver, so its HAL completion callbacks live here
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi){ if (hspi == w25_ctx.hspi) dma_done = 1; }
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi){ if (hspi == w25_ctx.hspi) dma_done = 1; }
+void HAL_SPI_ErrorCallback (SPI_HandleTypeDef *hspi){ if (hspi == w25_ctx.hspi) { dma_err = 1; dma_done = 1; } }
+
+// Sleep until the DMA completion callback fires. WFI with PRIMASK set still
+// wakes on the pending IRQ, so the flag check cannot race the interrupt.
+static int WaitDMA(void){
+    __disable_irq();
+    while (!dma_done) { __WFI(); __enable_irq(); __disable_irq(); }
+    __enable_irq();
+    return dma_err ? -1 : 0;
+}
+
+// Returns 0 when the data went out over DMA, -1 if DMA was not used (nothing
+// clocked, caller goes polled) and -2 if the transfer failed part-way.
+static int SPI_TxData_DMA(const uint8_t *buf, size_t len){
+    if (!w25_ctx.use_dma || len < W25Q64_DMA_MIN_LEN || len > 0xFFFFu) return -1;
+    dma_done = 0; dma_err = 0;
+    if (HAL_SPI_Transmit_DMA(w25_ctx.hspi, (uint8_t*)buf, (uint16_t)len) != HAL_OK) return -1;
+    if (WaitDMA() != 0) { HAL_SPI_Abort(w25_ctx.hspi); w25_ctx.xfer.dma_errors++; return -2; }
+    w25_ctx.xfer.dma_xfers++; w25_ctx.xfer.dma_bytes += len;
+    return 0;
+}
+
+static int SPI_RxData_DMA(uint8_t *buf, size_t len){
+    if (!w25_ctx.use_dma || len < W25Q64_DMA_MIN_LEN || len > 0xFFFFu) return -1;
+    dma_done = 0; dma_err = 0;
+    if (HAL_SPI_Receive_DMA(w25_ctx.hspi, buf, (uint16_t)len) != HAL_OK) return -1;
+    if (WaitDMA() != 0) { HAL_SPI_Abort(w25_ctx.hspi); w25_ctx.xfer.dma_errors++; return -2; }
+    w25_ctx.xfer.dma_xfers++; w25_ctx.xfer.dma_bytes += len;
+    return 0;
+}
+
+void W25Q64_BindPlatform(const W25Q64_Platform *platform){
+    if (platform) w25_ctx.plat = *platform;
+    else memset(&w25_ctx.plat, 0, sizeof w25_ctx.plat);
+}
+
+void W25Q64_SetBusyPolicy(W25Q64_BusyOp op, const W25Q64_BusyPolicy *policy){
+    if ((unsigned)op >= W25Q64_OP_COUNT) return;
+    w25_ctx.busy_policy[op] = policy ? *policy : busy_defaults[op];
+}
+
+void W25Q64_GetBusyStats(W25Q64_BusyOp op, W25Q64_BusyStats *out){
+    if ((unsigned)op < W25Q64_OP_COUNT && out) *out = w25_ctx.busy_stats[op];
+}
+
+void W25Q64_ResetBusyStats(void){ memset(w25_ctx.busy_stats, 0, sizeof w25_ctx.busy_stats); }
+
+static uint32_t NowUs(void){
+    return w25_ctx.plat.now_us ? w25_ctx.plat.now_us() : HAL_GetTick() * 1000u;
+}
+
+static uint8_t ReadSR1(void){
+    uint8_t cmd = CMD_RDSR, sr = 0;
+    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY);
+    HAL_SPI_Receive (w25_ctx.hspi, &sr, 1, HAL_MAX_DELAY); CS_H();
+    return sr;
+}
+
+static void CountWait(W25Q64_BusyOp op, uint32_t elapsed){
+    W25Q64_BusyStats *st = &w25_ctx.busy_stats[op];
+    st->ops++;
+    st->waited_us += elapsed;
+    if (elapsed > st->max_wait_us) st->max_wait_us = elapsed;
+}
+
+// Poll WIP at the policy cadence until it clears; t0 is when the op started.
+// -1 if the policy timeout ran out first
+static int PollBusy(W25Q64_BusyOp op, uint32_t t0){
+    const W25Q64_BusyPolicy *p = &w25_ctx.busy_policy[op];
+    W25Q64_BusyStats *st = &w25_ctx.busy_stats[op];
+    uint32_t elapsed;
+    int rc = 0;
+    for (;;) {
+        st->polls++;
+        uint8_t sr = ReadSR1();
+        elapsed = NowUs() - t0;
+        if (!(sr & SR1_WIP)) break;
+        if (p->timeout_us && elapsed >= p->timeout_us) { st->timeouts++; rc = -1; break; }
+        if (w25_ctx.plat.sleep_us && p->poll_us) w25_ctx.plat.sleep_us(p->poll_us);
+    }
+    CountWait(op, elapsed);
+    return rc;
+}
+
+// Sleep for the bulk of the operation, then poll WIP at the policy cadence
+static int WaitBusy(W25Q64_BusyOp op){
+    const W25Q64_BusyPolicy *p = &w25_ctx.busy_policy[op];
+    uint32_t t0 = NowUs();
+    if (w25_ctx.plat.sleep_us && p->sleep_first_us) w25_ctx.plat.sleep_us(p->sleep_first_us);
+    return PollBusy(op, t0);
+}
+
+static uint8_t ReadSR2(void){
+    uint8_t cmd = CMD_RDSR2, sr2 = 0;
+    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY);
+    HAL_SPI_Receive (w25_ctx.hspi, &sr2, 1, HAL_MAX_DELAY); CS_H();
+    return sr2;
+}
+
+// QE is non-volatile: only written the first time Quad mode is selected
+static int FinishAsync(void);
+
+static void EnableQuad(void){
+    FinishAsync();
+    uint8_t sr2 = ReadSR2();
+    if (sr2 & SR2_QE) return;
+    W25Q64_WriteEnable();
+    uint8_t cmd[2] = { CMD_WRSR2, (uint8_t)(sr2 | SR2_QE) };
+    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, cmd, 2, HAL_MAX_DELAY); CS_H();
+    WaitBusy(W25Q64_OP_WRITE_SR);
+}
+
+int W25Q64_SetReadMode(W25Q64_ReadMode mode){
+    if ((unsigned)mode >= W25Q64_READ_MODE_COUNT) return -1;
+    if (read_modes[mode].lanes > 1 && !w25_ctx.multi_rx) return -1;
+    if (!(w25_ctx.geom.read_modes & (1u << mode))) return -1;
+    if (mode == W25Q64_READ_QUAD_OUT) EnableQuad();
+    w25_ctx.read_mode = mode;
+    return 0;
+}
+
+W25Q64_ReadMode W25Q64_GetReadMode(void){ return w25_ctx.read_mode; }
+
+// ---- Background erase with suspend/resume ----
+static void ResumeAsync(void){
+    uint8_t cmd = CMD_RESUME;
+    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY); CS_H();
+    w25_ctx.suspended = 0;
+    w25_ctx.resume_t0 = NowUs();
+}
+
+// Block until the background erase has finished (resuming it if needed);
+// -1 if it outlived its policy timeout
+static int FinishAsync(void){
+    if (w25_ctx.async_op == W25Q64_OP_COUNT) return 0;
+    if (w25_ctx.suspended) ResumeAsync();
+    int rc = PollBusy(w25_ctx.async_op, w25_ctx.async_t0);
+    w25_ctx.async_op = W25Q64_OP_COUNT;
+    return rc;
+}
+
+static int SuspendAsync(void){
+    if (w25_ctx.suspended) return 0;
+    uint32_t since = NowUs() - w25_ctx.resume_t0;
+    if (since < W25Q64_RESUME_MIN_US) {
+        w25_ctx.susp.deferred++;
+        if (w25_ctx.plat.sleep_us) w25_ctx.plat.sleep_us(W25Q64_RESUME_MIN_US - since);
+        else while ((NowUs() - w25_ctx.resume_t0) < W25Q64_RESUME_MIN_US) { }
+    }
+    uint32_t t0 = NowUs();
+    uint8_t cmd = CMD_SUSPEND;
+    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY); CS_H();
+    if (WaitBusy(W25Q64_OP_SUSPEND) != 0) {
+        // 0x75 ignored, or the bus is gone: the array may still be erasing,
+        // so no read. A resume undoes a suspend that lands late.
+        ResumeAsync();
+        return -1;
+    }
+    if (ReadSR2() & SR2_SUS) {
+        uint32_t us = NowUs() - t0;
+        w25_ctx.suspended = 1;
+        w25_ctx.susp.suspends++;
+        if (us > w25_ctx.susp.max_suspend_us) w25_ctx.susp.max_suspend_us = us;
+    } else {
+        // the erase completed before the suspend landed
+        CountWait(w25_ctx.async_op, NowUs() - w25_ctx.async_t0);
+        w25_ctx.async_op = W25Q64_OP_COUNT;
+    }
+    return 0;
+}
+
+// Reads may run inside a suspended erase, except from the block being erased.
+// -1 if the array could not be made readable in time
+static int ReadyForRead(uint32_t addr, size_t len){
+    if (w25_ctx.async_op == W25Q64_OP_COUNT) return 0;
+    int overlap = addr < w25_ctx.async_addr + w25_ctx.async_size && addr + len > w25_ctx.async_addr;
+    if (!w25_ctx.suspend_enabled || overlap) return FinishAsync();
+    return SuspendAsync();
+}
+
+// Erase opcodes come from the probed geometry (SFDP erase types); a size
+// the part does not offer has no opcode
+static uint8_t EraseOpcodeFor(uint32_t size){
+    for (uint32_t i = 0; i < W25Q64_ERASE_TYPES; i++)
+        if (w25_ctx.geom.erase_size[i] == size) return w25_ctx.geom.erase_opcode[i];
+    return 0;
 }
 
-void W25Q64_WaitWhileBusy(void){
-    uint8_t cmd = CMD_RDSR, sr;
-    do {
-        CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY);
-        HAL_SPI_Receive (w25_ctx.hspi, &sr, 1, HAL_MAX_DELAY); CS_H();
-    } while (sr & 0x01); // WIP
+static int EraseOpcode(W25Q64_BusyOp op, uint8_t *opcode, uint32_t *size){
+    switch (op) {
+    case W25Q64_OP_ERASE_4K:  *size = 0x1000u;  break;
+    case W25Q64_OP_ERASE_32K: *size = 0x8000u;  break;
+    case W25Q64_OP_ERASE_64K: *size = 0x10000u; break;
+    default: return -1;
+    }
+    *opcode = EraseOpcodeFor(*size);
+    return *opcode ? 0 : -1;
 }
 
+// Wait policy for an erase of any size: the nearest of the three
+static W25Q64_BusyOp EraseBusyOp(uint32_t size){
+    if (size <= 0x1000u) return W25Q64_OP_ERASE_4K;
+    return (size <= 0x8000u) ? W25Q64_OP_ERASE_32K : W25Q64_OP_ERASE_64K;
+}
+
+static void EraseCommand(uint8_t opcode, uint32_t addr){
+    W25Q64_WriteEnable();
+    uint8_t cmd[4] = { opcode, (uint8_t)(addr>>16), (uint8_t)(addr>>8), (uint8_t)addr };
+    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, cmd, 4, HAL_MAX_DELAY); CS_H();
+}
+
+int W25Q64_EraseStart(W25Q64_BusyOp op, uint32_t addr){
+    uint8_t opcode; uint32_t size;
+    if (EraseOpcode(op, &opcode, &size) != 0) return -1;
+    FinishAsync();
+    addr &= ~(size - 1u);
+    EraseCommand(opcode, addr);
+    w25_ctx.async_op = op; w25_ctx.async_addr = addr; w25_ctx.async_size = size;
+    w25_ctx.async_t0 = w25_ctx.resume_t0 = NowUs();
+    w25_ctx.suspended = 0;
+    return 0;
+}
+
+int W25Q64_EraseDone(void){
+    if (w25_ctx.async_op == W25Q64_OP_COUNT) return 1;
+    if (w25_ctx.suspended) { ResumeAsync(); return 0; }
+    w25_ctx.busy_stats[w25_ctx.async_op].polls++;
+    if (ReadSR1() & SR1_WIP) return 0;
+    CountWait(w25_ctx.async_op, NowUs() - w25_ctx.async_t0);
+    w25_ctx.async_op = W25Q64_OP_COUNT;
+    return 1;
+}
+
+void W25Q64_EraseWait(void){ FinishAsync(); }
+uint32_t W25Q64_NowUs(void){ return NowUs(); }
+void W25Q64_EnableSuspend(uint8_t enable){ w25_ctx.suspend_enabled = enable ? 1 : 0; }
+void W25Q64_GetSuspendStats(W25Q64_SuspendStats *out){ if (out) *out = w25_ctx.susp; }
+
 void W25Q64_WriteEnable(void){
     uint8_t cmd = CMD_WREN; CS_L();
     HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY);
     CS_H();
 }
 
+// Short CS-high gaps (tRES, tDP): spin on the platform clock, which resolves
+// single microseconds; HAL_GetTick cannot, so fall back to a whole tick
+static void DelayShortUs(uint32_t us){
+    if (!w25_ctx.plat.now_us) { HAL_Delay(1); return; }
+    uint32_t t0 = w25_ctx.plat.now_us();
+    while ((w25_ctx.plat.now_us() - t0) < us) { }
+}
+
+// Move the open awake span into the 64-bit total. The span itself is a
+// difference of 32-bit microsecond stamps, so it is folded on every
+// release/enter/stats call rather than only at DPD entry, which keeps it well
+// under the ~71.6 min wrap even through a long USB session
+static void AwakeFold(void){
+    if (w25_ctx.power != W25Q64_POWER_AWAKE) return;
+    uint32_t now = NowUs();
+    w25_ctx.pwr.awake_us += now - w25_ctx.awake_t0;
+    w25_ctx.awake_t0 = now;
+}
+
 void W25Q64_ReleaseFromDeepPowerDown(void){
+    if (w25_ctx.power == W25Q64_POWER_AWAKE) { AwakeFold(); w25_ctx.pwr.coalesced++; return; }
     uint8_t cmd = CMD_RELEASE; CS_L();
     HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY);
     CS_H();
-    HAL_Delay(1); // tRES safety
+    DelayShortUs(W25Q64_TRES_US);
+    w25_ctx.power = W25Q64_POWER_AWAKE;
+    w25_ctx.awake_t0 = NowUs();
+    w25_ctx.pwr.releases++;
 }
 
 void W25Q64_EnterDeepPowerDown(void){
+    if (w25_ctx.power == W25Q64_POWER_DPD) { w25_ctx.pwr.coalesced++; return; }
+    FinishAsync();   // DP is ignored while WIP=1
     uint8_t cmd = CMD_DP; CS_L();
     HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY);
     CS_H();
+    DelayShortUs(W25Q64_TDP_US);
+    AwakeFold();
+    w25_ctx.power = W25Q64_POWER_DPD;
+    w25_ctx.pwr.enters++;
+}
+
+W25Q64_PowerState W25Q64_GetPowerState(void){ return w25_ctx.power; }
+
+void W25Q64_AssumePowerState(W25Q64_PowerState state){
+    if (state == W25Q64_POWER_AWAKE && w25_ctx.power != W25Q64_POWER_AWAKE) w25_ctx.awake_t0 = NowUs();
+    w25_ctx.power = state;
+}
+
+void W25Q64_GetPowerStats(W25Q64_PowerStats *out){
+    if (!out) return;
+    AwakeFold();
+    *out = w25_ctx.pwr;
+}
+
+void W25Q64_ResetPowerStats(void){
+    memset(&w25_ctx.pwr, 0, sizeof w25_ctx.pwr);
+    w25_ctx.awake_t0 = NowUs();
 }
 
-void W25Q64_Read(uint32_t addr, uint8_t *buf, size_t len){
-    uint8_t cmd[4] = { CMD_READ, (uint8_t)(addr>>16), (uint8_t)(addr>>8), (uint8_t)addr };
-    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, cmd, 4, HAL_MAX_DELAY);
-    HAL_SPI_Receive (w25_ctx.hspi, buf, (uint16_t)len, HAL_MAX_DELAY); CS_H();
+static void ReadCommand(W25Q64_ReadMode mode, uint32_t addr){
+    uint8_t cmd[5] = { read_modes[mode].opcode,
+                       (uint8_t)(addr>>16), (uint8_t)(addr>>8), (uint8_t)addr, 0xFF };
+    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, cmd, (uint16_t)(4 + read_modes[mode].dummy), HAL_MAX_DELAY);
 }
 
-void W25Q64_PageProgram(uint32_t addr, const uint8_t *buf, size_t len){
+int W25Q64_Read(uint32_t addr, uint8_t *buf, size_t len){
+    W25Q64_ReadMode mode = w25_ctx.read_mode;
+    if (ReadyForRead(addr, len) != 0) return -1;
+    ReadCommand(mode, addr);
+    if (read_modes[mode].lanes > 1) {
+        int rc = w25_ctx.multi_rx(read_modes[mode].lanes, buf, len);
+        CS_H();
+        if (rc == 0) return 0;
+        // buf holds whatever the lanes left: read it again on one line
+        w25_ctx.xfer.multi_errors++;
+        mode = W25Q64_READ_FAST;
+        ReadCommand(mode, addr);
+    }
+    int rc = SPI_RxData_DMA(buf, len);
+    if (rc == -2) { CS_H(); ReadCommand(mode, addr); }   // reads are idempotent: restart the frame
+    if (rc != 0) {
+        // HAL length is 16-bit; the read address auto-increments across chunks
+        w25_ctx.xfer.polled_xfers++; w25_ctx.xfer.polled_bytes += len;
+        while (len){
+            uint16_t chunk = (len > 0xFFFFu) ? 0xFFFFu : (uint16_t)len;
+            if (HAL_SPI_Receive(w25_ctx.hspi, buf, chunk, HAL_MAX_DELAY) != HAL_OK) { CS_H(); return -1; }
+            buf += chunk; len -= chunk;
+        }
+    }
+    CS_H();
+    return 0;
+}
+
+int W25Q64_PageProgram(uint32_t addr, const uint8_t *buf, size_t len){
+    FinishAsync();
     while (len){
-        uint32_t page_off = addr & 0xFF;
-        uint32_t chunk = ((256 - page_off) < len ? (256 - page_off) : len);
+        const uint32_t page = w25_ctx.geom.page_size;
+        uint32_t page_off = addr & (page - 1u);
+        uint32_t chunk = ((page - page_off) < len ? (page - page_off) : len);
         W25Q64_WriteEnable();
         uint8_t cmd[4] = { CMD_PP, (uint8_t)(addr>>16), (uint8_t)(addr>>8), (uint8_t)addr };
         CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, cmd, 4, HAL_MAX_DELAY);
-        HAL_SPI_Transmit(w25_ctx.hspi, (uint8_t*)buf, (uint16_t)chunk, HAL_MAX_DELAY); CS_H();
-        W25Q64_WaitWhileBusy();
+        int rc = SPI_TxData_DMA(buf, chunk);
+        if (rc == -1) {
+            HAL_SPI_Transmit(w25_ctx.hspi, (uint8_t*)buf, (uint16_t)chunk, HAL_MAX_DELAY);
+            w25_ctx.xfer.polled_xfers++; w25_ctx.xfer.polled_bytes += chunk;
+        }
+        // -2: the DMA stopped mid-page. Unlike a read the frame cannot be
+        // restarted: CS high commits the bytes already clocked, so the page
+        // holds a partial program and the caller must not trust it
+        CS_H();
+        WaitBusy(W25Q64_OP_PAGE_PROGRAM);
+        if (rc == -2) return -1;
         addr += chunk; buf += chunk; len -= chunk;
     }
+    return 0;
 }
 
-void W25Q64_SectorErase4K(uint32_t addr){
+static int EraseBlocking(W25Q64_BusyOp op, uint32_t addr){
+    uint8_t opcode; uint32_t size;
+    if (EraseOpcode(op, &opcode, &size) != 0) return -1;
+    FinishAsync();
+    EraseCommand(opcode, addr);
+    WaitBusy(op);
+    return 0;
+}
+
+int W25Q64_SectorErase4K(uint32_t addr){ return EraseBlocking(W25Q64_OP_ERASE_4K, addr); }
+int W25Q64_BlockErase32K(uint32_t addr){ return EraseBlocking(W25Q64_OP_ERASE_32K, addr); }
+int W25Q64_BlockErase64K(uint32_t addr){ return EraseBlocking(W25Q64_OP_ERASE_64K, addr); }
+
+// Chip erase cannot be suspended (0x75 is ignored during 0xC7)
+void W25Q64_ChipErase(void){
+    FinishAsync();
     W25Q64_WriteEnable();
-    uint8_t cmd[4] = { CMD_SECTOR_ERASE, (uint8_t)(addr>>16), (uint8_t)(addr>>8), (uint8_t)addr };
-    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, cmd, 4, HAL_MAX_DELAY); CS_H();
-    W25Q64_WaitWhileBusy();
+    uint8_t cmd = CMD_CHIP_ERASE;
+    CS_L(); HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY); CS_H();
+    WaitBusy(W25Q64_OP_ERASE_CHIP);
+}
+
+void W25Q64_EraseRange(uint32_t addr, uint32_t len){
+    const W25Q64_Geometry *g = &w25_ctx.geom;
+    const uint32_t unit = g->erase_size[0];   // smallest; the probe keeps at least one
+    uint32_t end = (addr + len + unit - 1u) & ~(unit - 1u);
+    addr &= ~(unit - 1u);
+    if (end > g->capacity) end = g->capacity;
+    if (addr == 0 && end == g->capacity) { W25Q64_ChipErase(); return; }
+    while (addr < end) {
+        // largest erase type aligned here that stays inside the range
+        uint32_t i = W25Q64_ERASE_TYPES - 1u;
+        while (i && (!g->erase_size[i] || (addr & (g->erase_size[i] - 1u)) || end - addr < g->erase_size[i])) i--;
+        FinishAsync();
+        EraseCommand(g->erase_opcode[i], addr);
+        WaitBusy(EraseBusyOp(g->erase_size[i]));
+        addr += g->erase_size[i];
+    }
 }
 
 // Optional presence check
 int W25Q64_ReadJedecID(uint8_t id[3]) {
     if (!id) return -1;
+    FinishAsync();
     uint8_t cmd = CMD_RDID;
     CS_L();
     if (HAL_SPI_Transmit(w25_ctx.hspi, &cmd, 1, HAL_MAX_DELAY) != HAL_OK) { CS_H(); return -1; }
@@ -90,3 +550,108 @@ int W25Q64_ReadJedecID(uint8_t id[3]) {
     CS_H();
     return 0;
 }
+
+// SFDP table read: 24-bit address plus one dummy byte, same timing as 0x0B
+int W25Q64_ReadSFDP(uint32_t addr, uint8_t *buf, size_t len){
+    if (!buf || len > 0xFFFFu) return -1;
+    FinishAsync();
+    uint8_t cmd[5] = { CMD_RDSFDP, (uint8_t)(addr>>16), (uint8_t)(addr>>8), (uint8_t)addr, 0xFF };
+    CS_L();
+    if (HAL_SPI_Transmit(w25_ctx.hspi, cmd, sizeof cmd, HAL_MAX_DELAY) != HAL_OK) { CS_H(); return -1; }
+    if (HAL_SPI_Receive (w25_ctx.hspi, buf, (uint16_t)len, HAL_MAX_DELAY) != HAL_OK) { CS_H(); return -1; }
+    CS_H();
+    return 0;
+}
+
+static uint32_t le32(const uint8_t *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// JESD216 Basic Flash Parameter Table. The first parameter header always
+// describes it; DWORDs are 1-based in the standard, 0-based in dw[] here.
+static int ParseBFPT(W25Q64_Geometry *g){
+    uint8_t hdr[16], raw[64];
+    uint32_t dw[16] = { 0 };
+    if (W25Q64_ReadSFDP(0, hdr, sizeof hdr) != 0) return -1;
+    if (le32(hdr) != 0x50444653u) return -1;             // "SFDP"
+    if (hdr[8] != 0x00 || hdr[15] != 0xFF) return -1;    // parameter ID 0xFF00
+    uint32_t ndw = hdr[11];
+    uint32_t ptp = (uint32_t)hdr[12] | ((uint32_t)hdr[13] << 8) | ((uint32_t)hdr[14] << 16);
+    if (ndw < 9) return -1;
+    if (ndw > 16) ndw = 16;
+    if (W25Q64_ReadSFDP(ptp, raw, ndw * 4u) != 0) return -1;
+    for (uint32_t i = 0; i < ndw; i++) dw[i] = le32(raw + 4u * i);
+
+    // DWORD2: density in bits, either N-1 or 2^N
+    uint64_t bits = (dw[1] & 0x80000000u) ? ((dw[1] & 0x7FFFFFFFu) < 40u ? 1ull << (dw[1] & 0x7FFFFFFFu) : 0)
+                                          : (uint64_t)dw[1] + 1u;
+    uint64_t bytes = bits / 8u;
+    if (bytes < 65536u) return -1;
+    g->capacity = bytes > (1u << 24) ? (1u << 24) : (uint32_t)bytes;   // no 4-byte addressing
+
+    // DWORD8/9: up to four erase types as (2^N size, opcode), sorted ascending
+    uint32_t n = 0;
+    memset(g->erase_size, 0, sizeof g->erase_size);
+    memset(g->erase_opcode, 0, sizeof g->erase_opcode);
+    for (uint32_t t = 0; t < W25Q64_ERASE_TYPES; t++) {
+        uint32_t w = dw[7u + t / 2u] >> (16u * (t & 1u));
+        uint8_t log2 = (uint8_t)w, op = (uint8_t)(w >> 8);
+        if (!log2 || log2 > 24) continue;
+        uint32_t i = n++;
+        while (i && g->erase_size[i - 1] > (1u << log2)) {
+            g->erase_size[i] = g->erase_size[i - 1]; g->erase_opcode[i] = g->erase_opcode[i - 1]; i--;
+        }
+        g->erase_size[i] = 1u << log2; g->erase_opcode[i] = op;
+    }
+    if (!n) return -1;
+
+    // DWORD11 (JESD216A+): page size 2^N
+    g->page_size = 256u;
+    if (ndw >= 11) {
+        uint32_t log2 = (dw[10] >> 4) & 0xFu;
+        if (log2 >= 4) g->page_size = 1u << log2;
+    }
+
+    // Dual/quad output only with our opcode and 8 dummy+mode clocks (DWORD1/3/4)
+    g->read_modes = (1u << W25Q64_READ_NORMAL) | (1u << W25Q64_READ_FAST);
+    if ((dw[0] & (1u << 16)) && ((dw[3] >> 8) & 0xFFu) == CMD_READ_DUAL &&
+        ((dw[3] & 0x1Fu) + ((dw[3] >> 5) & 0x7u)) == 8u)
+        g->read_modes |= 1u << W25Q64_READ_DUAL_OUT;
+    if ((dw[0] & (1u << 22)) && (dw[2] >> 24) == CMD_READ_QUAD &&
+        (((dw[2] >> 16) & 0x1Fu) + ((dw[2] >> 21) & 0x7u)) == 8u)
+        g->read_modes |= 1u << W25Q64_READ_QUAD_OUT;
+    g->from_sfdp = 1;
+    return 0;
+}
+
+// Parts without SFDP: Winbond-style capacity code, 2^N bytes
+static int GeometryFromJedec(W25Q64_Geometry *g){
+    uint8_t code = g->jedec[2];
+    if (code < 0x10 || code > 0x18) return -1;   // 64 KiB .. 16 MiB
+    uint8_t id[3]; memcpy(id, g->jedec, sizeof id);
+    *g = geom_default;
+    memcpy(g->jedec, id, sizeof id);
+    g->capacity = 1u << code;
+    return 0;
+}
+
+int W25Q64_Probe(W25Q64_Geometry *out){
+    W25Q64_Geometry g = geom_default;
+    int rc = -1;
+    if (W25Q64_ReadJedecID(g.jedec) == 0 && g.jedec[0] != 0x00 && g.jedec[0] != 0xFF) {
+        W25Q64_Geometry sfdp = g;
+        if (ParseBFPT(&sfdp) == 0) { g = sfdp; rc = 0; }
+        else rc = GeometryFromJedec(&g);
+    }
+    if (rc == 0) W25Q64_SetGeometry(&g);
+    if (out) *out = w25_ctx.geom;
+    return rc;
+}
+
+void W25Q64_SetGeometry(const W25Q64_Geometry *g){
+    if (!g) return;
+    w25_ctx.geom = *g;
+    if (!(g->read_modes & (1u << w25_ctx.read_mode))) w25_ctx.read_mode = W25Q64_READ_FAST;
+}
+
+void W25Q64_GetGeometry(W25Q64_Geometry *out){ if (out) *out = w25_ctx.geom; }
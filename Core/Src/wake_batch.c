@@ -0,0 +1,157 @@
+// wake_batch.c - records kept in SRAM2 across Standby, flushed in groups
+#include "wake_batch.h"
+#include "lfs_w25q64.h"
+#include "lfs_util.h"
+#include "ring_log.h"
+#include "log_query.h"
+#include "log_rotate.h"
+#include <string.h>
+
+extern lfs_t lfs;
+extern struct lfs_config lfs_cfg;
+
+#define WAKE_BATCH_MAGIC  0x57424154u   /* "WBAT" */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t bytes;
+    uint32_t crc;                           /* over count, bytes, data[0..bytes) */
+    uint8_t  data[WAKE_BATCH_CAPACITY];
+} wake_batch_t;
+
+/* The linker script leaves SRAM2 (RAM2) empty: the batch owns its base,
+ * the probed flash geometry (LFS_W25Q64_GeometryStore) follows it */
+typedef struct {
+    wake_batch_t batch;
+    uint32_t     geometry[LFS_W25Q64_GEOMETRY_WORDS];
+} sram2_t;
+
+_Static_assert(sizeof(sram2_t) <= SRAM2_SIZE, "batch must fit SRAM2");
+
+#define sram2  (*(sram2_t *)SRAM2_BASE)
+#define batch  (sram2.batch)
+
+static uint32_t batch_crc(void)
+{
+    uint32_t crc = lfs_crc(0xFFFFFFFFu, &batch.count, 2u * sizeof(uint32_t));
+    return lfs_crc(crc, batch.data, batch.bytes);
+}
+
+static int batch_valid(void)
+{
+    return batch.magic == WAKE_BATCH_MAGIC && batch.bytes <= WAKE_BATCH_CAPACITY
+        && batch.crc == batch_crc();
+}
+
+static void batch_reset(void)
+{
+    batch.count = 0;
+    batch.bytes = 0;
+    batch.crc = batch_crc();
+    batch.magic = WAKE_BATCH_MAGIC;
+}
+
+int WakeBatch_Append(const void *rec, uint32_t len)
+{
+    if (!batch_valid()) batch_reset();
+    if (batch.bytes + len > WAKE_BATCH_CAPACITY) return -1;
+    memcpy(batch.data + batch.bytes, rec, len);
+    batch.count++;
+    batch.bytes += len;
+    batch.crc = batch_crc();
+    return (batch.count >= WAKE_BATCH_RECORDS || batch.bytes >= WAKE_BATCH_FLUSH_BYTES) ? 1 : 0;
+}
+
+uint32_t WakeBatch_Pending(void)
+{
+    return batch_valid() ? batch.count : 0;
+}
+
+int WakeBatch_Flush(lfs_t *fs)
+{
+    if (!WakeBatch_Pending()) return 0;
+    // a full segment, or one the batch would carry into the next time
+    // bucket, is archived first (its index goes with it); if that fails
+    // the batch still goes to the active segment
+    uint32_t first;
+    memcpy(&first, batch.data, sizeof first);
+    (void)LogRotate_Check(fs, first);
+    lfs_file_t f;
+    int rc = lfs_file_open(fs, &f, WAKE_BATCH_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
+    if (rc) return rc;
+    lfs_soff_t before = lfs_file_size(fs, &f);
+#if LOG_COMPRESS
+    // one frame per LOG_CODEC_KEY_EVERY records
+    static uint8_t frame[LOG_CODEC_FRAME_MAX];
+    const LogCodec_Rec *recs = (const LogCodec_Rec *)batch.data;
+    uint32_t count = batch.bytes / sizeof *recs;
+    lfs_ssize_t n = 0;
+    for (uint32_t i = 0; i < count && n >= 0; i += LOG_CODEC_KEY_EVERY) {
+        uint32_t k = (count - i < LOG_CODEC_KEY_EVERY) ? count - i : LOG_CODEC_KEY_EVERY;
+        uint32_t len = LogCodec_EncodeFrame(recs + i, k, frame);
+        lfs_ssize_t w = lfs_file_write(fs, &f, frame, len);
+        if (w < 0) n = w;
+        else if ((uint32_t)w != len) n = LFS_ERR_NOSPC;
+        else n += w;
+    }
+    rc = lfs_file_close(fs, &f);
+    if (n < 0) rc = (int)n;
+#else
+    lfs_ssize_t n = lfs_file_write(fs, &f, batch.data, batch.bytes);
+    rc = lfs_file_close(fs, &f);
+    if (n < 0) rc = (int)n;
+    else if ((uint32_t)n != batch.bytes) rc = LFS_ERR_NOSPC;
+#endif
+    /* a reset between the close and here writes the batch twice */
+    if (rc == 0) batch_reset();
+    if (rc == 0 && before >= 0) LFS_W25Q64_UsageFileGrew(fs, before, before + n);
+#if !LOG_COMPRESS
+    // wake.idx grows when a block of records fills; an entry missed here
+    // (no space, reset) is caught up on the next block or by GETLOG INDEX
+    const uint32_t blk = LOG_IDX_RECORDS * LOG_REC_SIZE;
+    if (rc == 0 && before >= 0 && (uint32_t)before / blk != ((uint32_t)before + (uint32_t)n) / blk)
+        (void)LogQuery_IndexUpdate(fs, false, NULL);
+#endif
+    return rc;
+}
+
+int WakeBatch_Sync(void)
+{
+    if (!WakeBatch_Pending()) return 0;
+#if RINGLOG_ENABLE
+    int rc = RingLog_Append(batch.data, batch.bytes);
+    if (rc == 0) batch_reset();
+    return rc;
+#else
+    int rc = LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+    if (rc) return rc;
+    rc = WakeBatch_Flush(&lfs);
+    LFS_W25Q64_Unmount(&lfs);
+    return rc;
+#endif
+}
+
+void WakeBatch_Discard(void)
+{
+    batch_reset();
+}
+
+void WakeBatch_LoadGeometry(uint32_t *words, uint32_t n)
+{
+    if (n > LFS_W25Q64_GEOMETRY_WORDS) n = LFS_W25Q64_GEOMETRY_WORDS;
+    memcpy(words, sram2.geometry, n * sizeof words[0]);
+}
+
+void WakeBatch_SaveGeometry(const uint32_t *words, uint32_t n)
+{
+    if (n > LFS_W25Q64_GEOMETRY_WORDS) n = LFS_W25Q64_GEOMETRY_WORDS;
+    memcpy(sram2.geometry, words, n * sizeof words[0]);
+}
+
+void WakeBatch_ArmRetention(void)
+{
+    // Always on: the geometry spares every wake a probe, and with batching
+    // records are pending on all but one wake in WAKE_BATCH_RECORDS anyway
+    HAL_PWREx_EnableSRAM2ContentRetention();
+}
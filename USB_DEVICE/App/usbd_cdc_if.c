@@ -16,13 +16,15 @@ static int8_t CDC_Init_FS(void);
 static int8_t CDC_DeInit_FS(void);
 static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length);
 static int8_t CDC_Receive_FS(uint8_t* pbuf, uint32_t *Len);
+int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum);
 
 USBD_CDC_ItfTypeDef USBD_Interface_fops_FS =
 {
     CDC_Init_FS,
     CDC_DeInit_FS,
     CDC_Control_FS,
-    CDC_Receive_FS
+    CDC_Receive_FS,
+    CDC_TransmitCplt_FS
 };
 
 static int8_t CDC_Init_FS(void)
@@ -101,11 +103,20 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
     return USBD_CDC_TransmitPacket(&hUsbDeviceFS);
 }
 
-void CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
+/* Bulk streaming (GETLOG) fills this buffer itself, one half per transfer */
+uint8_t *CDC_TxBuffer_FS(void)
+{
+    return UserTxBufferFS;
+}
+
+/* Called from the USB interrupt once a whole transfer (all its packets,
+ * and the ZLP the class adds) has gone out */
+int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
 {
     (void)Buf; (void)Len; (void)epnum;
     extern void USB_CDC_TxCplt(void);
     USB_CDC_TxCplt();
+    return (USBD_OK);
 }
 
 void CDC_TransmitCpltCallback(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
@@ -42,7 +42,14 @@ PCD_HandleTypeDef hpcd_USB_FS;
 void Error_Handler(void);
 
 /* USER CODE BEGIN 0 */
+extern void USB_CDC_Sof(void);
 
+/* SOF interrupt on only while GETLOG counts frames */
+void USBD_LL_SofIrq(uint8_t on)
+{
+  if (on) hpcd_USB_FS.Instance->CNTR |= USB_CNTR_SOFM;
+  else hpcd_USB_FS.Instance->CNTR &= (uint16_t)~USB_CNTR_SOFM;
+}
 /* USER CODE END 0 */
 
 /* Exported function prototypes ----------------------------------------------*/
@@ -189,6 +196,9 @@ static void PCD_SOFCallback(PCD_HandleTypeDef *hpcd)
 void HAL_PCD_SOFCallback(PCD_HandleTypeDef *hpcd)
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
 {
+  /* USER CODE BEGIN SOF */
+  USB_CDC_Sof();
+  /* USER CODE END SOF */
   USBD_LL_SOF((USBD_HandleTypeDef*)hpcd->pData);
 }
 
@@ -369,13 +379,19 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
   HAL_PCD_RegisterIsoInIncpltCallback(&hpcd_USB_FS, PCD_ISOINIncompleteCallback);
 #endif /* USE_HAL_PCD_REGISTER_CALLBACKS */
   /* USER CODE BEGIN EndPoint_Configuration */
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x00 , PCD_SNG_BUF, 0x18);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x80 , PCD_SNG_BUF, 0x58);
+  /* PMA: BTABLE for EP0..EP3 at 0x00-0x1F, then
+   *   0x20 EP0 OUT 64, 0x60 EP0 IN 64, 0xA0 CDC cmd IN 8,
+   *   0xC0 CDC data OUT 64, 0x100 + 0x140 CDC data IN 2 x 64 */
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x00 , PCD_SNG_BUF, 0x20);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x80 , PCD_SNG_BUF, 0x60);
   /* USER CODE END EndPoint_Configuration */
   /* USER CODE BEGIN EndPoint_Configuration_CDC */
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x81 , PCD_SNG_BUF, 0xC0);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x01 , PCD_SNG_BUF, 0x110);
-  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x82 , PCD_SNG_BUF, 0x100);
+  /* Bulk IN double-buffered: the core sends one packet while the driver
+   * copies the next into the other buffer, so the host is not NAKed
+   * between the packets of a transfer. Address word: buf1 << 16 | buf0. */
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x81 , PCD_DBL_BUF, 0x01400100);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x03 , PCD_SNG_BUF, 0xC0);
+  HAL_PCDEx_PMAConfig((PCD_HandleTypeDef*)pdev->pData , 0x82 , PCD_SNG_BUF, 0xA0);
   /* USER CODE END EndPoint_Configuration_CDC */
   return USBD_OK;
 }
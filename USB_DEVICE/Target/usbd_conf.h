@@ -35,7 +35,9 @@
 #include "stm32l4xx_hal.h"
 
 /* USER CODE BEGIN INCLUDE */
-
+/* A double-buffered endpoint takes both PMA descriptors of its EPnR: EP1
+ * is the bulk IN (0x81) alone, CDC data OUT moves to EP3 */
+#define CDC_OUT_EP     0x03U
 /* USER CODE END INCLUDE */
 
 /** @addtogroup USBD_OTG_DRIVER
@@ -0,0 +1,2157 @@
+/* bench.c
+ * Host benchmarks for the storage stack running against the NOR emulator.
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -std=gnu11 -Itools/hostsim/hal -Itools/hostsim -ICore/Inc \
+ *       -D'LFS_TRACE(...)=' \
+ *       tools/hostsim/nor_emu.c tools/hostsim/bench.c \
+ *       Core/Src/w25q64.c Core/Src/lfs_w25q64.c Core/Src/ring_log.c \
+ *       Core/Src/log_query.c Core/Src/log_codec.c Core/Src/log_rotate.c \
+ *       Core/Src/log_frame.c \
+ *       Core/Src/lfs.c Core/Src/lfs_util.c \
+ *       -o /tmp/hostsim_bench
+ *   /tmp/hostsim_bench [section]
+ *
+ * Sections: readmodes dma busy geometry erase suspend dpd clock readahead
+ *           fastmount batch ring getlog usage codec retain segments maint stream
+ *           framed wirez logging
+ */
+#include "nor_emu.h"
+#include "w25q64.h"
+#include "lfs_w25q64.h"
+#include "ring_log.h"
+#include "log_query.h"
+#include "log_codec.h"
+#include "log_rotate.h"
+#include "log_frame.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EMU_CAPACITY   (8u * 1024u * 1024u)   /* W25Q64 */
+
+/* STM32L412 supply current at 2 MHz MSI, 3.0 V (datasheet typical) */
+#define MCU_VDD            3.0
+#define MCU_LPRUN_2MHZ_UA  211.0   /* low-power run, spinning in the HAL */
+#define MCU_LPSLEEP_2MHZ_UA 65.0   /* low-power sleep, SPI + DMA1 clocked */
+#define MCU_STOP_LPTIM_UA    1.3   /* Stop2 with LPTIM1 on LSE */
+#define MCU_STOP1_LPTIM_UA   3.6   /* Stop1, what LP_SleepUs enters under LP run */
+
+/* globals the bridge expects from main.c */
+lfs_t lfs;
+struct lfs_config lfs_cfg;
+
+static SPI_HandleTypeDef hspi_emu;
+static DMA_HandleTypeDef hdma_emu_rx, hdma_emu_tx;
+static uint32_t wake_geom[LFS_W25Q64_GEOMETRY_WORDS];   /* SRAM2 stand-in, see wake_boot */
+
+static void emu_setup(uint32_t spi_hz)
+{
+    nor_emu_cfg_t cfg = {
+        .capacity = EMU_CAPACITY,
+        .jedec = { 0xEF, 0x40, 0x17 },
+        .spi_hz = spi_hz,
+        .read_max_hz = 50000000u,
+    };
+    nor_emu_init(&cfg);
+    for (uint32_t i = 0; i < EMU_CAPACITY; i++) nor_emu_mem()[i] = (uint8_t)(i * 7u);
+    W25Q64_Bind(&hspi_emu, GPIOA, GPIO_PIN_4);
+    W25Q64_BindMultiIO(nor_emu_multi_rx);
+    /* the new part has QE clear: no section inherits another's 0x6B reads */
+    W25Q64_SetReadMode(W25Q64_READ_MODE_DEFAULT);
+    memset(wake_geom, 0, sizeof wake_geom);   /* a new part: probe it */
+}
+
+/* ---- readmodes: full-chip dump cost per read mode, chunk size and SCK ---- */
+static void bench_readmodes(void)
+{
+    static const char *names[] = { "0x03 NORMAL", "0x0B FAST", "0x3B DUAL", "0x6B QUAD" };
+    static const uint32_t clocks[] = { 250000u, 4000000u, 16000000u, 40000000u };
+    static const uint32_t chunks[] = { 256u, 4096u };
+    static uint8_t buf[4096];
+
+    printf("## readmodes: read of the full %u KiB part\n\n", EMU_CAPACITY / 1024u);
+    printf("| mode | SCK | chunk | commands | wire bytes | time ms | KiB/s | check |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (size_t c = 0; c < sizeof clocks / sizeof clocks[0]; c++) {
+        for (size_t k = 0; k < sizeof chunks / sizeof chunks[0]; k++) {
+            for (int m = 0; m < W25Q64_READ_MODE_COUNT; m++) {
+                emu_setup(clocks[c]);
+                if (W25Q64_SetReadMode((W25Q64_ReadMode)m) != 0) continue;
+                nor_emu_reset_stats();
+                uint64_t t0 = nor_emu_now_ns();
+                int ok = 1;
+                for (uint32_t a = 0; a < EMU_CAPACITY; a += chunks[k]) {
+                    W25Q64_Read(a, buf, chunks[k]);
+                    if (buf[0] != (uint8_t)(a * 7u) || buf[chunks[k] - 1] != (uint8_t)((a + chunks[k] - 1) * 7u)) ok = 0;
+                }
+                const nor_emu_stats_t *st = nor_emu_stats();
+                /* the QE write and its RDSR polls are setup, not part of the dump */
+                uint64_t cmds = st->cmds[0x03] + st->cmds[0x0B] + st->cmds[0x3B] + st->cmds[0x6B];
+                double ms = (double)(nor_emu_now_ns() - t0) / 1e6;
+                printf("| %s | %.2f MHz | %u | %llu | %llu | %.1f | %.1f | %s%s |\n",
+                       names[m], clocks[c] / 1e6, chunks[k],
+                       (unsigned long long)cmds, (unsigned long long)st->wire_bytes,
+                       ms, (EMU_CAPACITY / 1024.0) / (ms / 1000.0),
+                       ok ? "ok" : "MISMATCH", st->violations ? " (spec violation)" : "");
+            }
+        }
+    }
+    printf("\n");
+}
+
+/* ---- dma: polled vs DMA data phases for a GETLOG-sized read and a log
+ * append burst, with the MCU energy spent while the bytes are on the wire ---- */
+static void bench_dma(void)
+{
+    static uint8_t buf[256];
+    const uint32_t read_bytes = 1024u * 1024u, prog_bytes = 64u * 1024u;
+
+    printf("## dma: 1 MiB read + 64 KiB program in 256 B lfs-sized transfers, SCK 250 kHz\n\n");
+    printf("| path | dma xfers | polled xfers | wire ms | core spinning ms | core asleep ms | MCU energy uJ |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    for (int use_dma = 0; use_dma <= 1; use_dma++) {
+        emu_setup(250000u);
+        hspi_emu.hdmarx = use_dma ? &hdma_emu_rx : NULL;
+        hspi_emu.hdmatx = use_dma ? &hdma_emu_tx : NULL;
+        W25Q64_EnableDMA((uint8_t)use_dma);
+        memset(nor_emu_mem(), 0xFF, prog_bytes);
+        nor_emu_reset_stats();
+        W25Q64_ResetXferStats();
+
+        for (uint32_t a = 0; a < read_bytes; a += sizeof buf) W25Q64_Read(a, buf, sizeof buf);
+        for (uint32_t a = 0; a < prog_bytes; a += sizeof buf) W25Q64_PageProgram(a, buf, sizeof buf);
+
+        const nor_emu_stats_t *st = nor_emu_stats();
+        W25Q64_XferStats xs; W25Q64_GetXferStats(&xs);
+        double spin_ms = st->polled_ns / 1e6, sleep_ms = st->dma_ns / 1e6;
+        double uj = MCU_VDD * (MCU_LPRUN_2MHZ_UA * spin_ms + MCU_LPSLEEP_2MHZ_UA * sleep_ms) / 1000.0;
+        printf("| %s | %lu | %lu | %.1f | %.1f | %.1f | %.0f |\n", use_dma ? "DMA + WFI" : "polled",
+               (unsigned long)xs.dma_xfers, (unsigned long)xs.polled_xfers,
+               (spin_ms + sleep_ms), spin_ms, sleep_ms, uj);
+    }
+    printf("\n");
+}
+
+/* ---- busy: spin on RDSR vs sleep-first policies while the part is busy ---- */
+static uint64_t host_slept_ns;
+
+static void host_sleep_us(uint32_t us)
+{
+    nor_emu_advance_ns((uint64_t)us * 1000u);
+    host_slept_ns += (uint64_t)us * 1000u;
+}
+
+/* Reading the clock costs 1 us of virtual time, so spin loops make progress */
+static uint32_t host_now_us(void)
+{
+    nor_emu_advance_ns(1000u);
+    return (uint32_t)(nor_emu_now_ns() / 1000u);
+}
+
+static const W25Q64_Platform host_platform = { host_sleep_us, host_now_us };
+
+static void bench_busy(void)
+{
+    static const char *ops[] = { "page program", "erase 4K" };
+    static uint8_t buf[256];
+    const uint32_t pages = 256u, sectors = 16u;
+
+    printf("## busy: %u page programs + %u sector erases, SCK 250 kHz\n\n", pages, sectors);
+    printf("| policy | op | ops | RDSR polls | polls/op | avg wait us | max wait us | timeouts |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    double uj[2] = { 0 };
+    for (int sleep = 0; sleep <= 1; sleep++) {
+        emu_setup(250000u);
+        memset(nor_emu_mem(), 0xFF, pages * sizeof buf);
+        W25Q64_BindPlatform(sleep ? &host_platform : NULL);
+        W25Q64_ResetBusyStats();
+        nor_emu_reset_stats();
+        host_slept_ns = 0;
+        uint64_t t0 = nor_emu_now_ns();
+
+        for (uint32_t i = 0; i < pages; i++) W25Q64_PageProgram(i * sizeof buf, buf, sizeof buf);
+        for (uint32_t i = 0; i < sectors; i++) W25Q64_SectorErase4K(i * 4096u);
+
+        for (int op = 0; op < 2; op++) {
+            W25Q64_BusyStats bs; W25Q64_GetBusyStats((W25Q64_BusyOp)op, &bs);
+            printf("| %s | %s | %lu | %lu | %.1f | %.0f | %lu | %lu |\n",
+                   sleep ? "sleep-first" : "spin", ops[op], (unsigned long)bs.ops,
+                   (unsigned long)bs.polls, bs.ops ? (double)bs.polls / bs.ops : 0.0,
+                   bs.ops ? (double)bs.waited_us / bs.ops : 0.0,
+                   (unsigned long)bs.max_wait_us, (unsigned long)bs.timeouts);
+        }
+        /* the core runs whenever it is not in the LPTIM sleep */
+        double total_ms = (nor_emu_now_ns() - t0) / 1e6, stop_ms = host_slept_ns / 1e6;
+        uj[sleep] = MCU_VDD * (MCU_LPRUN_2MHZ_UA * (total_ms - stop_ms) + MCU_STOP_LPTIM_UA * stop_ms) / 1000.0;
+        if (nor_emu_stats()->violations) printf("| %s | spec violations: %llu |\n", sleep ? "sleep-first" : "spin",
+                                                (unsigned long long)nor_emu_stats()->violations);
+    }
+    W25Q64_BindPlatform(NULL);
+    printf("\nMCU energy over the workload: spin %.0f uJ, sleep-first %.0f uJ\n\n", uj[0], uj[1]);
+}
+
+/* ---- geometry: what LFS_W25Q64_InitConfig derives for each sourced part ---- */
+static void bench_geometry(void)
+{
+    static const struct { const char *name; uint32_t capacity; uint8_t code; } parts[] = {
+        { "W25Q32JV",  4u << 20, 0x16 },
+        { "W25Q64JV",  8u << 20, 0x17 },
+        { "W25Q128JV", 16u << 20, 0x18 },
+    };
+    static uint8_t rbuf[LFS_W25Q64_CACHE_SIZE], pbuf[LFS_W25Q64_CACHE_SIZE], lbuf[LFS_W25Q64_LOOKAHEAD];
+
+    printf("## geometry: probe result and littlefs config per part\n\n");
+    printf("| part | SFDP | capacity KiB | page | erase sizes | read modes | block_count | lookahead B | format+mount | lfs blocks |\n");
+    printf("|---|---|---|---|---|---|---|---|---|---|\n");
+    for (size_t i = 0; i < sizeof parts / sizeof parts[0]; i++) {
+        for (int no_sfdp = 0; no_sfdp <= 1; no_sfdp++) {
+            nor_emu_cfg_t cfg = {
+                .capacity = parts[i].capacity,
+                .jedec = { 0xEF, 0x40, parts[i].code },
+                .spi_hz = 250000u,
+                .read_max_hz = 50000000u,
+                .no_sfdp = no_sfdp,
+            };
+            nor_emu_init(&cfg);
+            W25Q64_Bind(&hspi_emu, GPIOA, GPIO_PIN_4);
+            LFS_W25Q64_InitConfig(&lfs_cfg);
+            lfs_cfg.read_buffer = rbuf; lfs_cfg.prog_buffer = pbuf; lfs_cfg.lookahead_buffer = lbuf;
+
+            W25Q64_Geometry g; W25Q64_GetGeometry(&g);
+            char erase[64] = "", modes[8] = "";
+            for (uint32_t e = 0; e < W25Q64_ERASE_TYPES && g.erase_size[e]; e++)
+                snprintf(erase + strlen(erase), sizeof erase - strlen(erase), "%s%uK/0x%02X",
+                         e ? " " : "", (unsigned)(g.erase_size[e] / 1024u), g.erase_opcode[e]);
+            for (int m = 0; m < W25Q64_READ_MODE_COUNT; m++)
+                modes[strlen(modes)] = (g.read_modes & (1u << m)) ? "NFDQ"[m] : '-';
+
+            W25Q64_ReleaseFromDeepPowerDown();
+            int rc = LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
+            lfs_ssize_t blocks = -1;
+            if (rc == 0) {
+                struct lfs_fsinfo fi;
+                if (lfs_fs_stat(&lfs, &fi) == 0) blocks = (lfs_ssize_t)fi.block_count;
+                LFS_W25Q64_Unmount(&lfs);
+            }
+            printf("| %s | %s | %u | %u | %s | %s | %lu | %lu | %s | %ld |\n",
+                   parts[i].name, g.from_sfdp ? "yes" : "no (JEDEC)", (unsigned)(g.capacity / 1024u),
+                   (unsigned)g.page_size, erase, modes, (unsigned long)lfs_cfg.block_count,
+                   (unsigned long)lfs_cfg.lookahead_size, rc ? "FAIL" : "ok", (long)blocks);
+        }
+    }
+    printf("\n");
+}
+
+/* ---- erase: ERASELOG (lfs_remove) vs ERASELOG FAST (chip erase + format),
+ * counting the erase work of the log that is written afterwards ---- */
+static uint32_t host_erase_mark;
+static uint32_t host_mark_get(void) { return host_erase_mark; }
+static void host_mark_set(uint32_t m) { host_erase_mark = m; }
+static const LFS_W25Q64_EraseMarker host_marker = { host_mark_get, host_mark_set };
+
+static void fill_log(uint32_t bytes)
+{
+    static uint8_t chunk[4096];
+    lfs_file_t lf;
+    memset(chunk, 0x5A, sizeof chunk);
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) return;
+    if (lfs_file_open(&lfs, &lf, "wake.bin", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) == 0) {
+        for (uint32_t n = 0; n < bytes; n += sizeof chunk) lfs_file_write(&lfs, &lf, chunk, sizeof chunk);
+        lfs_file_close(&lfs, &lf);
+    }
+    LFS_W25Q64_Unmount(&lfs);
+}
+
+static double erase_busy_s(void)
+{
+    const nor_emu_stats_t *st = nor_emu_stats();
+    return (st->busy_ns_cmd[0x20] + st->busy_ns_cmd[0x52] + st->busy_ns_cmd[0xD8] + st->busy_ns_cmd[0xC7]) / 1e9;
+}
+
+static void bench_erase(void)
+{
+    static uint8_t rbuf[LFS_W25Q64_CACHE_SIZE], pbuf[LFS_W25Q64_CACHE_SIZE], lbuf[LFS_W25Q64_LOOKAHEAD];
+    const uint32_t log_bytes = 4u * 1024u * 1024u;
+
+    printf("## erase: clear a %u MiB wake.bin, then log %u MiB again, SCK 250 kHz\n\n",
+           log_bytes >> 20, log_bytes >> 20);
+    printf("| ERASELOG | command erase s | refill 4K erases | skipped | refill erase s | blank-check KiB | check wire s | battery charge mC |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    static const char *modes[] = { "plain", "FAST chip erase", "FAST background" };
+    for (int fast = 0; fast <= 2; fast++) {
+        emu_setup(250000u);
+        W25Q64_BindPlatform(&host_platform);
+        LFS_W25Q64_BindEraseMarker(&host_marker);
+        host_erase_mark = 0;
+        LFS_W25Q64_InitConfig(&lfs_cfg);
+        lfs_cfg.read_buffer = rbuf; lfs_cfg.prog_buffer = pbuf; lfs_cfg.lookahead_buffer = lbuf;
+        W25Q64_ReleaseFromDeepPowerDown();
+        LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
+        LFS_W25Q64_Unmount(&lfs);
+        fill_log(log_bytes);
+
+        nor_emu_reset_stats();
+        if (fast == 1) {
+            LFS_W25Q64_EraseAndFormat(&lfs, &lfs_cfg);
+        } else {
+            LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+            lfs_remove(&lfs, "wake.bin");
+            if (fast == 2) LFS_W25Q64_PreEraseStart(&lfs);
+            LFS_W25Q64_Unmount(&lfs);
+            while (LFS_W25Q64_PreEraseStep()) W25Q64_EraseWait();
+        }
+        double cmd_s = erase_busy_s();
+
+        LFS_W25Q64_EraseStats e0, e1;
+        LFS_W25Q64_GetEraseStats(&e0);
+        nor_emu_reset_stats();
+        fill_log(log_bytes);
+        LFS_W25Q64_GetEraseStats(&e1);
+        double refill_s = erase_busy_s();
+        uint32_t check = e1.check_bytes - e0.check_bytes;
+        double check_s = check * 8.0 / 250000.0;
+        double mc = nor_emu_stats()->uj_total / MCU_VDD / 1000.0;
+        printf("| %s | %.1f | %lu | %lu | %.1f | %lu | %.1f | %.0f |\n", modes[fast],
+               cmd_s, (unsigned long)(e1.erases - e0.erases), (unsigned long)(e1.skipped - e0.skipped),
+               refill_s, (unsigned long)(check / 1024u), check_s, mc);
+    }
+    LFS_W25Q64_BindEraseMarker(NULL);
+    W25Q64_BindPlatform(NULL);
+    printf("\nThe command erase runs on USB power; refill erases and blank checks run on battery.\n\n");
+}
+
+/* ---- suspend: command latency while ERASELOG FAST erases free space,
+ * one STATUS-like command (mount + fs_size) every 250 ms, SCK 6 MHz ---- */
+#define LAT_BUCKETS 10
+static const uint32_t lat_edges_ms[LAT_BUCKETS - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+
+static void status_cmd(void)
+{
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) == 0) {
+        (void)lfs_fs_size(&lfs);
+        LFS_W25Q64_Unmount(&lfs);
+    }
+}
+
+static void bench_suspend(void)
+{
+    static const char *modes[] = { "blocking erase", "sliced", "sliced + suspend" };
+    static uint8_t rbuf[LFS_W25Q64_CACHE_SIZE], pbuf[LFS_W25Q64_CACHE_SIZE], lbuf[LFS_W25Q64_LOOKAHEAD];
+    const uint64_t period_ns = 250000000ull;
+
+    printf("## suspend: STATUS every 250 ms during ERASELOG FAST on an empty 8 MiB volume, SCK 6 MHz\n\n");
+    printf("| mode | cmds | <1 | <2 | <5 | <10 | <20 | <50 | <100 | <200 | <500 | >=500 | max ms | job s | suspends | violations |\n");
+    printf("|---|---|---|---|---|---|---|---|---|---|---|---|---|---|---|---|\n");
+    for (int mode = 0; mode < 3; mode++) {
+        emu_setup(6000000u);
+        W25Q64_BindPlatform(&host_platform);
+        LFS_W25Q64_BindEraseMarker(&host_marker);
+        host_erase_mark = 0;
+        W25Q64_EnableSuspend(mode == 2);
+        LFS_W25Q64_InitConfig(&lfs_cfg);
+        lfs_cfg.read_buffer = rbuf; lfs_cfg.prog_buffer = pbuf; lfs_cfg.lookahead_buffer = lbuf;
+        W25Q64_ReleaseFromDeepPowerDown();
+        LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
+        LFS_W25Q64_PreEraseStart(&lfs);
+        LFS_W25Q64_Unmount(&lfs);
+        nor_emu_reset_stats();
+
+        uint32_t hist[LAT_BUCKETS] = { 0 }, cmds = 0;
+        uint64_t t0 = nor_emu_now_ns(), next_cmd = t0 + period_ns, max_ns = 0;
+        int busy = 1;
+        while (busy) {
+            if (mode == 0) {
+                /* the whole job runs before the loop sees the next command */
+                while (LFS_W25Q64_PreEraseStep()) W25Q64_EraseWait();
+                busy = 0;
+            } else {
+                busy = LFS_W25Q64_PreEraseStep();
+            }
+            while (nor_emu_now_ns() >= next_cmd) {
+                status_cmd();
+                uint64_t lat = nor_emu_now_ns() - next_cmd;
+                uint32_t ms = (uint32_t)(lat / 1000000u), i = 0;
+                while (i < LAT_BUCKETS - 1 && ms >= lat_edges_ms[i]) i++;
+                hist[i]++; cmds++;
+                if (lat > max_ns) max_ns = lat;
+                next_cmd += period_ns;
+            }
+            host_sleep_us(1000);   /* HAL_Delay(1) in the service loop */
+        }
+        W25Q64_SuspendStats ss; W25Q64_GetSuspendStats(&ss);
+        printf("| %s | %lu |", modes[mode], (unsigned long)cmds);
+        for (int i = 0; i < LAT_BUCKETS; i++) printf(" %lu |", (unsigned long)hist[i]);
+        printf(" %.1f | %.1f | %llu | %llu |\n", max_ns / 1e6, (nor_emu_now_ns() - t0) / 1e9,
+               (unsigned long long)nor_emu_stats()->suspends, (unsigned long long)nor_emu_stats()->violations);
+    }
+    W25Q64_EnableSuspend(1);
+    LFS_W25Q64_BindEraseMarker(NULL);
+    W25Q64_BindPlatform(NULL);
+    printf("\n");
+}
+
+/* ---- logging: the main() wake cycle (release, mount, append one record,
+ * unmount, deep power-down) repeated over years of virtual time ---- */
+typedef struct __attribute__((packed)) {
+    uint32_t epoch;
+    int16_t  t_x100;
+    uint16_t rh_x100;
+} bench_logrec_t;
+
+static uint8_t wake_rbuf[LFS_W25Q64_CACHE_SIZE], wake_pbuf[LFS_W25Q64_CACHE_SIZE], wake_lbuf[LFS_W25Q64_LOOKAHEAD];
+
+/* One wake of main(): the MCU comes out of standby with the driver state
+ * lost but the flash in DPD and its geometry in SRAM2 (probed on the first
+ * wake of a section only), mounts, appends wake_batch_n records in one
+ * write and puts the flash back in DPD. Returns the records written, -1
+ * once the fs is full. */
+static int wake_probe_every;        // 1: no geometry kept, a probe every wake as before SRAM2 kept it
+static uint32_t wake_batch_n = 1;   // records per flush (WAKE_BATCH_RECORDS)
+static int wake_usage_walk;         // 1: near-full check walks every wake, as before the kept count
+
+static void wake_geom_load(uint32_t *w, uint32_t n) { memcpy(w, wake_geom, n * sizeof *w); }
+static void wake_geom_save(const uint32_t *w, uint32_t n) { memcpy(wake_geom, w, n * sizeof *w); }
+
+/* main() up to the flush decision; a wake that only queues its record in
+ * SRAM2 ends here */
+static void wake_boot(void)
+{
+    static const LFS_W25Q64_GeometryStore keep = { wake_geom_load, wake_geom_save };
+    W25Q64_Bind(&hspi_emu, GPIOA, GPIO_PIN_4);
+    W25Q64_AssumePowerState(W25Q64_POWER_DPD);   // a Standby wake
+    W25Q64_ResetPowerStats();
+    LFS_W25Q64_BindGeometry(wake_probe_every ? NULL : &keep);
+    LFS_W25Q64_InitConfig(&lfs_cfg);
+    LFS_W25Q64_BindGeometry(NULL);   // the other sections probe their own parts
+    W25Q64_EnterDeepPowerDown();
+}
+
+static int wake_cycle(uint32_t epoch)
+{
+    int rc = 0;
+    wake_boot();
+    lfs_cfg.read_buffer = wake_rbuf; lfs_cfg.prog_buffer = wake_pbuf; lfs_cfg.lookahead_buffer = wake_lbuf;
+    W25Q64_ReleaseFromDeepPowerDown();
+    if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0) LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
+    if (wake_usage_walk) LFS_W25Q64_UsageInvalidate();
+    if (FS_IsNearFull(2)) {
+        rc = -1;
+    } else {
+        static bench_logrec_t recs[256];
+        uint32_t n = wake_batch_n < 256u ? wake_batch_n : 256u;
+        for (uint32_t i = 0; i < n; i++) recs[i] = (bench_logrec_t){ .epoch = epoch + i, .t_x100 = 2150, .rh_x100 = 4500 };
+        lfs_file_t lf;
+        if (lfs_file_open(&lfs, &lf, "wake.bin", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) == 0) {
+            lfs_soff_t before = lfs_file_size(&lfs, &lf);
+            if (lfs_file_write(&lfs, &lf, recs, n * sizeof recs[0]) == (lfs_ssize_t)(n * sizeof recs[0])) rc = (int)n;
+            if (lfs_file_close(&lfs, &lf) == 0 && rc > 0)   // as WakeBatch_Flush
+                LFS_W25Q64_UsageFileGrew(&lfs, before, before + (lfs_soff_t)(n * sizeof recs[0]));
+        }
+    }
+    LFS_W25Q64_Unmount(&lfs);
+    W25Q64_EnterDeepPowerDown();
+    return rc;
+}
+
+static void bench_logging(void)
+{
+    static const struct { uint32_t interval_s; uint32_t years; } runs[] = {
+        { 3600u, 5u }, { 900u, 2u }, { 300u, 1u },
+    };
+
+    printf("## logging: one %u-byte record per wake, flash energy only, SCK 250 kHz, %.1f V\n\n",
+           (unsigned)sizeof(bench_logrec_t), MCU_VDD);
+    printf("| interval | years | wakes | log KiB | 4K erases | awake ms/wake | active J | program J | erase J | DPD J | total J | avg uA | host s |\n");
+    printf("|---|---|---|---|---|---|---|---|---|---|---|---|---|\n");
+    for (size_t r = 0; r < sizeof runs / sizeof runs[0]; r++) {
+        clock_t c0 = clock();
+        emu_setup(250000u);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        W25Q64_BindPlatform(&host_platform);
+        nor_emu_reset_stats();
+
+        const uint64_t interval_ns = (uint64_t)runs[r].interval_s * 1000000000ull;
+        const uint32_t wakes = (uint32_t)((uint64_t)runs[r].years * 365u * 86400u / runs[r].interval_s);
+        uint64_t awake_ns = 0;
+        uint32_t logged = 0;
+        for (uint32_t w = 0; w < wakes; w++) {
+            uint64_t t0 = nor_emu_now_ns();
+            int rc = wake_cycle(w * runs[r].interval_s);
+            if (rc < 0) break;
+            logged += (uint32_t)rc;
+            uint64_t t1 = nor_emu_now_ns();
+            awake_ns += t1 - t0;
+            if (t1 - t0 < interval_ns) nor_emu_advance_ns(interval_ns - (t1 - t0));
+        }
+
+        const nor_emu_stats_t *st = nor_emu_stats();
+        double prog = st->uj_cmd[0x02], erase = st->uj_cmd[0x20] + st->uj_cmd[0x52] + st->uj_cmd[0xD8];
+        double active = st->uj_total - prog - erase - st->uj_dpd;
+        double secs = nor_emu_now_ns() / 1e9;
+        printf("| %lu s | %lu | %lu | %lu | %llu | %.1f | %.2f | %.2f | %.2f | %.2f | %.2f | %.3f | %.1f |\n",
+               (unsigned long)runs[r].interval_s, (unsigned long)runs[r].years, (unsigned long)logged,
+               (unsigned long)(logged * sizeof(bench_logrec_t) / 1024u),
+               (unsigned long long)st->cmds[0x20], logged ? awake_ns / 1e6 / logged : 0.0,
+               active / 1e6, prog / 1e6, erase / 1e6, st->uj_dpd / 1e6, st->uj_total / 1e6,
+               st->uj_total / MCU_VDD / secs, (double)(clock() - c0) / CLOCKS_PER_SEC);
+        if (st->violations || st->prog_conflicts)
+            printf("  NOR violations %llu, 0->1 program attempts %llu **FAIL**\n",
+                   (unsigned long long)st->violations, (unsigned long long)st->prog_conflicts);
+    }
+    W25Q64_BindPlatform(NULL);
+    printf("\nactive = CS-low command/read time plus standby between frames.\n\n");
+}
+
+/* ---- batch: records queued in SRAM2 and appended N at a time; the
+ * wakes in between leave the flash in DPD. Hourly wakes, SCK 250 kHz ---- */
+static void bench_batch(void)
+{
+    static const uint32_t group[] = { 1, 8, 32, 64 };
+    const uint32_t records = 4096;
+    const uint64_t hour_ns = 3600ull * 1000000000ull;
+
+    printf("## batch: %lu hourly records, flush every N wakes, SCK 250 kHz\n\n", (unsigned long)records);
+    printf("| N | flush wakes | page programs/rec | 4K erases/rec | wire B/rec | flash awake ms/rec | flash uJ/rec |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    for (size_t g = 0; g < sizeof group / sizeof group[0]; g++) {
+        emu_setup(250000u);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        W25Q64_BindPlatform(&host_platform);
+        wake_batch_n = 1;
+        (void)wake_cycle(0);   // format outside the measurement
+        nor_emu_reset_stats();
+        wake_batch_n = group[g];
+        uint32_t flushes = 0, logged = 0;
+        uint64_t awake_ns = 0;
+        while (logged < records) {
+            uint64_t t0 = nor_emu_now_ns();
+            int rc = wake_cycle(logged * 3600u);
+            if (rc <= 0) break;
+            uint64_t dt = nor_emu_now_ns() - t0;
+            awake_ns += dt;
+            logged += (uint32_t)rc;
+            flushes++;
+            /* the N - 1 wakes that only queued, and this one's interval */
+            uint64_t span = (uint64_t)rc * hour_ns;
+            if (dt < span) nor_emu_advance_ns(span - dt);
+        }
+        const nor_emu_stats_t *st = nor_emu_stats();
+        printf("| %lu | %lu | %.3f | %.4f | %.1f | %.2f | %.1f |\n", (unsigned long)group[g], (unsigned long)flushes,
+               (double)st->cmds[0x02] / logged, (double)st->cmds[0x20] / logged, (double)st->wire_bytes / logged,
+               awake_ns / 1e6 / logged, st->uj_total / logged);
+    }
+    wake_batch_n = 1;
+    W25Q64_BindPlatform(NULL);
+    printf("\nflash uJ includes DPD current over the whole interval. Build knobs:\n"
+           "WAKE_BATCH_RECORDS, WAKE_BATCH_FLUSH_BYTES (wake_batch.h).\n\n");
+}
+
+/* ---- ring: the same 30-record batches (one ring page) appended to wake.bin through
+ * littlefs or to the raw ring above a 64-block littlefs partition ---- */
+#define RING_LFS_BLOCKS  64u
+
+/* Ring wake: driver state lost, probe, recover the head, one append */
+static void ring_wake(const bench_logrec_t *recs, uint32_t n, uint32_t ring_bytes)
+{
+    W25Q64_Bind(&hspi_emu, GPIOA, GPIO_PIN_4);
+    LFS_W25Q64_InitConfig(&lfs_cfg);
+    W25Q64_ReleaseFromDeepPowerDown();
+    RingLog_Init(RING_LFS_BLOCKS * LFS_W25Q64_BLOCK_SIZE, ring_bytes);
+    RingLog_Mount();
+    RingLog_Append(recs, n * sizeof recs[0]);
+    W25Q64_EnterDeepPowerDown();
+}
+
+/* Read the ring back; returns the records seen, -1 if epochs are not
+ * consecutive or do not end at 'last' */
+static long ring_check(uint32_t last)
+{
+    static uint8_t page[RINGLOG_PAGE_SIZE];
+    RingLog_Cursor c;
+    long count = 0;
+    uint32_t prev = 0;
+    int n;
+    W25Q64_ReleaseFromDeepPowerDown();
+    RingLog_Mount();
+    RingLog_ReadBegin(&c);
+    while ((n = RingLog_Read(&c, page)) > 0) {
+        for (int i = 0; i < n; i += (int)sizeof(bench_logrec_t)) {
+            bench_logrec_t r;
+            memcpy(&r, page + i, sizeof r);
+            if (count && r.epoch != prev + 1u) return -1;
+            prev = r.epoch;
+            count++;
+        }
+    }
+    W25Q64_EnterDeepPowerDown();
+    return (count && prev != last) ? -1 : count;
+}
+
+static void bench_ring(void)
+{
+    const uint32_t records = 30u * 136u, group = RINGLOG_PAGE_RECORDS;
+    const uint64_t span_ns = group * 3600ull * 1000000000ull;
+    static bench_logrec_t recs[RINGLOG_PAGE_RECORDS];
+
+    printf("## ring: %lu hourly records in batches of %lu, SCK 250 kHz\n\n", (unsigned long)records, (unsigned long)group);
+    printf("| backend | page programs/rec | 4K erases/rec | wire B/rec | flash awake ms/batch | flash uJ/rec | readback |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    for (int backend = 0; backend < 2; backend++) {
+        emu_setup(250000u);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        W25Q64_BindPlatform(&host_platform);
+        wake_batch_n = group;
+        if (!backend) (void)wake_cycle(0);   // format outside the measurement
+        nor_emu_reset_stats();
+        uint64_t awake_ns = 0;
+        for (uint32_t done = 0; done < records; done += group) {
+            uint64_t t0 = nor_emu_now_ns();
+            if (backend) {
+                for (uint32_t i = 0; i < group; i++) recs[i] = (bench_logrec_t){ .epoch = done + i, .t_x100 = 2150, .rh_x100 = 4500 };
+                ring_wake(recs, group, EMU_CAPACITY - RING_LFS_BLOCKS * LFS_W25Q64_BLOCK_SIZE);
+            } else {
+                (void)wake_cycle(done);
+            }
+            uint64_t dt = nor_emu_now_ns() - t0;
+            awake_ns += dt;
+            if (dt < span_ns) nor_emu_advance_ns(span_ns - dt);
+        }
+        const nor_emu_stats_t *st = nor_emu_stats();
+        char check[32] = "-";
+        if (backend) {
+            long got = ring_check(records - 1u);
+            snprintf(check, sizeof check, got == (long)records ? "ok" : "FAIL (%ld)", got);
+        }
+        printf("| %s | %.3f | %.4f | %.1f | %.1f | %.1f | %s |\n", backend ? "ring" : "littlefs wake.bin",
+               (double)st->cmds[0x02] / records, (double)st->cmds[0x20] / records, (double)st->wire_bytes / records,
+               awake_ns / 1e6 / (records / group), st->uj_total / records, check);
+    }
+    wake_batch_n = 1;
+
+    /* recovery cost and wrap-around on a 6-sector ring */
+    RingLog_Info info;
+    RingLog_GetInfo(&info);
+    printf("\nHead recovery on the %lu-sector ring: %lu flash reads.\n", (unsigned long)info.sectors,
+           (unsigned long)info.mount_reads);
+    memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+    uint32_t epoch = 0;
+    for (uint32_t b = 0; b < 200; b++) {
+        for (uint32_t i = 0; i < group; i++) recs[i] = (bench_logrec_t){ .epoch = epoch++ };
+        ring_wake(recs, group, 6u * RINGLOG_SECTOR_SIZE);
+    }
+    long kept = ring_check(epoch - 1u);
+    /* an oldest sector erased with no header written, as after a reset */
+    RingLog_GetInfo(&info);
+    W25Q64_ReleaseFromDeepPowerDown();
+    RingLog_Cursor c;
+    RingLog_ReadBegin(&c);
+    W25Q64_SectorErase4K(RING_LFS_BLOCKS * LFS_W25Q64_BLOCK_SIZE + c.sector * RINGLOG_SECTOR_SIZE);
+    W25Q64_EnterDeepPowerDown();
+    for (uint32_t i = 0; i < group; i++) recs[i] = (bench_logrec_t){ .epoch = epoch++ };
+    ring_wake(recs, group, 6u * RINGLOG_SECTOR_SIZE);
+    long after = ring_check(epoch - 1u);
+    printf("6-sector ring after %lu records: %ld kept in order%s; after a torn sector open: %ld%s.\n",
+           (unsigned long)(epoch - group), kept, kept > 0 ? "" : " FAIL", after, after > 0 ? "" : " FAIL");
+    W25Q64_BindPlatform(NULL);
+    printf("\n");
+}
+
+/* ---- getlog: SINCE/BETWEEN over a 1 MiB wake.bin whose clock was set back
+ * a day half way through: wake.idx, wake.seg search, whole-file read ---- */
+#define GETLOG_RECORDS  131072u
+#define GETLOG_T0       1700000000u
+#define GETLOG_BATCH    32u
+
+static uint32_t getlog_epoch(uint32_t i)
+{
+    /* one record a minute; SETTIME moves the clock back a day at the midpoint */
+    return GETLOG_T0 + i * 60u - (i >= GETLOG_RECORDS / 2u ? 86400u : 0u);
+}
+
+typedef struct {
+    uint32_t lo, hi;
+    uint32_t matched, read, bad;
+} getlog_bench_t;
+
+static void getlog_sink(lfs_file_t *f, uint32_t from, uint32_t to, bool check, void *ctx)
+{
+    getlog_bench_t *g = (getlog_bench_t*)ctx;
+    static uint8_t buf[512];
+    (void)lfs_file_seek(&lfs, f, (lfs_soff_t)(from * LOG_REC_SIZE), LFS_SEEK_SET);
+    while (from < to) {
+        uint32_t want = (to - from) * LOG_REC_SIZE;
+        if (want > sizeof buf) want = sizeof buf;
+        lfs_ssize_t r = lfs_file_read(&lfs, f, buf, want);
+        if (r <= 0) break;
+        for (uint32_t i = 0; i < (uint32_t)r / LOG_REC_SIZE; i++) {
+            uint32_t e;
+            memcpy(&e, buf + i * LOG_REC_SIZE, sizeof e);
+            g->read++;
+            if (LogQuery_Match(e, g->lo, g->hi)) g->matched++;
+            else if (!check) g->bad++;
+        }
+        from += (uint32_t)r / LOG_REC_SIZE;
+    }
+}
+
+/* One query; mode 0: LogQuery_Ranges, 1: the whole file read and filtered */
+static void getlog_query(int mode, uint32_t lo, uint32_t hi, getlog_bench_t *g, LogQuery_Stats *st,
+                         uint64_t *wire, uint64_t *ns)
+{
+    lfs_file_t f;
+    *g = (getlog_bench_t){ .lo = lo, .hi = hi };
+    memset(st, 0, sizeof *st);
+    (void)lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_RDONLY);
+    nor_emu_reset_stats();
+    uint64_t t0 = nor_emu_now_ns();
+    if (mode) getlog_sink(&f, 0, GETLOG_RECORDS, true, g);
+    else (void)LogQuery_Ranges(&lfs, &f, lo, hi, getlog_sink, g, st);
+    *ns = nor_emu_now_ns() - t0;
+    *wire = nor_emu_stats()->wire_bytes;
+    lfs_file_close(&lfs, &f);
+}
+
+static void bench_getlog(void)
+{
+    static const struct { const char *name; uint32_t lo, hi; } q[] = {
+        { "SINCE last 6 h",       GETLOG_T0 + (GETLOG_RECORDS - 360u) * 60u - 86400u, UINT32_MAX },
+        { "BETWEEN 1 h, repeated", GETLOG_T0 + 65000u * 60u, GETLOG_T0 + 65060u * 60u },
+        { "BETWEEN 1 h, early",   GETLOG_T0 + 3000u * 60u, GETLOG_T0 + 3060u * 60u },
+        { "BETWEEN outside",      GETLOG_T0 - 7200u, GETLOG_T0 - 3600u },
+    };
+    static const char *how[] = { "wake.idx", "wake.seg search", "whole file" };
+    static bench_logrec_t recs[GETLOG_BATCH];
+    uint32_t expect[sizeof q / sizeof q[0]] = { 0 };
+    for (size_t k = 0; k < sizeof q / sizeof q[0]; k++)
+        for (uint32_t i = 0; i < GETLOG_RECORDS; i++) expect[k] += LogQuery_Match(getlog_epoch(i), q[k].lo, q[k].hi);
+
+    emu_setup(8000000u);
+    memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+    LFS_W25Q64_InitConfig(&lfs_cfg);
+    lfs_cfg.read_buffer = wake_rbuf; lfs_cfg.prog_buffer = wake_pbuf; lfs_cfg.lookahead_buffer = wake_lbuf;
+    W25Q64_ReleaseFromDeepPowerDown();
+    if (LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg) != 0) { printf("getlog: format failed\n\n"); return; }
+
+    /* append in flush-sized batches, updating wake.idx as WakeBatch_Flush does */
+    lfs_file_t f;
+    uint64_t append_wire = 0, idx_wire = 0;
+    nor_emu_reset_stats();
+    for (uint32_t i = 0; i < GETLOG_RECORDS; i += GETLOG_BATCH) {
+        if (i == GETLOG_RECORDS / 2u) (void)LogQuery_MarkSegment(&lfs);
+        for (uint32_t k = 0; k < GETLOG_BATCH; k++) recs[k] = (bench_logrec_t){ .epoch = getlog_epoch(i + k) };
+        if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) < 0) break;
+        (void)lfs_file_write(&lfs, &f, recs, sizeof recs);
+        lfs_file_close(&lfs, &f);
+        if ((i + GETLOG_BATCH) % LOG_IDX_RECORDS == 0) {
+            uint64_t w0 = nor_emu_stats()->wire_bytes;
+            (void)LogQuery_IndexUpdate(&lfs, false, NULL);
+            idx_wire += nor_emu_stats()->wire_bytes - w0;
+        }
+    }
+    append_wire = nor_emu_stats()->wire_bytes - idx_wire;
+
+    printf("## getlog: %lu records (%lu KiB), clock set back 1 day at the midpoint, SCK 8 MHz\n\n",
+           (unsigned long)GETLOG_RECORDS, (unsigned long)(GETLOG_RECORDS * LOG_REC_SIZE / 1024u));
+    printf("| query | lookup | expected | records read | probes | flash KiB | ms | result |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (size_t k = 0; k < sizeof q / sizeof q[0]; k++) {
+        for (int m = 0; m < 3; m++) {
+            getlog_bench_t g;
+            LogQuery_Stats st;
+            uint64_t wire, ns;
+            if (m == 1) (void)lfs_rename(&lfs, LOG_IDX_FILE, "wake.idx.off");
+            getlog_query(m == 2, q[k].lo, q[k].hi, &g, &st, &wire, &ns);
+            if (m == 1) (void)lfs_rename(&lfs, "wake.idx.off", LOG_IDX_FILE);
+            int ok = g.matched == expect[k] && !g.bad && (m != 0 || st.indexed == GETLOG_RECORDS);
+            printf("| %s | %s | %lu | %lu | %lu | %.1f | %.1f | %s |\n", m ? "" : q[k].name, how[m],
+                   (unsigned long)expect[k], (unsigned long)g.read, (unsigned long)st.probes,
+                   wire / 1024.0, ns / 1e6, ok ? "ok" : "FAIL");
+        }
+    }
+    printf("\nwake.idx upkeep while logging: %.2f%% of the append wire bytes (%lu B file).\n",
+           100.0 * idx_wire / append_wire,
+           (unsigned long)(GETLOG_RECORDS / LOG_IDX_RECORDS * sizeof(LogQuery_IndexEntry)));
+
+    /* a damaged entry: GETLOG INDEX rebuilds the file from wake.bin */
+    LogQuery_IndexEntry junk = { 12345u, 1u, 0u };
+    bool rebuilt = false;
+    (void)lfs_file_open(&lfs, &f, LOG_IDX_FILE, LFS_O_WRONLY);
+    (void)lfs_file_seek(&lfs, &f, 100 * (lfs_soff_t)sizeof junk, LFS_SEEK_SET);
+    (void)lfs_file_write(&lfs, &f, &junk, sizeof junk);
+    lfs_file_close(&lfs, &f);
+    getlog_bench_t g;
+    LogQuery_Stats st;
+    uint64_t wire, ns;
+    getlog_query(0, q[2].lo, q[2].hi, &g, &st, &wire, &ns);
+    int partial_ok = g.matched == expect[2] && st.indexed == 100u * LOG_IDX_RECORDS;
+    nor_emu_reset_stats();
+    int n = LogQuery_IndexUpdate(&lfs, true, &rebuilt);
+    uint64_t rebuild_wire = nor_emu_stats()->wire_bytes;
+    getlog_query(0, q[1].lo, q[1].hi, &g, &st, &wire, &ns);
+    printf("Damaged entry 100: query falls back past it (%s); rebuild %s, %d entries, %.0f KiB read; query after (%s).\n",
+           partial_ok ? "ok" : "FAIL", rebuilt ? "done" : "NOT done", n, rebuild_wire / 1024.0,
+           (g.matched == expect[1] && st.indexed == GETLOG_RECORDS) ? "ok" : "FAIL");
+
+    /* no index and the segment list overflowed: the rest is checked record by record */
+    (void)lfs_remove(&lfs, LOG_IDX_FILE);
+    for (uint32_t i = 0; i <= LOG_SEG_MAX; i++) {
+        recs[0] = (bench_logrec_t){ .epoch = GETLOG_T0 + i };
+        (void)lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_WRONLY | LFS_O_APPEND);
+        (void)lfs_file_write(&lfs, &f, recs, sizeof recs[0]);
+        lfs_file_close(&lfs, &f);
+        (void)LogQuery_MarkSegment(&lfs);
+    }
+    getlog_query(0, q[1].lo, q[1].hi, &g, &st, &wire, &ns);
+    printf("No wake.idx and %lu SETTIMEs: segments %lu, %lu records matched by the linear check (%s).\n\n",
+           (unsigned long)(LOG_SEG_MAX + 2u), (unsigned long)st.segments, (unsigned long)g.matched,
+           (st.segments == 0 && g.matched == expect[1] && !g.bad) ? "ok" : "FAIL");
+    LFS_W25Q64_Unmount(&lfs);
+    W25Q64_EnterDeepPowerDown();
+}
+
+/* ---- usage: cost of the near-full check as wake.bin grows, lfs_fs_size
+ * on every wake vs the kept used-block count ---- */
+static void bench_usage(void)
+{
+    static const uint32_t marks_kib[] = { 256, 1024, 2048, 4096, 6144 };
+    const uint32_t batch = 256;   /* 2 KiB per flush to reach MiB sizes quickly */
+    const uint32_t flushes = LFS_W25Q64_USAGE_RECOUNT ? LFS_W25Q64_USAGE_RECOUNT : 1u;
+
+    printf("## usage: near-full check per flush, %lu records per flush, SCK 250 kHz\n\n", (unsigned long)batch);
+    printf("| log KiB | lfs_fs_size: wire B/flush | ms/flush | kept count: wire B/flush | ms/flush | checks while filling | max drift (blocks) |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    emu_setup(250000u);
+    W25Q64_BindPlatform(&host_platform);
+    uint8_t *image = malloc(EMU_CAPACITY);
+    if (!image) return;
+    memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+    wake_batch_n = batch;
+    uint32_t logged = 0;
+    for (size_t m = 0; m < sizeof marks_kib / sizeof marks_kib[0]; m++) {
+        /* the fill keeps the count through accounted flushes and checks it
+         * against a walk every LFS_W25Q64_USAGE_RECOUNT of them */
+        while (logged * sizeof(bench_logrec_t) < marks_kib[m] * 1024u) {
+            int rc = wake_cycle(logged * 3600u);
+            if (rc <= 0) break;
+            logged += (uint32_t)rc;
+        }
+        LFS_W25Q64_UsageStats fill;
+        LFS_W25Q64_GetUsageStats(&fill);
+        memcpy(image, nor_emu_mem(), EMU_CAPACITY);
+        uint64_t wire[2] = { 0 }, ns[2] = { 0 };
+        for (int walk = 1; walk >= 0; walk--) {
+            /* the next flushes on this image, FS_IsNearFull alone; the kept
+             * count starts fresh, so its one walk is amortized over them */
+            memcpy(nor_emu_mem(), image, EMU_CAPACITY);
+            W25Q64_ReleaseFromDeepPowerDown();
+            LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+            if (!walk) { LFS_W25Q64_UsageInvalidate(); (void)LFS_W25Q64_UsedBlocks(&lfs); }
+            for (uint32_t f = 0; f < flushes; f++) {
+                if (walk) LFS_W25Q64_UsageInvalidate();
+                LFS_W25Q64_UsageFileGrew(&lfs, 0, 0);   // one accounted flush
+                nor_emu_reset_stats();
+                uint64_t t0 = nor_emu_now_ns();
+                (void)FS_IsNearFull(2);
+                ns[walk] += nor_emu_now_ns() - t0;
+                wire[walk] += nor_emu_stats()->wire_bytes;
+            }
+            LFS_W25Q64_Unmount(&lfs);
+            W25Q64_EnterDeepPowerDown();
+        }
+        printf("| %lu | %.0f | %.2f | %.0f | %.2f | %lu | %lu |\n", (unsigned long)marks_kib[m],
+               (double)wire[1] / flushes, ns[1] / 1e6 / flushes, (double)wire[0] / flushes, ns[0] / 1e6 / flushes,
+               (unsigned long)fill.checks, (unsigned long)fill.drift_max);
+        memcpy(nor_emu_mem(), image, EMU_CAPACITY);
+    }
+    wake_batch_n = 1;
+    free(image);
+    W25Q64_BindPlatform(NULL);
+    printf("\nkept count: one checking walk per %u accounted flushes (LFS_W25Q64_USAGE_RECOUNT).\n"
+           "Drift is the kept count against that walk, over every check made while filling.\n\n",
+           (unsigned)LFS_W25Q64_USAGE_RECOUNT);
+}
+
+/* ---- codec: wake.bin (8-byte records) vs wake.z frames on a 1 MiB volume
+ * filled until FS_IsNearFull, 32-record flushes, synthetic indoor climate ---- */
+#define CODEC_BLOCKS   256u
+
+static uint32_t codec_seed = 1;
+static int32_t codec_noise(int32_t span)
+{
+    codec_seed = codec_seed * 1103515245u + 12345u;
+    return (int32_t)((codec_seed >> 16) % (uint32_t)(2 * span + 1)) - span;
+}
+
+/* Hourly wakes with a second of RTC jitter now and then, a diurnal swing of
+ * +-4 C around 21 C and RH moving against it, SHT4x-sized noise */
+static LogCodec_Rec codec_sample(uint32_t i)
+{
+    static const int16_t day[24] = { 0, 10, 20, 27, 31, 33, 31, 27, 20, 10, 0, -10,
+                                     -20, -27, -31, -33, -31, -27, -20, -10, 0, 5, 3, 1 };
+    LogCodec_Rec r;
+    r.epoch = 1700000000u + i * 3600u + (codec_noise(20) == 0 ? 1u : 0u);
+    r.t_x100 = (int16_t)(2100 + day[i % 24] * 12 + codec_noise(3));
+    r.rh_x100 = (uint16_t)(4500 - day[i % 24] * 30 + codec_noise(8));
+    return r;
+}
+
+typedef struct { uint32_t n, bad; } codec_check_t;
+
+static void codec_verify(const LogCodec_Rec *rec, void *ctx)
+{
+    codec_check_t *c = (codec_check_t*)ctx;
+    LogCodec_Rec want;
+    if (c->n == 0) codec_seed = 1;
+    want = codec_sample(c->n);
+    if (memcmp(rec, &want, sizeof want)) c->bad++;
+    c->n++;
+}
+
+static void bench_codec(void)
+{
+    static LogCodec_Rec recs[32];
+    static uint8_t frame[LOG_CODEC_FRAME_MAX];
+    static LogCodec_Decoder dec;
+    uint32_t stored[2] = { 0 };
+
+    printf("## codec: %u-block volume filled until FS_IsNearFull(2), 32-record flushes, SCK 8 MHz\n\n", CODEC_BLOCKS);
+    printf("| file | records | bytes/record | used blocks | full dump flash B/record | ms | decoded ok |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    for (int z = 0; z < 2; z++) {
+        emu_setup(8000000u);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        LFS_W25Q64_InitConfig(&lfs_cfg);
+        lfs_cfg.block_count = CODEC_BLOCKS;
+        lfs_cfg.read_buffer = wake_rbuf; lfs_cfg.prog_buffer = wake_pbuf; lfs_cfg.lookahead_buffer = wake_lbuf;
+        W25Q64_ReleaseFromDeepPowerDown();
+        LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
+        const char *name = z ? LOG_Z_FILE : "wake.bin";
+        codec_seed = 1;
+        uint32_t n = 0;
+        lfs_file_t f;
+        while (!FS_IsNearFull(2)) {
+            for (uint32_t i = 0; i < 32u; i++) recs[i] = codec_sample(n + i);
+            if (lfs_file_open(&lfs, &f, name, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) < 0) break;
+            lfs_soff_t before = lfs_file_size(&lfs, &f);
+            uint32_t len = z ? LogCodec_EncodeFrame(recs, 32u, frame) : (uint32_t)sizeof recs;
+            lfs_ssize_t w = lfs_file_write(&lfs, &f, z ? (const void *)frame : (const void *)recs, len);
+            if (lfs_file_close(&lfs, &f) < 0 || w != (lfs_ssize_t)len) break;
+            LFS_W25Q64_UsageFileGrew(&lfs, before, before + (lfs_soff_t)len);
+            n += 32u;
+        }
+        stored[z] = n;
+        struct lfs_info info;
+        lfs_stat(&lfs, name, &info);
+        lfs_ssize_t used = LFS_W25Q64_UsedBlocks(&lfs);
+
+        /* GETLOG: read the whole file and, for wake.z, decode it */
+        static uint8_t in[256];
+        codec_check_t chk = { 0 };
+        LogCodec_DecoderInit(&dec);
+        nor_emu_reset_stats();
+        uint64_t t0 = nor_emu_now_ns();
+        lfs_ssize_t r;
+        (void)lfs_file_open(&lfs, &f, name, LFS_O_RDONLY);
+        while ((r = lfs_file_read(&lfs, &f, in, sizeof in)) > 0) {
+            if (z) LogCodec_Decode(&dec, in, (uint32_t)r, codec_verify, &chk);
+            else for (lfs_ssize_t i = 0; i + 8 <= r; i += 8) codec_verify((const LogCodec_Rec *)(in + i), &chk);
+        }
+        lfs_file_close(&lfs, &f);
+        uint64_t ns = nor_emu_now_ns() - t0;
+        printf("| %s | %lu | %.2f | %ld | %.2f | %.1f | %s |\n", name, (unsigned long)n, (double)info.size / n,
+               (long)used, (double)nor_emu_stats()->wire_bytes / n, ns / 1e6,
+               (chk.n == n && !chk.bad && !dec.errors) ? "ok" : "FAIL");
+        LFS_W25Q64_Unmount(&lfs);
+        W25Q64_EnterDeepPowerDown();
+    }
+    printf("\nwake.z holds %.2fx the records of wake.bin before the near-full stop.\n", (double)stored[1] / stored[0]);
+
+    /* a damaged byte costs its own frame, the decoder picks up at the next */
+    codec_seed = 1;
+    static uint8_t stream[8 * LOG_CODEC_FRAME_MAX];
+    uint32_t len = 0;
+    for (uint32_t k = 0; k < 8; k++) {
+        for (uint32_t i = 0; i < 32u; i++) recs[i] = codec_sample(k * 32u + i);
+        len += LogCodec_EncodeFrame(recs, 32u, stream + len);
+    }
+    stream[len / 2] ^= 0x40;
+    codec_check_t chk = { 0 };
+    LogCodec_DecoderInit(&dec);
+    for (uint32_t off = 0; off < len; off += 7) LogCodec_Decode(&dec, stream + off, len - off < 7 ? len - off : 7, codec_verify, &chk);
+    printf("One flipped bit in 8 frames fed 7 bytes at a time: %lu frames, %lu records decoded, %lu errors.\n\n",
+           (unsigned long)dec.frames, (unsigned long)dec.records, (unsigned long)dec.errors);
+}
+
+/* ---- retain: a 256-block volume logged for three times what it holds,
+ * 32-record flushes, STOP (one file) vs WRAP (LogRotate_SegmentBytes()
+ * segments) ---- */
+static uint32_t retain_next;   /* epoch the next kept record must carry */
+static uint32_t retain_bad, retain_kept, retain_oldest;
+
+static void retain_check(lfs_file_t *f)
+{
+    static uint8_t in[256];
+    lfs_ssize_t r;
+    while ((r = lfs_file_read(&lfs, f, in, sizeof in)) > 0) {
+        for (lfs_ssize_t i = 0; i + 8 <= r; i += 8) {
+            uint32_t e; memcpy(&e, in + i, sizeof e);
+            if (retain_next && e != retain_next) retain_bad++;
+            retain_next = e + 1u;
+            retain_kept++;
+            if (!retain_oldest) retain_oldest = e;
+        }
+    }
+}
+
+/* GETLOG order: segments oldest first, then the active one */
+static void retain_segment(const LogRotate_Segment *seg, void *ctx)
+{
+    char name[LOG_ARCHIVE_NAME_MAX];
+    lfs_file_t f;
+    (void)ctx;
+    LogRotate_Name(name, seg->name);
+    if (lfs_file_open(&lfs, &f, name, LFS_O_RDONLY) < 0) { retain_bad++; return; }
+    retain_check(&f);
+    lfs_file_close(&lfs, &f);
+}
+
+static void bench_retain(void)
+{
+    static bench_logrec_t recs[32];
+    const uint32_t total = 3u * CODEC_BLOCKS * 4096u / sizeof recs;
+
+    printf("## retain: %u-block volume, %lu flushes of 32 records, near-full check before each, SCK 8 MHz\n\n",
+           CODEC_BLOCKS, (unsigned long)total);
+    printf("| policy | records written | records kept | oldest kept | rotations | evictions | erases per eviction (max) | ms per eviction (avg / max) | kept records in order |\n");
+    printf("|---|---|---|---|---|---|---|---|---|\n");
+    for (int wrap = 0; wrap < 2; wrap++) {
+        emu_setup(8000000u);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        LFS_W25Q64_InitConfig(&lfs_cfg);
+        lfs_cfg.block_count = CODEC_BLOCKS;
+        lfs_cfg.read_buffer = wake_rbuf; lfs_cfg.prog_buffer = wake_pbuf; lfs_cfg.lookahead_buffer = wake_lbuf;
+        W25Q64_ReleaseFromDeepPowerDown();
+        LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
+        LogRotate_BindPolicy(NULL);
+        LogRotate_SetPolicy(wrap ? LOG_RETAIN_WRAP : LOG_RETAIN_STOP);
+        uint32_t n = 0, rotations = 0, evictions = 0, erases_max = 0;
+        uint64_t evict_ns_max = 0, evict_ns = 0;
+        lfs_file_t f;
+        for (uint32_t k = 0; k < total; k++) {
+            /* as main(): evict while near full, stop if that cannot help */
+            int full = FS_IsNearFull(2);
+            while (full && LogRotate_GetPolicy() == LOG_RETAIN_WRAP) {
+                const nor_emu_stats_t *st = nor_emu_stats();
+                uint64_t e0 = st->cmds[0x20] + st->cmds[0x52] + st->cmds[0xD8], t0 = nor_emu_now_ns();
+                if (LogRotate_Evict(&lfs) <= 0) break;
+                uint64_t e = st->cmds[0x20] + st->cmds[0x52] + st->cmds[0xD8] - e0, t = nor_emu_now_ns() - t0;
+                if (e > erases_max) erases_max = (uint32_t)e;
+                if (t > evict_ns_max) evict_ns_max = t;
+                evict_ns += t;
+                evictions++;
+                full = FS_IsNearFull(2);
+            }
+            if (full) break;
+            for (uint32_t i = 0; i < 32u; i++)
+                recs[i] = (bench_logrec_t){ .epoch = 1u + n + i, .t_x100 = 2150, .rh_x100 = 4500 };
+            if (LogRotate_Check(&lfs, recs[0].epoch) > 0) rotations++;   // as WakeBatch_Flush
+            if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) < 0) break;
+            lfs_soff_t before = lfs_file_size(&lfs, &f);
+            lfs_ssize_t w = lfs_file_write(&lfs, &f, recs, sizeof recs);
+            if (lfs_file_close(&lfs, &f) < 0 || w != (lfs_ssize_t)sizeof recs) break;
+            LFS_W25Q64_UsageFileGrew(&lfs, before, before + w);
+            n += 32u;
+        }
+
+        retain_next = 0; retain_bad = 0; retain_kept = 0; retain_oldest = 0;
+        (void)LogRotate_Segments(&lfs, retain_segment, NULL);
+        if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_RDONLY) >= 0) {
+            retain_check(&f);
+            lfs_file_close(&lfs, &f);
+        }
+        if (retain_next != n + 1u) retain_bad++;   // the newest record must be there
+        printf("| %s | %lu | %lu | %lu | %lu | %lu | %lu | %.1f / %.1f | %s |\n", wrap ? "WRAP" : "STOP",
+               (unsigned long)n, (unsigned long)retain_kept, (unsigned long)retain_oldest, (unsigned long)rotations,
+               (unsigned long)evictions, (unsigned long)erases_max, evictions ? evict_ns / 1e6 / evictions : 0.0,
+               evict_ns_max / 1e6, retain_bad ? "FAIL" : "ok");
+        LFS_W25Q64_Unmount(&lfs);
+        W25Q64_EnterDeepPowerDown();
+    }
+    LogRotate_SetPolicy(LOG_RETAIN_STOP);
+    printf("\nAn eviction is one metadata commit (lfs_remove); the blocks it frees are\n"
+           "erased when littlefs allocates them again. Dropping the same %u KiB from the\n"
+           "front of a single file would mean rewriting everything kept behind it.\n\n",
+           (unsigned)((LOG_SEGMENT_BYTES ? LOG_SEGMENT_BYTES : LOG_WRAP_SEGMENT_BYTES) / 1024u));
+}
+
+/* ---- segments: one flush (mount, near-full check, 32-record append,
+ * unmount) as the log grows, one wake.bin (the default, STOP) vs the
+ * segments WRAP cuts, 30 s interval;
+ * then GETLOG BETWEEN one day a month back, edge segments binary searched
+ * as in stream_segment ---- */
+#define SEG_T0  1700000000u
+
+static void segments_visit(const LogRotate_Segment *seg, void *ctx)
+{
+    getlog_bench_t *g = (getlog_bench_t *)ctx;
+    char name[LOG_ARCHIVE_NAME_MAX];
+    lfs_file_t f;
+    if (seg->max < g->lo || seg->min > g->hi) return;
+    LogRotate_Name(name, seg->name);
+    if (lfs_file_open(&lfs, &f, name, LFS_O_RDONLY) < 0) { g->bad++; return; }
+    lfs_soff_t sz = lfs_file_size(&lfs, &f);
+    bool edge = seg->min < g->lo || seg->max > g->hi;
+    if (edge && (seg->flags & LOG_MAN_SORTED)) (void)LogQuery_Sorted(&lfs, &f, g->lo, g->hi, getlog_sink, g, NULL);
+    else getlog_sink(&f, 0, (uint32_t)sz / LOG_REC_SIZE, edge, g);
+    lfs_file_close(&lfs, &f);
+}
+
+static void bench_segments(void)
+{
+    static const uint32_t marks_kib[] = { 256, 1024, 2048, 4096, 6144 };
+    enum { MARKS = sizeof marks_kib / sizeof marks_kib[0] };
+    const uint32_t window = 64;   /* flushes averaged before each mark */
+    static bench_logrec_t recs[32];
+    double ms[2][MARKS], wire[2][MARKS], erases[2][MARKS];
+    uint32_t files[2] = { 0 };
+    getlog_bench_t q[2];
+    uint64_t q_ns[2], q_wire[2];
+
+    LogRotate_BindPolicy(NULL);
+    LogRotate_SetPolicy(LOG_RETAIN_WRAP);
+    printf("## segments: per-flush cost as the log grows, %u-record flushes every 16 min, segments of %lu s / %lu KiB, SCK 8 MHz\n\n",
+           32u, (unsigned long)LOG_SEGMENT_SECONDS, (unsigned long)(LogRotate_SegmentBytes() / 1024u));
+    for (int seg = 0; seg < 2; seg++) {
+        emu_setup(8000000u);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        LFS_W25Q64_InitConfig(&lfs_cfg);
+        lfs_cfg.read_buffer = wake_rbuf; lfs_cfg.prog_buffer = wake_pbuf; lfs_cfg.lookahead_buffer = wake_lbuf;
+        W25Q64_ReleaseFromDeepPowerDown();
+        LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
+        LFS_W25Q64_Unmount(&lfs);
+        LogRotate_BindPolicy(NULL);
+        LogRotate_SetPolicy(seg ? LOG_RETAIN_WRAP : LOG_RETAIN_STOP);   /* nothing is evicted */
+        uint32_t n = 0;
+        for (size_t m = 0; m < MARKS; m++) {
+            uint64_t ns = 0, w = 0, e = 0;
+            const uint32_t end = marks_kib[m] * 1024u / sizeof(bench_logrec_t);
+            while (n < end) {
+                int measure = (end - n) <= window * 32u;
+                const nor_emu_stats_t *st = nor_emu_stats();
+                uint64_t t0 = nor_emu_now_ns(), w0 = st->wire_bytes, e0 = st->cmds[0x20] + st->cmds[0x52] + st->cmds[0xD8];
+                LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+                (void)FS_IsNearFull(2);
+                for (uint32_t i = 0; i < 32u; i++)
+                    recs[i] = (bench_logrec_t){ .epoch = SEG_T0 + (n + i) * 30u, .t_x100 = 2150, .rh_x100 = 4500 };
+                (void)LogRotate_Check(&lfs, recs[0].epoch);   // as WakeBatch_Flush
+                lfs_file_t f;
+                if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) == 0) {
+                    lfs_soff_t before = lfs_file_size(&lfs, &f);
+                    lfs_ssize_t wr = lfs_file_write(&lfs, &f, recs, sizeof recs);
+                    if (lfs_file_close(&lfs, &f) == 0 && wr > 0) LFS_W25Q64_UsageFileGrew(&lfs, before, before + wr);
+                }
+                LFS_W25Q64_Unmount(&lfs);
+                if (measure) {
+                    ns += nor_emu_now_ns() - t0;
+                    w += st->wire_bytes - w0;
+                    e += st->cmds[0x20] + st->cmds[0x52] + st->cmds[0xD8] - e0;
+                }
+                n += 32u;
+            }
+            ms[seg][m] = ns / 1e6 / window;
+            wire[seg][m] = (double)w / window;
+            erases[seg][m] = (double)e / window;
+        }
+
+        /* BETWEEN one day, 30 days before the newest record */
+        LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+        files[seg] = seg ? (uint32_t)LogRotate_Segments(&lfs, NULL, NULL) + 1u : 1u;
+        uint32_t hi = SEG_T0 + (n - 1u) * 30u - 30u * 86400u, lo = hi - 86400u + 1u;
+        LogQuery_Stats qs;
+        lfs_file_t f;
+        q[seg] = (getlog_bench_t){ .lo = lo, .hi = hi };
+        const nor_emu_stats_t *st = nor_emu_stats();
+        LFS_W25Q64_SetReadAhead(0);   /* as stream_file_filtered */
+        uint64_t t0 = nor_emu_now_ns(), w0 = st->wire_bytes;
+        if (seg) (void)LogRotate_Segments(&lfs, segments_visit, &q[seg]);
+        if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_RDONLY) >= 0) {
+            (void)LogQuery_Ranges(&lfs, &f, lo, hi, getlog_sink, &q[seg], &qs);
+            lfs_file_close(&lfs, &f);
+        }
+        q_ns[seg] = nor_emu_now_ns() - t0;
+        LFS_W25Q64_SetReadAhead(LFS_W25Q64_READAHEAD);
+        q_wire[seg] = st->wire_bytes - w0;
+        LFS_W25Q64_Unmount(&lfs);
+        W25Q64_EnterDeepPowerDown();
+    }
+    printf("| log KiB | one file: ms/flush | wire B/flush | erases/flush | segments: ms/flush | wire B/flush | erases/flush |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    for (size_t m = 0; m < MARKS; m++)
+        printf("| %lu | %.2f | %.0f | %.2f | %.2f | %.0f | %.2f |\n", (unsigned long)marks_kib[m],
+               ms[0][m], wire[0][m], erases[0][m], ms[1][m], wire[1][m], erases[1][m]);
+    printf("\n| layout | files | BETWEEN 1 day: records | records read | flash wire B | ms |\n|---|---|---|---|---|---|\n");
+    for (int seg = 0; seg < 2; seg++)
+        printf("| %s | %lu | %lu | %lu | %llu | %.1f |\n", seg ? "segments" : "one wake.bin",
+               (unsigned long)files[seg], (unsigned long)q[seg].matched, (unsigned long)q[seg].read,
+               (unsigned long long)q_wire[seg], q_ns[seg] / 1e6);
+    printf("\nAverages over the %lu flushes before each mark, rotations included. No wake.idx\n"
+           "in either layout: one wake.bin is searched through wake.seg. The growth in both\n"
+           "is the allocator's first scan after mount, which walks every file and directory.\n\n",
+           (unsigned long)window);
+    LogRotate_SetPolicy(LOG_RETAIN_STOP);
+}
+
+/* ---- dpd: release/enter traffic and flash awake time per wake, tRES
+ * timed with a HAL_Delay(1) (no us clock bound) vs the platform us clock,
+ * the geometry probed every wake vs kept in SRAM2 ---- */
+static void bench_dpd(void)
+{
+    static const W25Q64_Platform tick_only = { host_sleep_us, NULL };
+    static const struct { const char *name; const W25Q64_Platform *plat; int probe_every; } cfgs[] = {
+        { "HAL tick, probe every wake", &tick_only, 1 },
+        { "us clock, probe every wake", &host_platform, 1 },
+        { "us clock, geometry kept", &host_platform, 0 },
+    };
+    const uint32_t wakes = 200;
+
+    printf("## dpd: %lu hourly wakes on a fresh log, SCK 250 kHz\n\n", (unsigned long)wakes);
+    printf("| wake | flush: 0xAB/wake | 0xB9/wake | coalesced/wake | driver awake ms/wake | emulator awake ms/wake "
+           "| queue only: 0xAB/wake | 0xB9/wake | awake ms/wake | violations |\n");
+    printf("|---|---|---|---|---|---|---|---|---|---|\n");
+    for (size_t c = 0; c < sizeof cfgs / sizeof cfgs[0]; c++) {
+        emu_setup(250000u);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        W25Q64_BindPlatform(cfgs[c].plat);
+        wake_probe_every = cfgs[c].probe_every;
+        (void)wake_cycle(0);   // probe and format outside the measurement
+        nor_emu_advance_ns(3600ull * 1000000000ull);
+        nor_emu_reset_stats();
+        uint64_t t0 = nor_emu_now_ns();
+        uint64_t awake_us = 0;
+        uint32_t coalesced = 0;
+        for (uint32_t w = 1; w <= wakes; w++) {
+            (void)wake_cycle(w * 3600u);
+            W25Q64_PowerStats ps;
+            W25Q64_GetPowerStats(&ps);
+            awake_us += ps.awake_us;
+            coalesced += ps.coalesced;
+            nor_emu_advance_ns(3600ull * 1000000000ull);
+        }
+        const nor_emu_stats_t *st = nor_emu_stats();
+        uint64_t emu_awake_ns = nor_emu_now_ns() - t0 - st->dpd_ns;
+        uint64_t flush_ab = st->cmds[0xAB], flush_b9 = st->cmds[0xB9], violations = st->violations;
+
+        // wakes that only queue their record in SRAM2
+        nor_emu_reset_stats();
+        t0 = nor_emu_now_ns();
+        for (uint32_t w = 1; w <= wakes; w++) {
+            wake_boot();
+            nor_emu_advance_ns(3600ull * 1000000000ull);
+        }
+        uint64_t queue_awake_ns = nor_emu_now_ns() - t0 - st->dpd_ns;
+        violations += st->violations;
+        printf("| %s | %.2f | %.2f | %.2f | %.1f | %.1f | %.2f | %.2f | %.2f | %llu |\n", cfgs[c].name,
+               (double)flush_ab / wakes, (double)flush_b9 / wakes, (double)coalesced / wakes,
+               awake_us / 1e3 / wakes, emu_awake_ns / 1e6 / wakes,
+               (double)st->cmds[0xAB] / wakes, (double)st->cmds[0xB9] / wakes, queue_awake_ns / 1e6 / wakes,
+               (unsigned long long)violations);
+    }
+    wake_probe_every = 0;
+    W25Q64_BindPlatform(NULL);
+    printf("\n");
+}
+
+/* ---- clock: energy per wake vs SYSCLK / SCK for the storage burst
+ * (release .. DPD). Range 1 run and sleep currents are STM32L412 datasheet
+ * typicals; littlefs CPU work is modelled per data byte, the HAL polled loop
+ * per wire byte, both at SYSCLK. ---- */
+#define MCU_LFS_CYCLES_PER_BYTE   12.0   /* CRC + cache memcpy */
+#define MCU_HAL_CYCLES_PER_BYTE   40.0   /* HAL_SPI_Transmit/Receive per byte */
+#define MCU_CLOCK_SWITCH_US       50.0   /* MSI range change + HAL_InitTick, each way */
+
+static void bench_clock(void)
+{
+    static const struct {
+        const char *name; uint32_t sysclk_hz; uint32_t spi_div; int lpr;
+        double run_ua; double sleep_ua;
+    } cfgs[] = {
+        { "2 MHz LP run", 2000000u, 8, 1, MCU_LPRUN_2MHZ_UA, MCU_LPSLEEP_2MHZ_UA },
+        { "2 MHz LP run", 2000000u, 2, 1, MCU_LPRUN_2MHZ_UA, MCU_LPSLEEP_2MHZ_UA },
+        { "4 MHz MSI",    4000000u, 2, 0,  450.0, 140.0 },
+        { "8 MHz MSI",    8000000u, 2, 0,  850.0, 250.0 },
+        { "16 MHz MSI",  16000000u, 4, 0, 1650.0, 450.0 },
+        { "16 MHz MSI",  16000000u, 2, 0, 1650.0, 450.0 },
+        { "24 MHz MSI",  24000000u, 2, 0, 2450.0, 650.0 },
+    };
+    const uint32_t wakes = 50;
+    double base_uj = 0;
+
+    printf("## clock: storage burst per hourly wake (release, mount, append 8 B, unmount, DPD), DMA on\n\n");
+    printf("| SYSCLK | SCK | burst ms | core run ms | core WFI ms | Stop ms | MCU uJ | flash uJ | total uJ | vs 250 kHz |\n");
+    printf("|---|---|---|---|---|---|---|---|---|---|\n");
+    for (size_t c = 0; c < sizeof cfgs / sizeof cfgs[0]; c++) {
+        const double f = cfgs[c].sysclk_hz;
+        emu_setup(cfgs[c].sysclk_hz / cfgs[c].spi_div);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        hspi_emu.hdmarx = &hdma_emu_rx; hspi_emu.hdmatx = &hdma_emu_tx;
+        W25Q64_EnableDMA(1);
+        W25Q64_BindPlatform(&host_platform);
+        (void)wake_cycle(0);
+        nor_emu_advance_ns(3600ull * 1000000000ull);
+
+        double run_s = 0, wfi_s = 0, stop_s = 0, burst_s = 0, flash_uj = 0;
+        for (uint32_t w = 1; w <= wakes; w++) {
+            nor_emu_reset_stats();
+            host_slept_ns = 0;
+            uint64_t t0 = nor_emu_now_ns();
+            (void)wake_cycle(w * 3600u);
+            const nor_emu_stats_t *st = nor_emu_stats();
+            double wall = (nor_emu_now_ns() - t0) / 1e9;
+            double polled_bytes = st->polled_ns / 1e9 * (f / cfgs[c].spi_div) / 8.0;
+            // the core cannot feed the SPI faster than the HAL loop runs
+            double polled = st->polled_ns / 1e9, polled_cpu = polled_bytes * MCU_HAL_CYCLES_PER_BYTE / f;
+            double extra = (polled_cpu > polled ? polled_cpu - polled : 0)
+                         + st->data_bytes * MCU_LFS_CYCLES_PER_BYTE / f
+                         + (cfgs[c].lpr ? 0 : 2.0 * MCU_CLOCK_SWITCH_US / 1e6);
+            double stop = host_slept_ns / 1e9, wfi = st->dma_ns / 1e9;
+            run_s += wall - stop - wfi + extra;
+            wfi_s += wfi; stop_s += stop; burst_s += wall + extra;
+            // the flash sits in standby (10 uA) while the core computes
+            flash_uj += st->uj_total - st->uj_dpd + MCU_VDD * 0.010 * extra * 1e3;
+            nor_emu_advance_ns(3600ull * 1000000000ull);
+        }
+        double stop_ua = cfgs[c].lpr ? MCU_STOP1_LPTIM_UA : MCU_STOP_LPTIM_UA;
+        double mcu_uj = MCU_VDD * (cfgs[c].run_ua * run_s + cfgs[c].sleep_ua * wfi_s + stop_ua * stop_s) / wakes;
+        flash_uj /= wakes;
+        double total = mcu_uj + flash_uj;
+        if (c == 0) base_uj = total;
+        printf("| %s | %lu kHz | %.1f | %.1f | %.1f | %.1f | %.0f | %.0f | %.0f | %.2fx |\n", cfgs[c].name,
+               (unsigned long)(cfgs[c].sysclk_hz / cfgs[c].spi_div / 1000u), burst_s * 1e3 / wakes,
+               run_s * 1e3 / wakes, wfi_s * 1e3 / wakes, stop_s * 1e3 / wakes, mcu_uj, flash_uj, total,
+               total / base_uj);
+    }
+    hspi_emu.hdmarx = NULL; hspi_emu.hdmatx = NULL;
+    W25Q64_EnableDMA(0);
+    W25Q64_BindPlatform(NULL);
+    printf("\nBuild knobs: STORAGE_CLOCK_BOOST, STORAGE_BOOST_MSI_RANGE, STORAGE_BOOST_SPI_PRESCALER (main.c).\n\n");
+}
+
+/* ---- readahead: SPI frames and wire bytes for mount, FS_IsNearFull and one
+ * append on a log built by hourly wakes, per read-ahead window, SCK 8 MHz ---- */
+static void bench_readahead(void)
+{
+    static const uint32_t windows[] = { 0, 512, 1024 };
+    static const char *phases[] = { "mount", "fs_size", "append+unmount", "read wake.bin" };
+    const uint32_t log_wakes = 2000;
+
+    printf("## readahead: %lu-record wake.bin, SCK 8 MHz, same image per window\n\n", (unsigned long)log_wakes);
+    printf("| window B | phase | read frames | wire KiB | ms | lfs reads | hits | misses | bypass |\n");
+    printf("|---|---|---|---|---|---|---|---|---|\n");
+    emu_setup(8000000u);
+    memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+    W25Q64_BindPlatform(&host_platform);
+    for (uint32_t w = 0; w < log_wakes; w++) (void)wake_cycle(w * 3600u);
+    uint8_t *image = malloc(EMU_CAPACITY);
+    if (!image) return;
+    memcpy(image, nor_emu_mem(), EMU_CAPACITY);
+
+    for (size_t i = 0; i < sizeof windows / sizeof windows[0]; i++) {
+        memcpy(nor_emu_mem(), image, EMU_CAPACITY);
+        LFS_W25Q64_SetReadAhead(windows[i]);
+        W25Q64_ReleaseFromDeepPowerDown();
+        for (int ph = 0; ph < 4; ph++) {
+            nor_emu_reset_stats();
+            LFS_W25Q64_ResetReadStats();
+            uint64_t t0 = nor_emu_now_ns();
+            lfs_file_t lf;
+            if (ph == 0) {
+                LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+            } else if (ph == 1) {
+                (void)FS_IsNearFull(2);
+            } else if (ph == 2) {
+                bench_logrec_t rec = { 0 };
+                if (lfs_file_open(&lfs, &lf, "wake.bin", LFS_O_WRONLY | LFS_O_APPEND) == 0) {
+                    lfs_file_write(&lfs, &lf, &rec, sizeof rec);
+                    lfs_file_close(&lfs, &lf);
+                }
+                LFS_W25Q64_Unmount(&lfs);
+            } else {
+                static uint8_t chunk[64];   // GETLOG streams one CDC packet at a time
+                LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+                nor_emu_reset_stats();
+                LFS_W25Q64_ResetReadStats();
+                t0 = nor_emu_now_ns();
+                if (lfs_file_open(&lfs, &lf, "wake.bin", LFS_O_RDONLY) == 0) {
+                    while (lfs_file_read(&lfs, &lf, chunk, sizeof chunk) > 0) { }
+                    lfs_file_close(&lfs, &lf);
+                }
+                LFS_W25Q64_Unmount(&lfs);
+            }
+            const nor_emu_stats_t *st = nor_emu_stats();
+            LFS_W25Q64_ReadStats rs; LFS_W25Q64_GetReadStats(&rs);
+            printf("| %lu | %s | %llu | %.1f | %.1f | %lu | %lu | %lu | %lu |\n", (unsigned long)windows[i], phases[ph],
+                   (unsigned long long)st->cmds[0x03], st->wire_bytes / 1024.0, (nor_emu_now_ns() - t0) / 1e6,
+                   (unsigned long)rs.reads, (unsigned long)rs.hits, (unsigned long)rs.misses, (unsigned long)rs.bypass);
+        }
+        W25Q64_EnterDeepPowerDown();
+    }
+    free(image);
+    LFS_W25Q64_SetReadAhead(LFS_W25Q64_READAHEAD);
+    W25Q64_BindPlatform(NULL);
+    printf("\n");
+}
+
+/* ---- fastmount: RTC wake with and without the mount snapshot on a log
+ * built by hourly wakes, same image per row, SCK 250 kHz (LP run) ---- */
+static uint32_t host_snap[LFS_W25Q64_SNAPSHOT_WORDS];
+static void host_snap_load(uint32_t *w, uint32_t n) { memcpy(w, host_snap, n * sizeof w[0]); }
+static void host_snap_save(const uint32_t *w, uint32_t n) { memcpy(host_snap, w, n * sizeof w[0]); }
+static const LFS_W25Q64_SnapshotStore host_snapshot = { host_snap_load, host_snap_save };
+
+static void bench_fastmount(void)
+{
+    static const uint32_t log_wakes[] = { 10, 2000 };
+    static const char *phases[] = { "mount", "open+append+close", "unmount" };
+
+    printf("## fastmount: wake.bin append, SCK 250 kHz, same image per row\n\n");
+    printf("| records | mount | phase | frames | wire B | ms |\n");
+    printf("|---|---|---|---|---|---|\n");
+    emu_setup(250000u);
+    W25Q64_BindPlatform(&host_platform);
+    LFS_W25Q64_BindSnapshot(&host_snapshot);
+    uint8_t *image = malloc(EMU_CAPACITY);
+    if (!image) return;
+    for (size_t n = 0; n < sizeof log_wakes / sizeof log_wakes[0]; n++) {
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        for (uint32_t w = 0; w < log_wakes[n]; w++) (void)wake_cycle(w * 3600u);
+        memcpy(image, nor_emu_mem(), EMU_CAPACITY);
+        for (int fast = 0; fast < 2; fast++) {
+            memcpy(nor_emu_mem(), image, EMU_CAPACITY);
+            W25Q64_ReleaseFromDeepPowerDown();
+            /* the previous wake leaves the snapshot behind */
+            memset(host_snap, 0, sizeof host_snap);
+            if (fast) {
+                LFS_W25Q64_FastMount(&lfs, &lfs_cfg, NULL);
+                LFS_W25Q64_FastUnmount(&lfs);
+            }
+            uint64_t total_ns = 0, total_frames = 0, total_wire = 0;
+            uint8_t used = 0;
+            for (int ph = 0; ph < 3; ph++) {
+                nor_emu_reset_stats();
+                uint64_t t0 = nor_emu_now_ns();
+                if (ph == 0) {
+                    LFS_W25Q64_FastMount(&lfs, &lfs_cfg, &used);
+                } else if (ph == 1) {
+                    bench_logrec_t rec = { .epoch = log_wakes[n] * 3600u };
+                    lfs_file_t lf;
+                    if (lfs_file_open(&lfs, &lf, "wake.bin", LFS_O_WRONLY | LFS_O_APPEND) == 0) {
+                        lfs_file_write(&lfs, &lf, &rec, sizeof rec);
+                        lfs_file_close(&lfs, &lf);
+                    }
+                } else {
+                    LFS_W25Q64_FastUnmount(&lfs);
+                }
+                const nor_emu_stats_t *st = nor_emu_stats();
+                uint64_t ns = nor_emu_now_ns() - t0;
+                printf("| %lu | %s | %s | %llu | %llu | %.1f |\n", (unsigned long)log_wakes[n],
+                       used ? "snapshot" : "full", phases[ph], (unsigned long long)st->frames,
+                       (unsigned long long)st->wire_bytes, ns / 1e6);
+                total_ns += ns; total_frames += st->frames; total_wire += st->wire_bytes;
+            }
+            printf("| %lu | %s | **wake** | %llu | %llu | %.1f |\n", (unsigned long)log_wakes[n],
+                   used ? "snapshot" : "full", (unsigned long long)total_frames,
+                   (unsigned long long)total_wire, total_ns / 1e6);
+            /* a full mount must see the appended record */
+            struct lfs_info info;
+            if (LFS_W25Q64_Mount(&lfs, &lfs_cfg) != 0 || lfs_stat(&lfs, "wake.bin", &info) != 0
+                    || info.size != (log_wakes[n] + 1u) * sizeof(bench_logrec_t))
+                printf("| %lu | %s | **wake.bin mismatch after remount** | | | |\n",
+                       (unsigned long)log_wakes[n], used ? "snapshot" : "full");
+            LFS_W25Q64_Unmount(&lfs);
+            W25Q64_EnterDeepPowerDown();
+        }
+    }
+    free(image);
+    LFS_W25Q64_BindSnapshot(NULL);
+    W25Q64_BindPlatform(NULL);
+    printf("\nThe snapshot costs two 4-byte revision reads at mount and at unmount;\n"
+           "lfs_file_open still fetches the root pair and walks to the CTZ head.\n\n");
+}
+
+/* ---- maint: storage wakes after ERASELOG on a 256-block volume that was
+ * 3/4 full, so most of the free space is dirty; what the logging path
+ * erases with no maintenance, a battery pass every N storage wakes, and
+ * after a VBUS pass (USB session) ---- */
+static uint32_t host_maint[LFS_W25Q64_MAINT_WORDS];
+static void host_maint_load(uint32_t *w, uint32_t n) { memcpy(w, host_maint, n * sizeof w[0]); }
+static void host_maint_save(const uint32_t *w, uint32_t n) { memcpy(host_maint, w, n * sizeof w[0]); }
+static const LFS_W25Q64_MaintStore host_maint_store = { host_maint_load, host_maint_save };
+
+static uint64_t emu_erases(void)
+{
+    const nor_emu_stats_t *st = nor_emu_stats();
+    return st->cmds[0x20] + st->cmds[0x52] + st->cmds[0xD8];
+}
+
+/* One storage wake of main(): FastMount, 32-record flush, maintenance when
+ * due, FastUnmount. Adds the logging path's and maintenance's erases and
+ * time; returns 0, -1 on a failed write. */
+typedef struct { uint64_t log_e, log_ns, log_ns_max, m_e, m_ns; } maint_cost_t;
+
+static int maint_wake(uint32_t *n, uint32_t every, uint32_t budget_us, maint_cost_t *c)
+{
+    static bench_logrec_t recs[32];
+    uint64_t t0 = nor_emu_now_ns(), e0 = emu_erases();
+    if (LFS_W25Q64_FastMount(&lfs, &lfs_cfg, NULL) != 0) return -1;
+    for (uint32_t i = 0; i < 32u; i++)
+        recs[i] = (bench_logrec_t){ .epoch = 1u + *n + i, .t_x100 = 2150, .rh_x100 = 4500 };
+    (void)FS_IsNearFull(2);
+    (void)LogRotate_Check(&lfs, recs[0].epoch);   // as WakeBatch_Flush
+    lfs_file_t f;
+    int rc = lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND);
+    if (rc == 0) {
+        lfs_soff_t before = lfs_file_size(&lfs, &f);
+        lfs_ssize_t w = lfs_file_write(&lfs, &f, recs, sizeof recs);
+        rc = lfs_file_close(&lfs, &f);
+        if (rc == 0 && w == (lfs_ssize_t)sizeof recs) LFS_W25Q64_UsageFileGrew(&lfs, before, before + w);
+        else rc = -1;
+    }
+    *n += 32u;
+    uint64_t t1 = nor_emu_now_ns(), e1 = emu_erases();
+    /* as main(): account the wake, then maintenance when due */
+    uint32_t since = LFS_W25Q64_MaintNoteWake();
+    if (every && since >= every && LFS_W25Q64_Maintain(&lfs, budget_us) < 0) rc = -1;
+    uint64_t t2 = nor_emu_now_ns(), e2 = emu_erases();
+    LFS_W25Q64_FastUnmount(&lfs);
+    if (c) {
+        c->log_e += e1 - e0; c->log_ns += t1 - t0; c->m_e += e2 - e1; c->m_ns += t2 - t1;
+        if (t1 - t0 > c->log_ns_max) c->log_ns_max = t1 - t0;
+    }
+    return rc ? -1 : 0;
+}
+
+static int maint_mark_used(void *ctx, lfs_block_t block)
+{
+    uint8_t *used = ctx;
+    if (block < CODEC_BLOCKS) used[block] = 1;
+    return 0;
+}
+
+/* Free blocks that read back blank, straight from the emulator's array */
+static uint32_t maint_blank_free(void)
+{
+    static uint8_t used[CODEC_BLOCKS];
+    uint32_t blank = 0;
+    memset(used, 0, sizeof used);
+    LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+    (void)lfs_fs_traverse(&lfs, maint_mark_used, used);
+    LFS_W25Q64_Unmount(&lfs);
+    for (uint32_t b = 0; b < CODEC_BLOCKS; b++) {
+        const uint8_t *p = nor_emu_mem() + b * 4096u;
+        uint32_t i = 0;
+        while (i < 4096u && p[i] == 0xFF) i++;
+        if (!used[b] && i == 4096u) blank++;
+    }
+    return blank;
+}
+
+static void bench_maint(void)
+{
+    static const struct { const char *name; uint32_t every, budget_us; int vbus; } runs[] = {
+        { "none", 0, 0, 0 },
+        { "every 16 wakes, 1 s", 16, 1000000u, 0 },
+        { "every 4 wakes, 250 ms", 4, 250000u, 0 },
+        { "every wake, 100 ms", 1, 100000u, 0 },
+        { "VBUS pass, then none", 0, 0, 1 },
+        { "VBUS pass, flushes mid-pass", 0, 0, 2 },
+    };
+    const uint32_t fill = 3u * CODEC_BLOCKS * 4096u / 4u / 256u, measured = 512;
+
+    printf("## maint: %u-block volume, %lu 32-record flushes, ERASELOG, then %lu measured storage wakes, SCK 8 MHz\n\n",
+           CODEC_BLOCKS, (unsigned long)fill, (unsigned long)measured);
+    printf("| maintenance | log erases/wake | log ms/wake (avg / max) | maint erases/wake | maint ms/wake | erases/wake, all | blank free blocks after | kept: erased / log_erases / log_skipped |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (size_t r = 0; r < sizeof runs / sizeof runs[0]; r++) {
+        emu_setup(8000000u);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        W25Q64_BindPlatform(&host_platform);
+        host_erase_mark = 0;
+        LFS_W25Q64_BindEraseMarker(&host_marker);
+        memset(host_snap, 0, sizeof host_snap);
+        LFS_W25Q64_BindSnapshot(&host_snapshot);
+        memset(host_maint, 0, sizeof host_maint);
+        LFS_W25Q64_BindMaint(&host_maint_store);
+        LFS_W25Q64_InitConfig(&lfs_cfg);
+        lfs_cfg.block_count = CODEC_BLOCKS;
+        lfs_cfg.read_buffer = wake_rbuf; lfs_cfg.prog_buffer = wake_pbuf; lfs_cfg.lookahead_buffer = wake_lbuf;
+        W25Q64_ReleaseFromDeepPowerDown();
+        LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg);
+        LFS_W25Q64_Unmount(&lfs);
+        LogRotate_BindPolicy(NULL);
+        LogRotate_SetPolicy(LOG_RETAIN_STOP);
+        uint32_t n = 0, bad = 0;
+        for (uint32_t k = 0; k < fill && !bad; k++) if (maint_wake(&n, 0, 0, NULL)) bad++;
+
+        /* ERASELOG: the files go, their blocks stay as they were */
+        LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+        (void)lfs_remove(&lfs, LOG_FILE);
+        (void)lfs_remove(&lfs, LOG_SEG_FILE);
+        (void)lfs_remove(&lfs, LOG_IDX_FILE);
+        (void)LogRotate_RemoveAll(&lfs);
+        LFS_W25Q64_UsageInvalidate();
+        uint32_t n_erased = n;   /* first record after ERASELOG */
+        if (runs[r].vbus) {   /* the session's idle hook */
+            if (LFS_W25Q64_MaintainStart(&lfs, 0) != 0) bad++;
+            LFS_W25Q64_Unmount(&lfs);
+            /* SETTIME between steps flushes through littlefs: the blocks it
+             * takes must not be erased by the steps that follow */
+            for (uint32_t k = 0; runs[r].vbus == 2 && k < 8u && !bad; k++) {
+                for (int s = 0; s < 3; s++) (void)LFS_W25Q64_PreEraseStep();
+                if (maint_wake(&n, 0, 0, NULL)) bad++;
+            }
+            while (LFS_W25Q64_PreEraseStep()) { }
+        } else {
+            LFS_W25Q64_Unmount(&lfs);
+        }
+
+        LFS_W25Q64_MaintStats ms0, ms1;
+        LFS_W25Q64_GetMaintStats(&ms0);
+        maint_cost_t c = { 0 };
+        for (uint32_t k = 0; k < measured && !bad; k++)
+            if (maint_wake(&n, runs[r].every, runs[r].budget_us, &c)) bad++;
+        LFS_W25Q64_GetMaintStats(&ms1);
+
+        /* the log must read back in order, newest record last */
+        retain_next = 0; retain_bad = 0; retain_kept = 0; retain_oldest = 0;
+        LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+        (void)LogRotate_Segments(&lfs, retain_segment, NULL);
+        lfs_file_t f;
+        if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_RDONLY) >= 0) {
+            retain_check(&f);
+            lfs_file_close(&lfs, &f);
+        }
+        LFS_W25Q64_Unmount(&lfs);
+        if (retain_bad || retain_oldest != n_erased + 1u || retain_next != n + 1u) bad++;
+        printf("| %s | %.2f | %.1f / %.1f | %.2f | %.1f | %.2f | %lu | %lu / %lu / %lu |%s\n", runs[r].name,
+               (double)c.log_e / measured, c.log_ns / 1e6 / measured, c.log_ns_max / 1e6,
+               (double)c.m_e / measured, c.m_ns / 1e6 / measured, (double)(c.log_e + c.m_e) / measured,
+               (unsigned long)maint_blank_free(),
+               (unsigned long)(ms1.erased - ms0.erased), (unsigned long)(ms1.log_erases - ms0.log_erases),
+               (unsigned long)(ms1.log_skipped - ms0.log_skipped), bad ? " **FAIL**" : "");
+        W25Q64_EnterDeepPowerDown();
+    }
+    LogRotate_SetPolicy(LOG_RETAIN_STOP);
+    LFS_W25Q64_BindMaint(NULL);
+    LFS_W25Q64_BindSnapshot(NULL);
+    LFS_W25Q64_BindEraseMarker(NULL);
+    W25Q64_BindPlatform(NULL);
+    printf("\nA pass erases only free blocks that do not read blank, each of which the\n"
+           "logging path would erase before using it. Erases past the \"none\" row are\n"
+           "blocks erased early and not yet used: they stay blank in the free pool\n"
+           "(blank free blocks after) and cost nothing when littlefs takes them. The\n"
+           "VBUS pass itself is not in the table.\n\n");
+}
+
+/* ---- stream: GETLOG of a near-full wake.bin, one 64-byte packet per
+ * HAL_Delay tick vs APP_TX_DATA_SIZE halves with and without the flash
+ * read overlapping the bulk transfer, target STREAM_TARGET_MBS. Flash time is measured on the
+ * emulator; USB full speed is modelled at ~1 MB/s of bulk (64 us a
+ * packet, a ZLP after every half that ends on a packet boundary), the
+ * old path at 1.5 ms a packet (HAL_Delay(1) after each). ---- */
+#define STREAM_FILE_KIB   (7u * 1024u)
+#define STREAM_USB_PKT_NS 64000u
+#define STREAM_OLD_PKT_NS 1500000u
+#define STREAM_TARGET_MBS 0.45  /* full 8 MiB dump in under ~19 s */
+
+static uint64_t stream_usb_ns(uint32_t len)
+{
+    uint32_t pkts = (len + 63u) / 64u + ((len & 63u) == 0);
+    return (uint64_t)pkts * STREAM_USB_PKT_NS;
+}
+
+static void bench_stream(void)
+{
+    static const uint32_t sck[] = { 6000000u, 12000000u, 24000000u };
+    static uint8_t chunk[512];
+    static const char *how[] = { "64 B packets, HAL_Delay", "512 B transfers, serial", "512 B transfers, overlapped" };
+    const uint32_t total = STREAM_FILE_KIB * 1024u;
+
+    emu_setup(24000000u);
+    memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+    LFS_W25Q64_InitConfig(&lfs_cfg);
+    lfs_cfg.read_buffer = wake_rbuf; lfs_cfg.prog_buffer = wake_pbuf; lfs_cfg.lookahead_buffer = wake_lbuf;
+    W25Q64_ReleaseFromDeepPowerDown();
+    if (LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg) != 0) { printf("stream: format failed\n\n"); return; }
+    lfs_file_t f;
+    if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0) return;
+    for (uint32_t off = 0; off < total; off += sizeof chunk) {
+        for (uint32_t i = 0; i < sizeof chunk; i++) chunk[i] = (uint8_t)((off + i) * 13u);
+        (void)lfs_file_write(&lfs, &f, chunk, sizeof chunk);
+    }
+    lfs_file_close(&lfs, &f);
+    LFS_W25Q64_Unmount(&lfs);
+
+    printf("## stream: GETLOG of a %lu KiB wake.bin, USB FS bulk modelled\n\n", (unsigned long)STREAM_FILE_KIB);
+    printf("| SCK MHz | path | flash s | USB s | total s | MB/s | 8 MiB dump s | bytes ok |\n");
+    printf("|---|---|---|---|---|---|---|---|\n");
+    for (size_t k = 0; k < sizeof sck / sizeof sck[0]; k++) {
+        nor_emu_set_spi_hz(sck[k]);
+        for (int m = 0; m < 3; m++) {
+            uint32_t len = m ? sizeof chunk : 64u, got = 0, bad = 0;
+            uint64_t flash = 0, usb = 0, t = 0, prev_usb = 0;
+            LFS_W25Q64_SetReadAhead(m ? 0 : LFS_W25Q64_READAHEAD);   // as GETLOG now does
+            LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+            if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_RDONLY) < 0) break;
+            for (;;) {
+                uint64_t t0 = nor_emu_now_ns();
+                lfs_ssize_t r = lfs_file_read(&lfs, &f, chunk, len);
+                uint64_t rd = nor_emu_now_ns() - t0;
+                if (r <= 0) break;
+                for (lfs_ssize_t i = 0; i < r; i++) bad += chunk[i] != (uint8_t)((got + (uint32_t)i) * 13u);
+                got += (uint32_t)r;
+                uint64_t u = m ? stream_usb_ns((uint32_t)r) : STREAM_OLD_PKT_NS;
+                flash += rd; usb += u;
+                // overlapped: this read runs while the previous half is on the bus
+                t += (m == 2) ? (rd > prev_usb ? rd : prev_usb) : rd + u;
+                prev_usb = u;
+            }
+            if (m == 2) t += prev_usb;
+            lfs_file_close(&lfs, &f);
+            LFS_W25Q64_Unmount(&lfs);
+            LFS_W25Q64_SetReadAhead(LFS_W25Q64_READAHEAD);
+            double mbs = got / (t / 1e9) / 1e6;
+            printf("| %lu | %s | %.1f | %.1f | %.1f | %.2f | %.1f | %s |\n", (unsigned long)(sck[k] / 1000000u),
+                   how[m], flash / 1e9, usb / 1e9, t / 1e9, mbs, EMU_CAPACITY / 1e6 / mbs,
+                   (got == total && !bad) ? "ok" : "FAIL");
+        }
+    }
+    W25Q64_EnterDeepPowerDown();
+    printf("\nTarget: >= %.2f MB/s overlapped at SCK 6 MHz, the USB session clock. Each\n"
+           "half costs max(flash, USB): the flash read bounds it at 6 MHz, the bus from\n"
+           "about 12 MHz up. The 512 B paths run without the read-ahead window: a 1 KiB\n"
+           "fetch every other half stalls the overlap (0.40 MB/s at 6 MHz with it).\n\n",
+           STREAM_TARGET_MBS);
+}
+
+/* ---- framed: GETLOG OFFSET/LEN FRAMED over a segmented log, the device
+ * side as in CMD_GetLog_Window (LogRotate_Window into LOG_FRAME_SIZE
+ * frames), the host keeping the frames that check out and asking again
+ * for what is missing ---- */
+#define FRAMED_RECORDS  (160u * 1024u)   /* 1.25 MiB, ~20 segments */
+#define FRAMED_T0       1700000000u
+
+typedef struct {
+    uint8_t *wire;
+    uint32_t cap, n;          /* wire bytes */
+    uint32_t fill, seq, off;  /* frame being filled */
+} framed_dev_t;
+
+static void framed_seal(framed_dev_t *d, uint8_t type)
+{
+    uint32_t len = d->fill - LOG_FRAME_HDR;
+    if (d->n + LOG_FRAME_SIZE <= d->cap)
+        LogFrame_Seal(d->wire + d->n, type, d->seq, d->off, len);
+    d->n += LOG_FRAME_SIZE;
+    d->seq++;
+    if (type == LOG_FRAME_T_DATA) d->off += len;
+    d->fill = LOG_FRAME_HDR;
+}
+
+/* stream_records: straight into the frame payload */
+static void framed_sink(lfs_file_t *f, uint32_t from, uint32_t to, bool check, void *ctx)
+{
+    framed_dev_t *d = (framed_dev_t *)ctx;
+    static uint8_t scratch[LOG_FRAME_SIZE];
+    (void)check;
+    (void)lfs_file_seek(&lfs, f, (lfs_soff_t)(from * LOG_REC_SIZE), LFS_SEEK_SET);
+    while (from < to) {
+        uint8_t *frame = (d->n + LOG_FRAME_SIZE <= d->cap) ? d->wire + d->n : scratch;
+        uint32_t want = (to - from) * LOG_REC_SIZE, room = LOG_FRAME_HDR + LOG_FRAME_PAYLOAD - d->fill;
+        if (want > room) want = room;
+        lfs_ssize_t r = lfs_file_read(&lfs, f, frame + d->fill, want);
+        if (r <= 0) break;
+        d->fill += (uint32_t)r;
+        from += (uint32_t)r / LOG_REC_SIZE;
+        if (d->fill == LOG_FRAME_HDR + LOG_FRAME_PAYLOAD) framed_seal(d, LOG_FRAME_T_DATA);
+    }
+}
+
+/* One request; returns the wire bytes, *ns the flash time */
+static uint32_t framed_request(uint32_t offset, uint32_t len, uint8_t *wire, uint32_t cap, uint64_t *ns)
+{
+    framed_dev_t d = { wire, cap, 0, LOG_FRAME_HDR, 0, offset };
+    uint32_t base = 0;
+    uint64_t t0 = nor_emu_now_ns();
+    LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+    LFS_W25Q64_SetReadAhead(0);
+    int total = LogRotate_Window(&lfs, offset / LOG_REC_SIZE, len / LOG_REC_SIZE, framed_sink, &d, &base);
+    LFS_W25Q64_SetReadAhead(LFS_W25Q64_READAHEAD);
+    LFS_W25Q64_Unmount(&lfs);
+    *ns = nor_emu_now_ns() - t0;
+    if (d.fill > LOG_FRAME_HDR) framed_seal(&d, LOG_FRAME_T_DATA);
+    LogFrame_Trailer end = { (total > 0) ? (uint32_t)total : 0u, base, offset, d.off - offset, d.seq,
+                             (total < 0) ? total : 0 };
+    uint8_t *frame = (d.n + LOG_FRAME_SIZE <= cap) ? wire + d.n : NULL;
+    if (frame) memcpy(frame + LOG_FRAME_HDR, &end, sizeof end);
+    d.fill = LOG_FRAME_HDR + sizeof end;
+    framed_seal(&d, LOG_FRAME_T_END);
+    return d.n;
+}
+
+/* Host side: keep every good data frame wherever it lands, whatever came
+ * before it; framed_gap finds what is still missing */
+typedef struct { uint8_t *image; uint8_t *have; uint32_t frames_bad; LogFrame_Trailer end; int ended; } framed_host_t;
+
+static void framed_take(framed_host_t *h, const uint8_t *wire, uint32_t n)
+{
+    for (uint32_t i = 0; i + LOG_FRAME_SIZE <= n; i += LOG_FRAME_SIZE) {
+        LogFrame_Hdr hd;
+        if (!LogFrame_Check(wire + i, &hd)) { h->frames_bad++; continue; }
+        if (hd.type == LOG_FRAME_T_END) { memcpy(&h->end, wire + i + LOG_FRAME_HDR, sizeof h->end); h->ended = 1; continue; }
+        memcpy(h->image + hd.offset, wire + i + LOG_FRAME_HDR, hd.len);
+        memset(h->have + hd.offset, 1, hd.len);
+    }
+}
+
+/* First missing byte at or after 'from', and how many follow */
+static uint32_t framed_gap(const framed_host_t *h, uint32_t from, uint32_t total, uint32_t *len)
+{
+    while (from < total && h->have[from]) from++;
+    uint32_t to = from;
+    while (to < total && !h->have[to]) to++;
+    *len = to - from;
+    return from;
+}
+
+static void bench_framed(void)
+{
+    static bench_logrec_t recs[512];
+    const uint32_t total = FRAMED_RECORDS * LOG_REC_SIZE;
+    const uint32_t wire_cap = (total / LOG_FRAME_PAYLOAD + 8u) * LOG_FRAME_SIZE;
+    uint8_t *ref = malloc(total), *wire = malloc(wire_cap);
+    framed_host_t h = { malloc(total), malloc(total), 0, { 0 }, 0 };
+    if (!ref || !wire || !h.image || !h.have) return;
+
+    emu_setup(6000000u);   /* SCK of the USB session */
+    memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+    LFS_W25Q64_InitConfig(&lfs_cfg);
+    lfs_cfg.read_buffer = wake_rbuf; lfs_cfg.prog_buffer = wake_pbuf; lfs_cfg.lookahead_buffer = wake_lbuf;
+    W25Q64_ReleaseFromDeepPowerDown();
+    if (LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg) != 0) { printf("framed: format failed\n\n"); return; }
+    LogRotate_BindPolicy(NULL);
+    LogRotate_SetPolicy(LOG_RETAIN_WRAP);   /* segments for the window to cross */
+    lfs_file_t f;
+    for (uint32_t i = 0; i < FRAMED_RECORDS; i += 512u) {
+        for (uint32_t k = 0; k < 512u; k++)
+            recs[k] = (bench_logrec_t){ .epoch = FRAMED_T0 + (i + k) * 30u, .t_x100 = (int16_t)(i + k), .rh_x100 = (uint16_t)((i + k) * 7u) };
+        memcpy(ref + i * LOG_REC_SIZE, recs, sizeof recs);
+        (void)LogRotate_Check(&lfs, recs[0].epoch);
+        if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) < 0) break;
+        (void)lfs_file_write(&lfs, &f, recs, sizeof recs);
+        lfs_file_close(&lfs, &f);
+    }
+    int segs = LogRotate_Segments(&lfs, NULL, NULL);
+    LogRotate_SetPolicy(LOG_RETAIN_STOP);
+    LFS_W25Q64_Unmount(&lfs);
+
+    printf("## framed: GETLOG OFFSET/LEN FRAMED, %lu KiB log in %d segments + wake.bin, SCK 6 MHz\n\n",
+           (unsigned long)(total / 1024u), segs);
+    printf("| transfer | requests | wire KiB | overhead | flash ms (first request) | bad frames | log rebuilt |\n");
+    printf("|---|---|---|---|---|---|---|\n");
+    for (int sc = 0; sc < 5; sc++) {
+        static const char *names[] = { "whole log", "cut at 40 %, resumed", "frame 100 damaged, re-asked",
+                                       "4 windows", "last 64 KiB only" };
+        uint32_t requests = 0, wire_total = 0;
+        uint64_t first_ns = 0, ns;
+        memset(h.have, 0, total);
+        h.frames_bad = 0; h.ended = 0;
+        if (sc == 3) {
+            for (uint32_t k = 0; k < 4u; k++) {
+                uint32_t off = k * (total / 4u), len = (k == 3u) ? 0u : total / 4u;
+                uint32_t n = framed_request(off, len, wire, wire_cap, &ns);
+                if (!requests++) first_ns = ns;
+                wire_total += n;
+                framed_take(&h, wire, n);
+            }
+        } else {
+            uint32_t off = (sc == 4) ? total - 65536u : 0u;
+            uint32_t n = framed_request(off, 0, wire, wire_cap, &first_ns);
+            requests++;
+            if (sc == 1) n = n * 2u / 5u + 100u;                  /* link lost mid-frame */
+            if (sc == 2) wire[100u * LOG_FRAME_SIZE + 77u] ^= 0x10u;
+            wire_total += n;
+            framed_take(&h, wire, n);
+        }
+        /* ask again for every gap until the log is whole */
+        uint32_t from = (sc == 4) ? total - 65536u : 0u, len;
+        while ((from = framed_gap(&h, from, total, &len)) < total && requests < 64u) {
+            uint32_t n = framed_request(from, (sc == 1) ? 0u : len, wire, wire_cap, &ns);
+            requests++;
+            wire_total += n;
+            framed_take(&h, wire, n);
+        }
+        uint32_t lo = (sc == 4) ? total - 65536u : 0u;
+        int ok = !memcmp(h.image + lo, ref + lo, total - lo) && h.ended && h.end.total == FRAMED_RECORDS;
+        printf("| %s | %lu | %.1f | %.1f %% | %.1f | %lu | %s |\n", names[sc], (unsigned long)requests,
+               wire_total / 1024.0, 100.0 * wire_total / (total - lo) - 100.0, first_ns / 1e6,
+               (unsigned long)h.frames_bad, ok ? "ok" : "FAIL");
+    }
+
+    /* every single-byte error in a frame must fail the CRC */
+    uint32_t n = framed_request(0, 64u * LOG_FRAME_PAYLOAD, wire, wire_cap, &(uint64_t){ 0 });
+    uint32_t caught = 0, tries = 0;
+    srand(1);
+    for (uint32_t i = 0; i < 4096u; i++, tries++) {
+        uint32_t at = (uint32_t)rand() % n;
+        uint8_t x = (uint8_t)(1u + (uint32_t)rand() % 255u);
+        wire[at] ^= x;
+        caught += !LogFrame_Check(wire + at / LOG_FRAME_SIZE * LOG_FRAME_SIZE, NULL);
+        wire[at] ^= x;
+    }
+    W25Q64_EnterDeepPowerDown();
+    printf("\nDamaged bytes caught by the frame CRC: %lu / %lu. A frame is one %u B USB\n"
+           "transfer with %u B of records; a window that starts late reads the manifest\n"
+           "and opens only the segments it covers.\n\n",
+           (unsigned long)caught, (unsigned long)tries, LOG_FRAME_SIZE, LOG_FRAME_PAYLOAD);
+    free(ref); free(wire); free(h.image); free(h.have);
+}
+
+/* ---- wirez: GETLOG vs GETLOG COMPRESS of six-month logs written
+ * through LogRotate. Flash time is measured on the emulator with the
+ * device's read sizes (512 B into the TX half, up to 256 B into the
+ * encoder); USB as in "stream". The encoder is not timed on the host:
+ * WIREZ_ENC_NS is an estimate for the Cortex-M4 at 48 MHz (two zigzag
+ * varint pairs and the bitwise CRC-16 over ~2.5 B, ~150 cycles). Raw
+ * total is max(flash, USB), compressed max(flash + encode, USB): the read
+ * and the encode share the CPU, the bulk transfer runs beside them. ---- */
+#define WIREZ_DAYS     182u
+#define WIREZ_HALF     512u
+#define WIREZ_ENC_NS   3000u    /* per record */
+#define WIREZ_T0       1700000000u
+
+typedef struct {
+    int z;
+    uint8_t *wire;
+    uint32_t cap, n, half;
+    LogCodec_Rec rec[LOG_CODEC_KEY_EVERY];
+    uint32_t nrec, recs;
+    uint64_t flash_ns, usb_ns;
+} wirez_dev_t;
+
+static uint32_t wirez_seed;
+
+static int32_t wirez_noise(int32_t amp)
+{
+    wirez_seed = wirez_seed * 1103515245u + 12345u;
+    return (int32_t)((wirez_seed >> 16) % (uint32_t)(2 * amp + 1)) - amp;
+}
+
+/* triangle wave, -amp..amp over period samples */
+static int32_t wirez_tri(uint32_t i, uint32_t period, int32_t amp)
+{
+    int32_t ph = (int32_t)(i % period), h = (int32_t)period / 2;
+    return (ph < h ? ph : (int32_t)period - ph) * 4 * amp / (int32_t)period - amp;
+}
+
+static const char *wirez_name[] = { "indoor, 60 s", "outdoor, 10 min", "field, 5 min, jitter + gaps" };
+
+static uint32_t wirez_count(int set)
+{
+    static const uint32_t per_day[] = { 1440u, 144u, 288u };
+    return WIREZ_DAYS * per_day[set];
+}
+
+static LogCodec_Rec wirez_sample(int set, uint32_t i, uint32_t *epoch)
+{
+    LogCodec_Rec r;
+    uint32_t n = wirez_count(set);
+    switch (set) {
+    case 0:    /* heated room: slow daily swing, sensor LSB noise */
+        *epoch += 60u;
+        r.t_x100 = (int16_t)(2100 + wirez_tri(i, 1440u, 120) + wirez_noise(2));
+        r.rh_x100 = (uint16_t)(4500 + wirez_tri(i + 360u, 1440u, 300) + wirez_noise(5));
+        break;
+    case 1:    /* outside, winter into summer */
+        *epoch += 600u;
+        r.t_x100 = (int16_t)(500 + (int32_t)(1500u * (uint64_t)i / n) + wirez_tri(i, 144u, 600) + wirez_noise(15));
+        r.rh_x100 = (uint16_t)(7000 - wirez_tri(i, 144u, 1500) + wirez_noise(40));
+        break;
+    default:   /* wake jitter of a few seconds, an outage every ~2 weeks */
+        *epoch += 298u + (uint32_t)(wirez_noise(2) + 2);
+        if (i && i % 4000u == 0) *epoch += 3u * 3600u;
+        r.t_x100 = (int16_t)(1200 + wirez_tri(i, 288u, 700) + wirez_noise(20));
+        r.rh_x100 = (uint16_t)(6000 - wirez_tri(i, 288u, 1200) + wirez_noise(50));
+        break;
+    }
+    r.epoch = *epoch;
+    return r;
+}
+
+/* whole 512 B halves are bulk transfers; the partial last one at the end */
+static void wirez_out(wirez_dev_t *d, const uint8_t *p, uint32_t len)
+{
+    while (len) {
+        uint32_t k = WIREZ_HALF - d->half;
+        if (k > len) k = len;
+        if (d->n + k <= d->cap) memcpy(d->wire + d->n, p, k);
+        d->n += k; d->half += k; p += k; len -= k;
+        if (d->half == WIREZ_HALF) { d->usb_ns += stream_usb_ns(WIREZ_HALF); d->half = 0; }
+    }
+}
+
+static void wirez_flush(wirez_dev_t *d)
+{
+    static uint8_t frame[LOG_CODEC_FRAME_MAX];
+    if (!d->nrec) return;
+    wirez_out(d, frame, LogCodec_EncodeFrame(d->rec, d->nrec, frame));
+    d->nrec = 0;
+}
+
+/* stream_records, both modes */
+static void wirez_sink(lfs_file_t *f, uint32_t from, uint32_t to, bool check, void *ctx)
+{
+    wirez_dev_t *d = (wirez_dev_t *)ctx;
+    static uint8_t half[WIREZ_HALF];
+    (void)check;
+    (void)lfs_file_seek(&lfs, f, (lfs_soff_t)(from * LOG_REC_SIZE), LFS_SEEK_SET);
+    while (from < to) {
+        uint32_t want = (to - from) * LOG_REC_SIZE;
+        uint32_t room = d->z ? (LOG_CODEC_KEY_EVERY - d->nrec) * LOG_REC_SIZE : WIREZ_HALF - d->half;
+        uint8_t *buf = d->z ? (uint8_t *)&d->rec[d->nrec] : half;
+        if (want > room) want = room;
+        uint64_t t0 = nor_emu_now_ns();
+        lfs_ssize_t r = lfs_file_read(&lfs, f, buf, want);
+        d->flash_ns += nor_emu_now_ns() - t0;
+        if (r <= 0) break;
+        uint32_t n = (uint32_t)r / LOG_REC_SIZE;
+        d->recs += n;
+        if (!d->z) wirez_out(d, buf, (uint32_t)r);
+        else if ((d->nrec += n) == LOG_CODEC_KEY_EVERY) wirez_flush(d);
+        from += n;
+    }
+}
+
+typedef struct { const LogCodec_Rec *ref; uint32_t n, bad; } wirez_check_t;
+
+static void wirez_verify(const LogCodec_Rec *rec, void *ctx)
+{
+    wirez_check_t *c = (wirez_check_t *)ctx;
+    if (memcmp(rec, &c->ref[c->n], sizeof *rec)) c->bad++;
+    c->n++;
+}
+
+static void bench_wirez(void)
+{
+    static const uint32_t sck[] = { 6000000u, 24000000u };
+    static LogCodec_Rec batch[512];
+    static LogCodec_Decoder dec;
+
+    printf("## wirez: GETLOG vs GETLOG COMPRESS, %u days of records per log, USB FS bulk modelled\n\n", WIREZ_DAYS);
+    printf("| log | records | raw KiB | wire KiB | B/record | SCK MHz | flash s raw / z | encode s | USB s raw / z | total s raw / z | decoded ok |\n");
+    printf("|---|---|---|---|---|---|---|---|---|---|---|\n");
+    for (int set = 0; set < 3; set++) {
+        uint32_t n = wirez_count(set), epoch = WIREZ_T0;
+        LogCodec_Rec *ref = malloc(n * sizeof *ref);
+        uint8_t *wire = malloc(n * LOG_REC_SIZE + 1024u);
+        if (!ref || !wire) return;
+        wirez_seed = 1u + (uint32_t)set;
+        for (uint32_t i = 0; i < n; i++) ref[i] = wirez_sample(set, i, &epoch);
+
+        emu_setup(24000000u);
+        memset(nor_emu_mem(), 0xFF, EMU_CAPACITY);
+        LFS_W25Q64_InitConfig(&lfs_cfg);
+        lfs_cfg.read_buffer = wake_rbuf; lfs_cfg.prog_buffer = wake_pbuf; lfs_cfg.lookahead_buffer = wake_lbuf;
+        W25Q64_ReleaseFromDeepPowerDown();
+        if (LFS_W25Q64_FormatAndMount(&lfs, &lfs_cfg) != 0) { printf("wirez: format failed\n\n"); return; }
+        lfs_file_t f;
+        for (uint32_t i = 0; i < n; i += 512u) {
+            uint32_t k = (n - i < 512u) ? n - i : 512u;
+            memcpy(batch, ref + i, k * sizeof *batch);
+            (void)LogRotate_Check(&lfs, batch[0].epoch);
+            if (lfs_file_open(&lfs, &f, LOG_FILE, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND) < 0) break;
+            (void)lfs_file_write(&lfs, &f, batch, k * sizeof *batch);
+            lfs_file_close(&lfs, &f);
+        }
+        LFS_W25Q64_Unmount(&lfs);
+
+        for (size_t k = 0; k < sizeof sck / sizeof sck[0]; k++) {
+            wirez_dev_t d[2];
+            nor_emu_set_spi_hz(sck[k]);
+            for (int z = 0; z < 2; z++) {
+                uint32_t base;
+                memset(&d[z], 0, sizeof d[z]);
+                d[z].z = z; d[z].wire = wire; d[z].cap = n * LOG_REC_SIZE + 1024u;
+                LFS_W25Q64_Mount(&lfs, &lfs_cfg);
+                LFS_W25Q64_SetReadAhead(0);
+                (void)LogRotate_Window(&lfs, 0, 0, wirez_sink, &d[z], &base);
+                LFS_W25Q64_SetReadAhead(LFS_W25Q64_READAHEAD);
+                LFS_W25Q64_Unmount(&lfs);
+                wirez_flush(&d[z]);
+                if (d[z].half) d[z].usb_ns += stream_usb_ns(d[z].half);
+            }
+            /* host: decode the compressed dump in USB packets */
+            wirez_check_t chk = { ref, 0, 0 };
+            LogCodec_DecoderInit(&dec);
+            for (uint32_t off = 0; off < d[1].n; off += 64u)
+                LogCodec_Decode(&dec, wire + off, d[1].n - off < 64u ? d[1].n - off : 64u, wirez_verify, &chk);
+            double enc = (double)d[1].recs * WIREZ_ENC_NS / 1e9;
+            double fr = d[0].flash_ns / 1e9, fz = d[1].flash_ns / 1e9;
+            double ur = d[0].usb_ns / 1e9, uz = d[1].usb_ns / 1e9;
+            double tr = fr > ur ? fr : ur, tz = fz + enc > uz ? fz + enc : uz;
+            printf("| %s | %lu | %.0f | %.0f | %.2f | %lu | %.2f / %.2f | %.2f | %.2f / %.2f | %.2f / %.2f | %s |\n",
+                   wirez_name[set], (unsigned long)n, d[0].n / 1024.0, d[1].n / 1024.0, (double)d[1].n / n,
+                   (unsigned long)(sck[k] / 1000000u), fr, fz, enc, ur, uz, tr, tz,
+                   (d[0].recs == n && chk.n == n && !chk.bad && !dec.errors) ? "ok" : "FAIL");
+        }
+        W25Q64_EnterDeepPowerDown();
+        free(ref); free(wire);
+    }
+    printf("\nCOMPRESS cuts the bytes on the wire, not the flash reads: at the USB\n"
+           "session's 6 MHz the dump is bound by the flash and the encode adds to it;\n"
+           "with a faster SCK the link is the limit and the smaller dump wins.\n"
+           "Decoded on the host with log_codec.c, fed in 64 B packets (tools/getlog).\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    static const struct { const char *name; void (*run)(void); } sections[] = {
+        { "readmodes", bench_readmodes },
+        { "dma", bench_dma },
+        { "busy", bench_busy },
+        { "geometry", bench_geometry },
+        { "erase", bench_erase },
+        { "suspend", bench_suspend },
+        { "dpd", bench_dpd },
+        { "clock", bench_clock },
+        { "readahead", bench_readahead },
+        { "fastmount", bench_fastmount },
+        { "batch", bench_batch },
+        { "ring", bench_ring },
+        { "getlog", bench_getlog },
+        { "usage", bench_usage },
+        { "codec", bench_codec },
+        { "retain", bench_retain },
+        { "segments", bench_segments },
+        { "maint", bench_maint },
+        { "stream", bench_stream },
+        { "framed", bench_framed },
+        { "wirez", bench_wirez },
+        { "logging", bench_logging },
+    };
+    const char *only = argc > 1 ? argv[1] : NULL;
+    int failed = 0;
+    for (size_t i = 0; i < sizeof sections / sizeof sections[0]; i++) {
+        if (only && strcmp(only, sections[i].name)) continue;
+        /* a command the real part would reject makes every number after it suspect */
+        uint64_t v0 = nor_emu_violations_total();
+        sections[i].run();
+        uint64_t v = nor_emu_violations_total() - v0;
+        if (v) {
+            printf("**FAIL** %s: %llu NOR violations\n\n", sections[i].name, (unsigned long long)v);
+            failed = 1;
+        }
+    }
+    return failed;
+}
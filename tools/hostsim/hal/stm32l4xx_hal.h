@@ -0,0 +1,55 @@
+/* stm32l4xx_hal.h (host shim)
+ * Just enough of the STM32L4 HAL surface for the storage stack to build on
+ * Linux. SPI and GPIO calls are routed into the NOR emulator (nor_emu.c),
+ * HAL_GetTick/HAL_Delay run on the emulator's virtual clock.
+ */
+#ifndef HOSTSIM_STM32L4XX_HAL_H
+#define HOSTSIM_STM32L4XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum { HAL_OK = 0, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+
+typedef struct { uint32_t id; } GPIO_TypeDef;
+typedef struct { uint32_t id; } DMA_HandleTypeDef;
+typedef struct {
+    uint32_t id;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+} SPI_HandleTypeDef;
+
+extern GPIO_TypeDef hostsim_gpioa;
+#define GPIOA        (&hostsim_gpioa)
+#define GPIO_PIN_4   ((uint16_t)0x0010)
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive (SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Receive_DMA (SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef *hspi);
+void              HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi);
+void              HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi);
+void              HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi);
+void              HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+uint32_t          HAL_GetTick(void);
+void              HAL_Delay(uint32_t Delay);
+
+/* The emulated DMA completes inside the start call, so WFI never blocks */
+#define __WFI()          ((void)0)
+#define __disable_irq()  ((void)0)
+#define __enable_irq()   ((void)0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOSTSIM_STM32L4XX_HAL_H */
@@ -0,0 +1,426 @@
+/* nor_emu.c
+ * Byte-level W25Qxx model behind the HAL shim. Each CS-low frame is decoded
+ * as opcode, 24-bit address, dummy bytes and data; program/erase commands
+ * take effect on the rising CS edge like the real part.
+ */
+#include "nor_emu.h"
+#include "stm32l4xx_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+GPIO_TypeDef hostsim_gpioa;
+
+#define SR1_WIP  0x01
+#define SR1_WEL  0x02
+#define SR2_SUS  0x80
+#define TSUS_NS  20000ull
+#define TRES_NS   3000ull   /* 0xAB to first command (tRES1) */
+#define TDP_NS    3000ull   /* 0xB9 to deep power-down (tDP) */
+
+static struct {
+    nor_emu_cfg_t cfg;
+    nor_emu_stats_t st;
+    uint8_t *mem;
+    uint64_t now_ns;
+
+    /* current CS frame */
+    int      selected;
+    uint32_t pos;
+    uint8_t  op;
+    uint32_t addr;
+    uint32_t frame_addr;
+    uint32_t page_off;
+    uint32_t prog_len;
+    uint8_t  page[256];
+
+    /* device state */
+    uint8_t  sr1, sr2;
+    int      dpd;
+    uint64_t busy_until;
+    uint8_t  busy_op;               /* opcode that started the busy period */
+    uint32_t busy_addr, busy_size;  /* region an erase is working on */
+    int      sus;                   /* erase suspended (SR2 SUS) */
+    uint64_t sus_remaining;
+    uint64_t cs_ready;      /* CS may not fall again before this (tRES1/tDP) */
+    uint8_t  sfdp[256];
+} emu;
+
+static uint32_t addr_mask(void) { return emu.cfg.capacity - 1u; }
+
+int nor_emu_busy(void) { return emu.now_ns < emu.busy_until; }
+int nor_emu_in_dpd(void) { return emu.dpd; }
+
+static double busy_ma(uint8_t op)
+{
+    return (op == 0x02 || op == 0x31) ? emu.cfg.power.program_ma : emu.cfg.power.erase_ma;
+}
+
+/* Move the virtual clock, charging the elapsed time to what the part was
+ * doing: an array operation, a CS frame, deep power-down or standby.
+ * mA * ns * V = 1e-12 J, hence the 1e-6 to get uJ. */
+static void advance(uint64_t ns)
+{
+    const nor_emu_power_t *pw = &emu.cfg.power;
+    while (ns) {
+        uint64_t seg = ns;
+        double uj;
+        if (nor_emu_busy()) {
+            uint64_t left = emu.busy_until - emu.now_ns;
+            if (seg > left) seg = left;
+            uj = pw->vcc * busy_ma(emu.busy_op) * (double)seg * 1e-6;
+            emu.st.uj_cmd[emu.busy_op] += uj;
+            if (emu.selected) {   /* status polls on top of the array current */
+                double poll = pw->vcc * (pw->active_ma - pw->standby_ma) * (double)seg * 1e-6;
+                emu.st.uj_cmd[emu.op] += poll; uj += poll;
+                emu.st.frame_ns_cmd[emu.op] += seg;
+            }
+        } else if (emu.selected && !emu.dpd) {
+            uj = pw->vcc * pw->active_ma * (double)seg * 1e-6;
+            emu.st.uj_cmd[emu.op] += uj;
+            emu.st.frame_ns_cmd[emu.op] += seg;
+        } else if (emu.dpd) {
+            uj = pw->vcc * pw->dpd_ma * (double)seg * 1e-6;
+            emu.st.uj_dpd += uj; emu.st.dpd_ns += seg;
+        } else {
+            uj = pw->vcc * pw->standby_ma * (double)seg * 1e-6;
+            emu.st.uj_standby += uj; emu.st.standby_ns += seg;
+        }
+        emu.st.uj_total += uj;
+        emu.now_ns += seg;
+        ns -= seg;
+    }
+}
+
+/* Kept apart from emu.st: neither nor_emu_reset_stats nor nor_emu_init
+ * clears it, so a run can tell whether anything broke the part's rules */
+static uint64_t violations_total;
+
+static void violation(void)
+{
+    emu.st.violations++;
+    violations_total++;
+}
+
+static void start_busy(uint64_t ns)
+{
+    emu.busy_until = emu.now_ns + ns;
+    emu.busy_op = emu.op;
+    emu.st.busy_ns += ns;
+    emu.st.busy_ns_cmd[emu.op] += ns;
+}
+
+static int is_erase(uint8_t op) { return op == 0x20 || op == 0x52 || op == 0xD8; }
+
+/* Erase the aligned region of 'size' bytes containing the frame address */
+static void erase(uint32_t size, uint64_t ns)
+{
+    if (!(emu.sr1 & SR1_WEL) || emu.pos < 4) { violation(); return; }
+    emu.busy_addr = emu.addr & addr_mask() & ~(size - 1u);
+    emu.busy_size = size;
+    memset(emu.mem + emu.busy_addr, 0xFF, size);
+    emu.sr1 &= (uint8_t)~SR1_WEL;
+    start_busy(ns);
+}
+
+/* Only status reads and suspend are accepted while an internal operation runs */
+static int allowed_while_busy(uint8_t op) { return op == 0x05 || op == 0x35 || op == 0x75; }
+
+/* While suspended only reads and resume, never inside the erasing region */
+static int allowed_while_suspended(uint8_t op)
+{
+    if (op == 0x7A || op == 0x05 || op == 0x35 || op == 0x75) return 1;
+    if (op == 0x03 || op == 0x0B || op == 0x3B || op == 0x6B)
+        return emu.frame_addr < emu.busy_addr || emu.frame_addr >= emu.busy_addr + emu.busy_size;
+    return 0;
+}
+
+static void clock_bytes(size_t n, uint8_t lanes)
+{
+    uint64_t cycles = (uint64_t)n * 8u / lanes;
+    emu.st.sck_cycles += cycles;
+    emu.st.wire_bytes += n;
+    advance(cycles * 1000000000ull / emu.cfg.spi_hz);
+}
+
+/* Number of address and dummy bytes that precede data for each opcode */
+static uint32_t header_len(uint8_t op)
+{
+    switch (op) {
+    case 0x03: case 0x02: case 0x20: case 0x52: case 0xD8: return 4;
+    case 0x0B: case 0x3B: case 0x6B: case 0x5A: return 5;
+    default: return 1;
+    }
+}
+
+static int is_read(uint8_t op) { return op == 0x03 || op == 0x0B || op == 0x3B || op == 0x6B; }
+
+static void frame_begin(void)
+{
+    if (emu.now_ns < emu.cs_ready) violation();
+    emu.selected = 1; emu.pos = 0; emu.op = 0; emu.addr = 0;
+    emu.prog_len = 0;
+}
+
+static void frame_end(void)
+{
+    emu.selected = 0;
+    if (emu.pos == 0) return;
+    emu.st.frames++;
+    emu.st.cmds[emu.op]++;
+
+    if (emu.dpd) {
+        if (emu.op == 0xAB) { emu.dpd = 0; emu.cs_ready = emu.now_ns + TRES_NS; }
+        return;
+    }
+    if (nor_emu_busy() && !allowed_while_busy(emu.op)) { violation(); return; }
+    if (emu.sus && !allowed_while_suspended(emu.op)) { violation(); return; }
+    switch (emu.op) {
+    case 0x75:
+        if (nor_emu_busy() && is_erase(emu.busy_op) && !emu.sus) {
+            emu.sus = 1;
+            emu.sus_remaining = emu.busy_until - emu.now_ns;
+            emu.busy_until = emu.now_ns + TSUS_NS;
+            emu.st.suspends++;
+        }
+        break;
+    case 0x7A:
+        if (emu.sus) {
+            emu.sus = 0;
+            emu.busy_until = emu.now_ns + emu.sus_remaining;
+        }
+        break;
+    case 0x06: emu.sr1 |= SR1_WEL; break;
+    case 0x04: emu.sr1 &= (uint8_t)~SR1_WEL; break;
+    case 0xB9: emu.dpd = 1; emu.cs_ready = emu.now_ns + TDP_NS; break;
+    case 0x31:
+        if (emu.sr1 & SR1_WEL) {
+            emu.sr2 = emu.page[0]; emu.sr1 &= (uint8_t)~SR1_WEL;
+            start_busy(emu.cfg.timing.write_sr_ns);
+        }
+        else violation();
+        break;
+    case 0x02:
+        if (!(emu.sr1 & SR1_WEL) || emu.pos < 4) { violation(); break; }
+        {
+            /* address wraps inside the 256-byte page, program only clears bits */
+            uint32_t base = emu.addr & addr_mask() & ~0xFFu;
+            uint32_t n = emu.prog_len > 256 ? 256 : emu.prog_len;
+            uint32_t first = emu.prog_len > 256 ? (emu.page_off + emu.prog_len) & 0xFFu : emu.page_off;
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t off = (first + i) & 0xFFu;
+                if ((emu.mem[base + off] & emu.page[off]) != emu.page[off]) emu.st.prog_conflicts++;
+                emu.mem[base + off] &= emu.page[off];
+            }
+            emu.st.data_bytes += n;
+        }
+        emu.sr1 &= (uint8_t)~SR1_WEL;
+        start_busy(emu.cfg.timing.page_program_ns);
+        break;
+    case 0x20: erase(4096u, emu.cfg.timing.erase_4k_ns); break;
+    case 0x52: erase(32768u, emu.cfg.timing.erase_32k_ns); break;
+    case 0xD8: erase(65536u, emu.cfg.timing.erase_64k_ns); break;
+    case 0xC7: case 0x60:
+        if (!(emu.sr1 & SR1_WEL)) { violation(); break; }
+        memset(emu.mem, 0xFF, emu.cfg.capacity);
+        emu.sr1 &= (uint8_t)~SR1_WEL;
+        start_busy(emu.cfg.timing.erase_chip_ns);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Clock one byte in each direction while CS is low */
+static uint8_t xfer(uint8_t mosi, int rx)
+{
+    uint8_t miso = 0xFF;
+    uint32_t p = emu.pos++;
+
+    if (p == 0) { emu.op = mosi; return miso; }
+    if (emu.dpd) return miso;
+    if (nor_emu_busy() && !allowed_while_busy(emu.op)) return miso;
+
+    if (p < 4 && header_len(emu.op) >= 4) {
+        emu.addr = (emu.addr << 8) | mosi;
+        if (p == 3) { emu.page_off = emu.addr & 0xFFu; emu.frame_addr = emu.addr & addr_mask(); }
+        return miso;
+    }
+    if (p < header_len(emu.op)) return miso;   /* dummy byte */
+
+    switch (emu.op) {
+    case 0x05:
+        miso = (uint8_t)(emu.sr1 | (nor_emu_busy() ? SR1_WIP : 0));
+        if (miso & SR1_WIP) emu.st.rdsr_while_busy++;
+        break;
+    case 0x35: miso = (uint8_t)(emu.sr2 | (emu.sus ? SR2_SUS : 0)); break;
+    case 0x9F: miso = (p - 1 < 3) ? emu.cfg.jedec[p - 1] : 0xFF; break;
+    case 0x5A: miso = emu.sfdp[emu.addr++ & 0xFFu]; break;
+    case 0x31: emu.page[0] = mosi; break;
+    case 0x02:
+        if (!rx) {
+            emu.page[(emu.page_off + emu.prog_len) & 0xFFu] = mosi;
+            emu.prog_len++;
+        }
+        break;
+    default:
+        if (is_read(emu.op)) {
+            miso = emu.mem[emu.addr & addr_mask()];
+            emu.addr++;
+            emu.st.data_bytes++;
+        }
+        break;
+    }
+    return miso;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+/* JESD216B header and Basic Flash Parameter Table as a W25QxxJV reports it */
+static void build_sfdp(void)
+{
+    memset(emu.sfdp, 0xFF, sizeof emu.sfdp);
+    if (emu.cfg.no_sfdp) return;
+    static const uint8_t hdr[16] = { 'S', 'F', 'D', 'P', 0x06, 0x01, 0x00, 0xFF,
+                                     0x00, 0x06, 0x01, 0x10, 0x80, 0x00, 0x00, 0xFF };
+    memcpy(emu.sfdp, hdr, sizeof hdr);
+    uint8_t *bfpt = emu.sfdp + 0x80;
+    memset(bfpt, 0, 64);
+    put32(bfpt +  0, 0xFFF920E5u);                      /* 4K erase 0x20, 1-1-2, 1-1-4 ... */
+    put32(bfpt +  4, emu.cfg.capacity * 8u - 1u);       /* density in bits - 1 */
+    put32(bfpt +  8, 0x6B08EB44u);                      /* 1-1-4 0x6B, 8 dummy */
+    put32(bfpt + 12, 0xBB423B08u);                      /* 1-1-2 0x3B, 8 dummy */
+    put32(bfpt + 16, 0xFFFFFFEEu);
+    put32(bfpt + 20, 0xFF00FFFFu);
+    put32(bfpt + 24, 0xFF00FFFFu);
+    put32(bfpt + 28, 0x520F200Cu);                      /* 4K 0x20, 32K 0x52 */
+    put32(bfpt + 32, 0xFF00D810u);                      /* 64K 0xD8 */
+    put32(bfpt + 40, 0x00000081u);                      /* page 2^8 */
+}
+
+void nor_emu_init(const nor_emu_cfg_t *cfg)
+{
+    free(emu.mem);
+    memset(&emu, 0, sizeof emu);
+    emu.cfg = *cfg;
+    nor_emu_timing_t *t = &emu.cfg.timing;
+    if (!t->page_program_ns) t->page_program_ns =       400000ull;
+    if (!t->erase_4k_ns)     t->erase_4k_ns     =     45000000ull;
+    if (!t->erase_32k_ns)    t->erase_32k_ns    =    120000000ull;
+    if (!t->erase_64k_ns)    t->erase_64k_ns    =    150000000ull;
+    if (!t->erase_chip_ns)   t->erase_chip_ns   =  20000000000ull;
+    if (!t->write_sr_ns)     t->write_sr_ns     =     10000000ull;
+    nor_emu_power_t *pw = &emu.cfg.power;
+    if (pw->vcc == 0)        pw->vcc        = 3.0;
+    if (pw->standby_ma == 0) pw->standby_ma = 0.010;
+    if (pw->dpd_ma == 0)     pw->dpd_ma     = 0.001;
+    if (pw->active_ma == 0)  pw->active_ma  = 4.0;
+    if (pw->program_ma == 0) pw->program_ma = 20.0;
+    if (pw->erase_ma == 0)   pw->erase_ma   = 20.0;
+    emu.mem = malloc(cfg->capacity);
+    if (!emu.mem) { fprintf(stderr, "nor_emu: out of memory\n"); exit(1); }
+    memset(emu.mem, 0xFF, cfg->capacity);
+    build_sfdp();
+}
+
+void nor_emu_set_spi_hz(uint32_t hz) { emu.cfg.spi_hz = hz; }
+void nor_emu_reset_stats(void) { memset(&emu.st, 0, sizeof emu.st); }
+const nor_emu_stats_t *nor_emu_stats(void) { return &emu.st; }
+uint64_t nor_emu_violations_total(void) { return violations_total; }
+uint64_t nor_emu_now_ns(void) { return emu.now_ns; }
+void nor_emu_advance_ns(uint64_t ns) { advance(ns); }
+uint8_t *nor_emu_mem(void) { return emu.mem; }
+
+int nor_emu_multi_rx(uint8_t lanes, uint8_t *buf, size_t len)
+{
+    if (!emu.selected || (lanes != 2 && lanes != 4)) return -1;
+    if ((emu.op == 0x3B && lanes != 2) || (emu.op == 0x6B && lanes != 4)) violation();
+    if (emu.op == 0x6B && !(emu.sr2 & 0x02)) violation();   /* QE not set */
+    for (size_t i = 0; i < len; i++) {
+        emu.pos++;
+        buf[i] = emu.mem[emu.addr & addr_mask()];
+        emu.addr++;
+    }
+    emu.st.data_bytes += len;
+    clock_bytes(len, lanes);
+    return 0;
+}
+
+/* ---- HAL shim ---- */
+static void spi_tx(const uint8_t *pData, uint16_t Size)
+{
+    if (!emu.selected) return;
+    for (uint16_t i = 0; i < Size; i++) (void)xfer(pData[i], 0);
+    clock_bytes(Size, 1);
+}
+
+static void spi_rx(uint8_t *pData, uint16_t Size)
+{
+    if (!emu.selected) { memset(pData, 0xFF, Size); return; }
+    if (emu.op == 0x03 && emu.cfg.read_max_hz && emu.cfg.spi_hz > emu.cfg.read_max_hz)
+        violation();
+    if (is_read(emu.op) && emu.pos >= header_len(emu.op) && !emu.dpd && !nor_emu_busy()) {
+        /* array data phase in bulk; same result as clocking xfer() per byte */
+        for (uint16_t i = 0; i < Size; i++) pData[i] = emu.mem[(emu.addr + i) & addr_mask()];
+        emu.addr += Size; emu.pos += Size;
+        emu.st.data_bytes += Size;
+    } else {
+        for (uint16_t i = 0; i < Size; i++) pData[i] = xfer(0xFF, 1);
+    }
+    clock_bytes(Size, 1);
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+    (void)hspi; (void)Timeout;
+    uint64_t t0 = emu.now_ns;
+    spi_tx(pData, Size);
+    emu.st.polled_xfers++; emu.st.polled_ns += emu.now_ns - t0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+    (void)hspi; (void)Timeout;
+    uint64_t t0 = emu.now_ns;
+    spi_rx(pData, Size);
+    emu.st.polled_xfers++; emu.st.polled_ns += emu.now_ns - t0;
+    return HAL_OK;
+}
+
+/* DMA mock: the transfer runs to completion at once and the HAL completion
+ * callback is invoked before returning, as the DMA IRQ would after it. */
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+    if (!hspi->hdmatx) return HAL_ERROR;
+    uint64_t t0 = emu.now_ns;
+    spi_tx(pData, Size);
+    emu.st.dma_xfers++; emu.st.dma_ns += emu.now_ns - t0;
+    HAL_SPI_TxCpltCallback(hspi);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+    if (!hspi->hdmarx || !hspi->hdmatx) return HAL_ERROR;
+    uint64_t t0 = emu.now_ns;
+    spi_rx(pData, Size);
+    emu.st.dma_xfers++; emu.st.dma_ns += emu.now_ns - t0;
+    HAL_SPI_RxCpltCallback(hspi);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef *hspi) { (void)hspi; return HAL_OK; }
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    if (GPIOx != GPIOA || GPIO_Pin != GPIO_PIN_4) return;
+    if (PinState == GPIO_PIN_RESET && !emu.selected) frame_begin();
+    else if (PinState == GPIO_PIN_SET && emu.selected) frame_end();
+}
+
+uint32_t HAL_GetTick(void) { return (uint32_t)(emu.now_ns / 1000000ull); }
+void HAL_Delay(uint32_t Delay) { advance((uint64_t)Delay * 1000000ull); }
@@ -0,0 +1,93 @@
+/* nor_emu.h
+ * Host-side SPI NOR emulator (Winbond W25Qxx command set).
+ * The driver talks to it through the HAL shim; every clocked byte advances a
+ * virtual clock at the configured SPI frequency so transfer time, bytes on
+ * the wire and command counts can be measured per access pattern.
+ */
+#ifndef NOR_EMU_H
+#define NOR_EMU_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* WIP durations per operation; zero fields take the W25Q64JV typical value */
+typedef struct {
+    uint64_t page_program_ns;   /* tPP  */
+    uint64_t erase_4k_ns;       /* tSE  */
+    uint64_t erase_32k_ns;      /* tBE1 */
+    uint64_t erase_64k_ns;      /* tBE2 */
+    uint64_t erase_chip_ns;     /* tCE  */
+    uint64_t write_sr_ns;       /* tW   */
+} nor_emu_timing_t;
+
+/* Supply model; zero fields take W25Q64JV typical values at 3.0 V */
+typedef struct {
+    double vcc;             /* V */
+    double standby_ma;      /* CS high, not powered down (ISB) */
+    double dpd_ma;          /* deep power-down (IPD) */
+    double active_ma;       /* CS low: commands, reads (ICC3 at <= 33 MHz) */
+    double program_ma;      /* page program, status write (ICC4/ICC5) */
+    double erase_ma;        /* sector/block/chip erase (ICC6) */
+} nor_emu_power_t;
+
+typedef struct {
+    uint32_t capacity;      /* bytes, power of two */
+    uint8_t  jedec[3];      /* manufacturer, memory type, capacity */
+    uint32_t spi_hz;        /* SCK frequency */
+    uint32_t read_max_hz;   /* fR limit of the 0x03 READ command */
+    nor_emu_timing_t timing;
+    int      no_sfdp;       /* 1: 0x5A returns 0xFF like pre-JESD216 parts */
+    nor_emu_power_t power;
+} nor_emu_cfg_t;
+
+typedef struct {
+    uint64_t cmds[256];      /* CS frames per opcode */
+    uint64_t frames;         /* total CS frames */
+    uint64_t wire_bytes;     /* bytes clocked, command + address + dummy + data */
+    uint64_t data_bytes;     /* payload bytes read or programmed */
+    uint64_t sck_cycles;     /* SCK edges, multi-line data counts 8/lanes */
+    uint64_t violations;     /* commands the real part would reject or corrupt */
+    uint64_t dma_xfers;      /* data phases started through HAL_SPI_*_DMA */
+    uint64_t polled_xfers;   /* data phases moved by HAL_SPI_Transmit/Receive */
+    uint64_t dma_ns;         /* wire time covered by DMA: the core can WFI here */
+    uint64_t polled_ns;      /* wire time the core spends spinning in the HAL */
+    uint64_t busy_ns;        /* time the array spent programming or erasing */
+    uint64_t busy_ns_cmd[256];/* the same, per opcode */
+    uint64_t rdsr_while_busy;/* status polls that returned WIP=1 */
+    uint64_t suspends;       /* 0x75 accepted during an erase */
+    uint64_t prog_conflicts; /* programmed bytes that asked for a 0 -> 1 change */
+
+    /* energy model: every virtual ns is charged to one bucket */
+    double   uj_cmd[256];    /* CS frames and array operations, per opcode */
+    double   uj_standby;
+    double   uj_dpd;
+    double   uj_total;
+    uint64_t frame_ns_cmd[256];
+    uint64_t standby_ns;
+    uint64_t dpd_ns;
+} nor_emu_stats_t;
+
+void                   nor_emu_init(const nor_emu_cfg_t *cfg);
+void                   nor_emu_set_spi_hz(uint32_t hz);
+void                   nor_emu_reset_stats(void);
+const nor_emu_stats_t *nor_emu_stats(void);
+uint64_t               nor_emu_violations_total(void);   /* since start, across inits */
+
+uint64_t nor_emu_now_ns(void);
+void     nor_emu_advance_ns(uint64_t ns);
+uint8_t *nor_emu_mem(void);
+int      nor_emu_busy(void);
+int      nor_emu_in_dpd(void);
+
+/* Multi-line data receive, bind with W25Q64_BindMultiIO() */
+int nor_emu_multi_rx(uint8_t lanes, uint8_t *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NOR_EMU_H */